@@ -0,0 +1,92 @@
+#include "arena.h"
+#include "list.h"
+#include "memory.h"
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT (sizeof(max_align_t))
+
+/**
+ * Add a new chunk big enough for the given size at the head of the arena
+ * @param a a pointer to the arena
+ * @param size the minimum number of bytes available in the new chunk
+ */
+static void arena_grow(arena_t *, size_t);
+
+void arena_init(arena_t *a) {
+  a->chunks = NULL;
+  a->allocated = 0;
+  a->chunk_count = 0;
+  return;
+}
+
+void *arena_alloc(arena_t *a, size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+  if (a->chunks == NULL || a->chunks->capacity - a->chunks->used < size)
+    arena_grow(a, size);
+  void *p = (char *)a->chunks->data + a->chunks->used;
+  a->chunks->used += size;
+  a->allocated += size;
+  return p;
+}
+
+char *arena_strndup(arena_t *a, const char *s, size_t n) {
+  size_t len = strnlen(s, n);
+  char *copy = arena_alloc(a, len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+void arena_list_add(arena_t *a, l_list_t *list, void *data) {
+  l_list_t new = arena_alloc(a, sizeof(l_node_t));
+  new->data = data;
+  new->next = *list;
+  *list = new;
+  return;
+}
+
+void arena_adopt(arena_t *a, arena_t *other) {
+  if (other->chunks == NULL)
+    return;
+  arena_chunk_t *last = other->chunks;
+  while (last->next)
+    last = last->next;
+  // Keep the chunk in use at the head, the adopted ones are already filled
+  if (a->chunks) {
+    last->next = a->chunks->next;
+    a->chunks->next = other->chunks;
+  } else
+    a->chunks = other->chunks;
+  a->allocated += other->allocated;
+  a->chunk_count += other->chunk_count;
+  other->chunks = NULL;
+  other->allocated = 0;
+  other->chunk_count = 0;
+  return;
+}
+
+void arena_destroy(arena_t *a) {
+  arena_chunk_t *current = a->chunks;
+  while (current) {
+    arena_chunk_t *next = current->next;
+    mem_free(current);
+    current = next;
+  }
+  a->chunks = NULL;
+  a->allocated = 0;
+  a->chunk_count = 0;
+  return;
+}
+
+void arena_grow(arena_t *a, size_t size) {
+  size_t capacity = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+  // Chunks come zeroed from calloc and are never reused
+  arena_chunk_t *chunk = mem_calloc(1, sizeof(arena_chunk_t) + capacity);
+  chunk->capacity = capacity;
+  chunk->used = 0;
+  chunk->next = a->chunks;
+  a->chunks = chunk;
+  a->chunk_count++;
+  return;
+}
@@ -0,0 +1,77 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include "list.h"
+#include <stddef.h>
+
+/**
+ * A chunk of memory owned by an arena
+ * @param next the previously filled chunk
+ * @param capacity the size (bytes) of data
+ * @param used the number of bytes already handed out
+ */
+typedef struct arena_chunk {
+  struct arena_chunk *next;
+  size_t capacity;
+  size_t used;
+  max_align_t data[];
+} arena_chunk_t;
+
+/**
+ * A bump allocator, every allocation lives until the whole arena is destroyed
+ * @param chunks the list of chunks, the head is the one currently in use
+ * @param allocated the number of bytes handed out
+ * @param chunk_count the number of chunks requested to the system allocator
+ */
+typedef struct {
+  arena_chunk_t *chunks;
+  size_t allocated;
+  int chunk_count;
+} arena_t;
+
+/**
+ * Initialize the given arena
+ * @param a a pointer to the arena to initialize
+ */
+void arena_init(arena_t *);
+
+/**
+ * Allocate zeroed memory from the given arena
+ * @param a a pointer to the arena
+ * @param size the number of bytes to allocate
+ * @return a pointer to the memory, suitably aligned for any type
+ */
+void *arena_alloc(arena_t *, size_t);
+
+/**
+ * Duplicate at most n bytes of a string inside the given arena
+ * @param a a pointer to the arena
+ * @param s the string to duplicate
+ * @param n the maximum number of bytes to copy
+ * @return a pointer to the NULL terminated copy
+ */
+char *arena_strndup(arena_t *, const char *, size_t);
+
+/**
+ * Add an element at the head of a list whose nodes live in the given arena
+ * @param a a pointer to the arena
+ * @param list a pointer to the list
+ * @param data the element to add
+ * @note The list must never be freed with list_free
+ */
+void arena_list_add(arena_t *, l_list_t *, void *);
+
+/**
+ * Move all the allocations of an arena inside another one
+ * @param a a pointer to the arena receiving the allocations
+ * @param other a pointer to the arena to empty
+ * @note The allocations keep their addresses, other is left empty
+ */
+void arena_adopt(arena_t *, arena_t *);
+
+/**
+ * Release all the memory of the given arena in one go
+ * @param a a pointer to the arena to destroy
+ */
+void arena_destroy(arena_t *);
+
+#endif // !ARENA_H
@@ -0,0 +1,479 @@
+#include "bytecode.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <string.h>
+
+#define BYTECODE_INITIAL_CAPACITY 256
+
+/**
+ * The state of the compilation of a function (or of the top level code)
+ * @param b a pointer to the bytecode being written
+ * @param depth the stack slots in use at the current instruction
+ * @param max_depth the maximum of depth so far
+ * @param function 1 inside a function body, where return is allowed
+ */
+typedef struct {
+  bytecode_t *b;
+  uint32_t depth;
+  uint32_t max_depth;
+  int function;
+} compiler_t;
+
+/**
+ * Append an instruction
+ * @param c a pointer to the compiler
+ * @param op the opcode
+ * @param effect how many stack slots the instruction adds (or removes)
+ */
+static void emit(compiler_t *, bc_opcode_t, int);
+/**
+ * Append a 32 bit operand
+ * @param c a pointer to the compiler
+ * @param operand the operand
+ */
+static void emit_operand(compiler_t *, uint32_t);
+/**
+ * Append a jump with a target to be patched
+ * @param c a pointer to the compiler
+ * @param op the jump opcode
+ * @param effect how many stack slots the instruction adds (or removes)
+ * @return the offset of the target operand
+ */
+static uint32_t emit_jump(compiler_t *, bc_opcode_t, int);
+/**
+ * Make a jump target the current end of the code
+ * @param c a pointer to the compiler
+ * @param at the offset of the target operand
+ */
+static void patch_jump(compiler_t *, uint32_t);
+/**
+ * Add a constant
+ * @param b a pointer to the bytecode
+ * @param v the constant
+ * @return the index of the constant
+ */
+static uint32_t constant(bytecode_t *, vm_value_t);
+/**
+ * Intern an identifier
+ * @param b a pointer to the bytecode
+ * @param name the identifier
+ * @return the symbol of the identifier
+ */
+static uint32_t symbol(bytecode_t *, const char *);
+/**
+ * Hash an identifier
+ * @param name the identifier
+ * @return the FNV-1a hash of the identifier
+ */
+static uint32_t hash(const char *);
+/**
+ * Append an instruction stopping the execution with an error
+ * @param c a pointer to the compiler
+ * @param message the error message
+ */
+static void emit_fail(compiler_t *, const char *);
+/**
+ * Compile an expression, its value is pushed on the stack
+ * @param c a pointer to the compiler
+ * @param e a pointer to the expression
+ */
+static void compile_exp(compiler_t *, exp_t *);
+/**
+ * Compile a call, the actuals are evaluated from the last one
+ * @param c a pointer to the compiler
+ * @param call a pointer to the call
+ * @param forwarded 1 if a forwarded value has been pushed already
+ */
+static void compile_call(compiler_t *, exp_call_t *, int);
+/**
+ * Compile a statement
+ * @param c a pointer to the compiler
+ * @param s a pointer to the statement
+ * @param value 1 if the value of the statement must be pushed (the last
+ * statement of a function body is its result)
+ */
+static void compile_stmt(compiler_t *, stmt_t *, int);
+/**
+ * Compile a function declaration, the body is placed inline and jumped over
+ * @param c a pointer to the compiler
+ * @param fun a pointer to the function declaration
+ */
+static void compile_function(compiler_t *, stmt_function_t *);
+/**
+ * Check if a statement binds identifiers in the enclosing block
+ * @param s a pointer to the statement
+ * @return 1 if the statement declares something outside a nested block
+ */
+static int binds(stmt_t *);
+
+void bytecode_init(bytecode_t *b) {
+  memset(b, 0, sizeof(*b));
+  b->code = NULL;
+  b->constants = NULL;
+  b->functions = NULL;
+  b->formals = NULL;
+  b->symbols = NULL;
+  b->buckets = NULL;
+  return;
+}
+
+uint32_t bytecode_compile_program(bytecode_t *b, l_list_t statements) {
+  compiler_t c = {b, 0, 0, 0};
+  uint32_t entry = b->code_count;
+  for (l_list_t current = statements; current; current = current->next)
+    compile_stmt(&c, current->data, 0);
+  emit(&c, BC_HALT, 0);
+  if (c.max_depth > b->max_stack)
+    b->max_stack = c.max_depth;
+  return entry;
+}
+
+uint32_t bytecode_compile(bytecode_t *b, stmt_t *s) {
+  compiler_t c = {b, 0, 0, 0};
+  uint32_t entry = b->code_count;
+  compile_stmt(&c, s, 0);
+  emit(&c, BC_HALT, 0);
+  if (c.max_depth > b->max_stack)
+    b->max_stack = c.max_depth;
+  return entry;
+}
+
+size_t bytecode_size(bytecode_t *b) {
+  return b->code_count + b->constants_count * sizeof(vm_value_t) +
+         b->functions_count * sizeof(bc_function_t) +
+         b->formals_count * sizeof(uint32_t);
+}
+
+void bytecode_destroy(bytecode_t *b) {
+  for (uint32_t k = 0; k < b->constants_count; k++)
+    if (b->constants[k].type == T_STRING)
+      mem_free((char *)b->constants[k].as.string);
+  for (uint32_t k = 0; k < b->symbols_count; k++)
+    mem_free(b->symbols[k]);
+  mem_free(b->code);
+  mem_free(b->constants);
+  mem_free(b->functions);
+  mem_free(b->formals);
+  mem_free(b->symbols);
+  mem_free(b->buckets);
+  bytecode_init(b);
+  return;
+}
+
+void compile_exp(compiler_t *c, exp_t *e) {
+  switch (e->type) {
+  case EXP_LITERAL: {
+    exp_literal_t *l = exp_unwrap(e);
+    vm_value_t v;
+    v.type = l->type;
+    switch (l->type) {
+    case T_NUMBER:
+      v.as.number = l->value.number;
+      emit(c, BC_CONSTANT, 1);
+      emit_operand(c, constant(c->b, v));
+      break;
+    case T_STRING:
+      v.as.string = strdup(l->value.string);
+      emit(c, BC_CONSTANT, 1);
+      emit_operand(c, constant(c->b, v));
+      break;
+    case T_BOOLEAN:
+      emit(c, l->value.boolean ? BC_TRUE : BC_FALSE, 1);
+      break;
+    default:
+      emit(c, BC_NIL, 1);
+      break;
+    }
+    break;
+  }
+  case EXP_IDENTIFIER:
+    emit(c, BC_GET, 1);
+    emit_operand(
+        c, symbol(c->b, ((exp_identifier_t *)exp_unwrap(e))->identifier));
+    break;
+  case EXP_GROUPING:
+    compile_exp(c, ((exp_grouping_t *)exp_unwrap(e))->exp);
+    break;
+  case EXP_UNARY: {
+    exp_unary_t *u = exp_unwrap(e);
+    compile_exp(c, u->right);
+    emit(c, u->op == OP_MINUS ? BC_NEGATE : BC_NOT, 0);
+    break;
+  }
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    if (b->op == OP_FORWARD) {
+      // Checked before evaluating the left side, like the tree walker does
+      if (b->right->type != EXP_CALL) {
+        emit_fail(c, "Expected a function call after |>\n");
+        break;
+      }
+      compile_exp(c, b->left);
+      compile_call(c, exp_unwrap(b->right), 1);
+      break;
+    }
+    compile_exp(c, b->left);
+    if (b->op == OP_AND || b->op == OP_OR) {
+      uint32_t end = emit_jump(c, b->op == OP_AND ? BC_AND : BC_OR, -1);
+      compile_exp(c, b->right);
+      emit(c, BC_BOOLEAN, 0);
+      patch_jump(c, end);
+      break;
+    }
+    compile_exp(c, b->right);
+    static const bc_opcode_t opcodes[] = {
+        [OP_PLUS] = BC_ADD,
+        [OP_MINUS] = BC_SUBTRACT,
+        [OP_STAR] = BC_MULTIPLY,
+        [OP_SLASH] = BC_DIVIDE,
+        [OP_MOD] = BC_MOD,
+        [OP_GREATER] = BC_GREATER,
+        [OP_GREATER_EQUAL] = BC_GREATER_EQUAL,
+        [OP_LESS] = BC_LESS,
+        [OP_LESS_EQUAL] = BC_LESS_EQUAL,
+        [OP_EQUAL] = BC_EQUAL,
+        [OP_NOT_EQUAL] = BC_NOT_EQUAL,
+    };
+    emit(c, opcodes[b->op], -1);
+    break;
+  }
+  case EXP_CALL:
+    compile_call(c, exp_unwrap(e), 0);
+    break;
+  default:
+    __builtin_unreachable();
+  }
+  return;
+}
+
+void compile_call(compiler_t *c, exp_call_t *call, int forwarded) {
+  // The parser collects the actuals in reverse order, the tree walker
+  // evaluates them in that order
+  uint32_t count = forwarded;
+  for (l_list_t current = call->actuals; current; current = current->next) {
+    compile_exp(c, current->data);
+    count++;
+  }
+  // A call in tail position reuses the frame of the function
+  emit(c, call->tail && c->function ? BC_TAIL_CALL : BC_CALL, 1 - (int)count);
+  emit_operand(c, symbol(c->b, call->identifier));
+  emit_operand(c, count);
+  c->b->code = mem_reserve(c->b->code, &c->b->code_capacity,
+                           c->b->code_count + 1, sizeof(uint8_t));
+  c->b->code[c->b->code_count++] = forwarded;
+  return;
+}
+
+void compile_stmt(compiler_t *c, stmt_t *s, int value) {
+  switch (s->type) {
+  case STMT_EXPR:
+    compile_exp(c, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    if (!value)
+      emit(c, BC_POP, -1);
+    break;
+  case STMT_RETURN:
+    // Checked before evaluating the returned value, like the tree walker does
+    if (!c->function) {
+      emit_fail(c, "return can used only inside a function\n");
+      c->depth -= !value;
+      break;
+    }
+    compile_exp(c, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    // Nothing follows a return, the value is accounted for the enclosing code
+    emit(c, BC_RETURN, value ? 0 : -1);
+    break;
+  case STMT_PRINT:
+    compile_exp(c, ((stmt_print_t *)stmt_unwrap(s))->exp);
+    emit(c, BC_PRINT, -1);
+    if (value)
+      emit(c, BC_NIL, 1);
+    break;
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    compile_exp(c, conditional->condition);
+    uint32_t otherwise = emit_jump(c, BC_JUMP_IF_FALSE, -1);
+    compile_stmt(c, conditional->then_branch, value);
+    uint32_t end = emit_jump(c, BC_JUMP, 0);
+    patch_jump(c, otherwise);
+    // Both branches start from the same depth
+    c->depth -= value;
+    if (conditional->else_branch)
+      compile_stmt(c, conditional->else_branch, value);
+    else if (value)
+      emit(c, BC_NIL, 1);
+    patch_jump(c, end);
+    break;
+  }
+  case STMT_BLOCK: {
+    stmt_block_t *block = stmt_unwrap(s);
+    int scope = 0;
+    for (l_list_t current = block->statements; current && !scope;
+         current = current->next)
+      scope = binds(current->data);
+    if (scope)
+      emit(c, BC_SCOPE_ENTER, 0);
+    for (l_list_t current = block->statements; current;
+         current = current->next)
+      compile_stmt(c, current->data, value && current->next == NULL);
+    if (value && block->statements == NULL)
+      emit(c, BC_NIL, 1);
+    if (scope)
+      emit(c, BC_SCOPE_EXIT, 0);
+    break;
+  }
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    compile_exp(c, d->exp);
+    emit(c, s->type == STMT_DECLARATION ? BC_DEFINE : BC_SET, 0);
+    emit_operand(c, symbol(c->b, d->identifier));
+    if (!value)
+      emit(c, BC_POP, -1);
+    break;
+  }
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    compile_function(c, fun);
+    emit(c, BC_DEFINE, 0);
+    emit_operand(c, symbol(c->b, fun->identifier));
+    if (!value)
+      emit(c, BC_POP, -1);
+    break;
+  }
+  default:
+    emit_fail(c, "Unimplemented Error\n");
+    c->depth -= !value;
+    break;
+  }
+  return;
+}
+
+void compile_function(compiler_t *c, stmt_function_t *fun) {
+  bytecode_t *b = c->b;
+  uint32_t over = emit_jump(c, BC_JUMP, 0);
+  bc_function_t f;
+  f.name = symbol(b, fun->identifier);
+  f.entry = b->code_count;
+  f.arity = list_len(fun->formals);
+  f.formals = b->formals_count;
+  b->formals = mem_reserve(b->formals, &b->formals_capacity,
+                           b->formals_count + f.arity, sizeof(uint32_t));
+  b->formals_count += f.arity;
+  // The parser collects the formals in reverse order
+  uint32_t k = f.formals + f.arity;
+  for (l_list_t current = fun->formals; current; current = current->next)
+    b->formals[--k] = symbol(b, current->data);
+  compiler_t body = {b, 0, 0, 1};
+  compile_stmt(&body, fun->body, 1);
+  emit(&body, BC_RETURN, -1);
+  f.max_stack = body.max_depth;
+  patch_jump(c, over);
+  b->functions = mem_reserve(b->functions, &b->functions_capacity,
+                             b->functions_count + 1, sizeof(bc_function_t));
+  b->functions[b->functions_count] = f;
+  emit(c, BC_CLOSURE, 1);
+  emit_operand(c, b->functions_count++);
+  return;
+}
+
+int binds(stmt_t *s) {
+  switch (s->type) {
+  case STMT_DECLARATION:
+  case STMT_FUN:
+    return 1;
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    return binds(conditional->then_branch) ||
+           (conditional->else_branch && binds(conditional->else_branch));
+  }
+  default:
+    return 0;
+  }
+}
+
+void emit(compiler_t *c, bc_opcode_t op, int effect) {
+  bytecode_t *b = c->b;
+  b->code = mem_reserve(b->code, &b->code_capacity, b->code_count + 1,
+                        sizeof(uint8_t));
+  b->code[b->code_count++] = op;
+  c->depth += effect;
+  if (c->depth > c->max_depth)
+    c->max_depth = c->depth;
+  return;
+}
+
+void emit_operand(compiler_t *c, uint32_t operand) {
+  bytecode_t *b = c->b;
+  b->code = mem_reserve(b->code, &b->code_capacity,
+                        b->code_count + sizeof(uint32_t), sizeof(uint8_t));
+  memcpy(b->code + b->code_count, &operand, sizeof(uint32_t));
+  b->code_count += sizeof(uint32_t);
+  return;
+}
+
+void emit_fail(compiler_t *c, const char *message) {
+  vm_value_t v = {.type = T_STRING};
+  v.as.string = strdup(message);
+  // Accounted as a push, it stands for the value that is never produced
+  emit(c, BC_FAIL, 1);
+  emit_operand(c, constant(c->b, v));
+  return;
+}
+
+uint32_t emit_jump(compiler_t *c, bc_opcode_t op, int effect) {
+  emit(c, op, effect);
+  uint32_t at = c->b->code_count;
+  emit_operand(c, 0);
+  return at;
+}
+
+void patch_jump(compiler_t *c, uint32_t at) {
+  uint32_t target = c->b->code_count;
+  memcpy(c->b->code + at, &target, sizeof(uint32_t));
+  return;
+}
+
+uint32_t constant(bytecode_t *b, vm_value_t v) {
+  b->constants = mem_reserve(b->constants, &b->constants_capacity,
+                             b->constants_count + 1, sizeof(vm_value_t));
+  b->constants[b->constants_count] = v;
+  return b->constants_count++;
+}
+
+uint32_t symbol(bytecode_t *b, const char *name) {
+  // Kept at most half full
+  if (2 * (b->symbols_count + 1) > b->buckets_capacity) {
+    uint32_t capacity = b->buckets_capacity ? 2 * b->buckets_capacity
+                                            : BYTECODE_INITIAL_CAPACITY;
+    uint32_t *buckets = mem_calloc(capacity, sizeof(uint32_t));
+    for (uint32_t k = 0; k < b->symbols_count; k++) {
+      uint32_t h = hash(b->symbols[k]) & (capacity - 1);
+      while (buckets[h])
+        h = (h + 1) & (capacity - 1);
+      buckets[h] = k + 1;
+    }
+    mem_free(b->buckets);
+    b->buckets = buckets;
+    b->buckets_capacity = capacity;
+  }
+  // Buckets hold the symbol plus one, zero is an empty bucket
+  uint32_t h = hash(name) & (b->buckets_capacity - 1);
+  while (b->buckets[h]) {
+    if (strcmp(b->symbols[b->buckets[h] - 1], name) == 0)
+      return b->buckets[h] - 1;
+    h = (h + 1) & (b->buckets_capacity - 1);
+  }
+  b->symbols = mem_reserve(b->symbols, &b->symbols_capacity,
+                           b->symbols_count + 1, sizeof(char *));
+  b->symbols[b->symbols_count] = strdup(name);
+  b->buckets[h] = b->symbols_count + 1;
+  return b->symbols_count++;
+}
+
+uint32_t hash(const char *name) {
+  uint32_t h = 2166136261u;
+  for (; *name; name++)
+    h = (h ^ (unsigned char)*name) * 16777619u;
+  return h;
+}
@@ -0,0 +1,153 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#include "list.h"
+#include "syntax.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The instructions of the VM, operands follow the opcode in the code as
+ * native endian 32 bit words (a single byte for the forwarded flag of
+ * BC_CALL and BC_TAIL_CALL)
+ */
+typedef enum {
+  BC_CONSTANT,      // index: push a constant
+  BC_NIL,           // push nil
+  BC_TRUE,          // push true
+  BC_FALSE,         // push false
+  BC_GET,           // symbol: push the value bound to the symbol
+  BC_DEFINE,        // symbol: bind the top of the stack to the symbol
+  BC_SET,           // symbol: change the binding of the symbol, if any
+  BC_POP,           // drop the top of the stack
+  BC_NEGATE,        // unary -
+  BC_NOT,           // unary !
+  BC_ADD,           // binary +, numbers or strings
+  BC_SUBTRACT,      // binary -
+  BC_MULTIPLY,      // binary *
+  BC_DIVIDE,        // binary /
+  BC_MOD,           // binary %
+  BC_GREATER,       // binary >
+  BC_GREATER_EQUAL, // binary >=
+  BC_LESS,          // binary <
+  BC_LESS_EQUAL,    // binary <=
+  BC_EQUAL,         // binary ==
+  BC_NOT_EQUAL,     // binary !=
+  BC_AND,           // target: jump keeping a false left operand, else pop it
+  BC_OR,            // target: jump keeping a true left operand, else pop it
+  BC_BOOLEAN,       // check that the right operand of and/or is a boolean
+  BC_JUMP,          // target: jump
+  BC_JUMP_IF_FALSE, // target: pop the condition and jump if it is false
+  BC_PRINT,         // pop and print the top of the stack
+  BC_CLOSURE,       // function: push a closure
+  BC_CALL,          // symbol, count, forwarded: call the bound closure
+  BC_TAIL_CALL,     // symbol, count, forwarded: replace the current call
+  BC_RETURN,        // return the top of the stack to the caller
+  BC_SCOPE_ENTER,   // remember the bindings of the enclosing block
+  BC_SCOPE_EXIT,    // drop the bindings made since the last BC_SCOPE_ENTER
+  BC_FAIL,          // message: stop with the error in the constant
+  BC_HALT,          // stop the execution
+} bc_opcode_t;
+
+/**
+ * A value handled by the VM, stored inline
+ * @param type a literal_type_t (or VM_UNBOUND for a symbol without binding)
+ * @param as the payload, function is an index in the functions of the
+ * bytecode
+ */
+typedef struct {
+  uint8_t type;
+  union {
+    double number;
+    int boolean;
+    const char *string;
+    uint32_t function;
+  } as;
+} vm_value_t;
+
+#define VM_UNBOUND 0xff
+
+/**
+ * A compiled function
+ * @param name the symbol of the function name
+ * @param entry the offset of the first instruction of the body
+ * @param formals the index of the first formal (a symbol) in the formals of
+ * the bytecode, in source order
+ * @param arity the number of formals
+ * @param max_stack the stack slots needed by the body
+ */
+typedef struct {
+  uint32_t name;
+  uint32_t entry;
+  uint32_t formals;
+  uint32_t arity;
+  uint32_t max_stack;
+} bc_function_t;
+
+/**
+ * A compiled program, it can be extended one statement at a time
+ * @param code the instructions
+ * @param constants the numbers and strings (owned) used by BC_CONSTANT
+ * @param functions the compiled functions
+ * @param formals the symbols of the formals of every function
+ * @param symbols the interned identifiers (owned)
+ * @param buckets an open addressing index of the symbols
+ * @param max_stack the stack slots needed by the top level code
+ */
+typedef struct {
+  uint8_t *code;
+  uint32_t code_count;
+  uint32_t code_capacity;
+  vm_value_t *constants;
+  uint32_t constants_count;
+  uint32_t constants_capacity;
+  bc_function_t *functions;
+  uint32_t functions_count;
+  uint32_t functions_capacity;
+  uint32_t *formals;
+  uint32_t formals_count;
+  uint32_t formals_capacity;
+  char **symbols;
+  uint32_t symbols_count;
+  uint32_t symbols_capacity;
+  uint32_t *buckets;
+  uint32_t buckets_capacity;
+  uint32_t max_stack;
+} bytecode_t;
+
+/**
+ * Initialize the given bytecode
+ * @param b a pointer to the bytecode to initialize
+ */
+void bytecode_init(bytecode_t *);
+
+/**
+ * Compile a list of top level statements
+ * @param b a pointer to the bytecode
+ * @param statements the statements to compile
+ * @return the offset of the first instruction, the code ends with BC_HALT
+ * @note The statements are only read, they can be destroyed afterwards
+ */
+uint32_t bytecode_compile_program(bytecode_t *, l_list_t);
+
+/**
+ * Compile a single top level statement
+ * @param b a pointer to the bytecode
+ * @param s a pointer to the statement to compile
+ * @return the offset of the first instruction, the code ends with BC_HALT
+ */
+uint32_t bytecode_compile(bytecode_t *, stmt_t *);
+
+/**
+ * The memory used by the given bytecode
+ * @param b a pointer to the bytecode
+ * @return the number of bytes of code, constants, functions and formals
+ */
+size_t bytecode_size(bytecode_t *);
+
+/**
+ * Destroy the given bytecode
+ * @param b a pointer to the bytecode to destroy
+ */
+void bytecode_destroy(bytecode_t *);
+
+#endif // !BYTECODE_H
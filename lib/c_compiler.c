@@ -0,0 +1,562 @@
+#include "c_compiler.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define C_COMPILER_INITIAL_CAPACITY 256
+
+/**
+ * The state of the translation of a function (or of the top level code),
+ * the body is written apart since the temporaries are declared before it
+ * @param c a pointer to the translator
+ * @param out the stream of the body
+ * @param body the body written so far
+ * @param temps the number of temporaries (lt_value_t tN) used
+ * @param marks the number of scope marks (uint32_t mN) used
+ * @param args the sizes of the arguments arrays (lt_value_t aN[]) used
+ * @param function 1 inside a function body, where return is allowed
+ * @param returns 1 if the body jumps to the epilogue
+ * @param indent the current indentation level
+ */
+typedef struct {
+  c_compiler_t *c;
+  FILE *out;
+  char *body;
+  size_t body_size;
+  uint32_t temps;
+  uint32_t marks;
+  uint32_t *args;
+  uint32_t args_count;
+  uint32_t args_capacity;
+  int function;
+  int returns;
+  int indent;
+} function_t;
+
+/**
+ * Intern an identifier
+ * @param c a pointer to the translator
+ * @param name the identifier
+ * @return the symbol of the identifier
+ */
+static uint32_t symbol(c_compiler_t *, const char *);
+/**
+ * Hash an identifier
+ * @param name the identifier
+ * @return the FNV-1a hash of the identifier
+ */
+static uint32_t hash(const char *);
+/**
+ * Start the translation of a function body
+ * @param f a pointer to the function state to initialize
+ * @param c a pointer to the translator
+ * @param function 1 for a Lotus function, 0 for the top level code
+ */
+static void function_init(function_t *, c_compiler_t *, int);
+/**
+ * Write the declarations of the temporaries of a function, then its body
+ * @param f a pointer to the function state, destroyed
+ * @param out the stream to write to
+ */
+static void function_flush(function_t *, FILE *);
+/**
+ * Write an indented line of the body
+ * @param f a pointer to the function state
+ * @param fmt the format of the line, without the newline
+ */
+__attribute__((format(printf, 2, 3))) static void line(function_t *,
+                                                      const char *, ...);
+/**
+ * Allocate a temporary
+ * @param f a pointer to the function state
+ * @return the index of the temporary
+ */
+static uint32_t temp(function_t *);
+/**
+ * Write a string as a C string literal
+ * @param out the stream to write to
+ * @param s the string
+ */
+static void write_string(FILE *, const char *);
+/**
+ * Write a line stopping the program with an error
+ * @param f a pointer to the function state
+ * @param message the error message
+ */
+static void emit_fail(function_t *, const char *);
+/**
+ * Translate an expression
+ * @param f a pointer to the function state
+ * @param e a pointer to the expression
+ * @return the temporary holding the value of the expression
+ */
+static uint32_t compile_exp(function_t *, exp_t *);
+/**
+ * Translate a call, the actuals are evaluated from the last one
+ * @param f a pointer to the function state
+ * @param call a pointer to the call
+ * @param forwarded the temporary holding the forwarded value, -1 if none
+ * @return the temporary holding the returned value
+ */
+static uint32_t compile_call(function_t *, exp_call_t *, int64_t);
+/**
+ * Translate a statement
+ * @param f a pointer to the function state
+ * @param s a pointer to the statement
+ * @param dest the variable receiving the value of the statement, NULL if the
+ * value is not used (the last statement of a function body is its result)
+ */
+static void compile_stmt(function_t *, stmt_t *, const char *);
+/**
+ * Translate a function declaration to a C function
+ * @param c a pointer to the translator
+ * @param fun a pointer to the function declaration
+ * @return the index of the function
+ */
+static uint32_t compile_function(c_compiler_t *, stmt_function_t *);
+/**
+ * Check if a statement binds identifiers in the enclosing block
+ * @param s a pointer to the statement
+ * @return 1 if the statement declares something outside a nested block
+ */
+static int binds(stmt_t *);
+
+void c_compiler_init(c_compiler_t *c) {
+  memset(c, 0, sizeof(*c));
+  c->symbols = NULL;
+  c->buckets = NULL;
+  c->functions = NULL;
+  c->prototypes = NULL;
+  c->functions_out = open_memstream(&c->functions, &c->functions_size);
+  c->prototypes_out = open_memstream(&c->prototypes, &c->prototypes_size);
+  return;
+}
+
+int c_compiler_emit(c_compiler_t *c, l_list_t statements, FILE *out) {
+  if (c->functions_out == NULL || c->prototypes_out == NULL)
+    return 0;
+  function_t program;
+  function_init(&program, c, 0);
+  for (l_list_t current = statements; current; current = current->next)
+    compile_stmt(&program, current->data, NULL);
+  fflush(c->functions_out);
+  fflush(c->prototypes_out);
+  long start = ftell(out);
+  fprintf(out, "// Generated by lotus --emit-c, build with:\n"
+               "// gcc -O2 -I lib file.c liblotus.a -lm -lpthread\n"
+               "#include \"runtime.h\"\n\n");
+  fprintf(out, "enum {\n");
+  for (uint32_t k = 0; k < c->symbols_count; k++)
+    fprintf(out, "  sym_%s,\n", c->symbols[k]);
+  fprintf(out, "  LT_SYMBOLS\n};\n\n");
+  fwrite(c->prototypes, 1, c->prototypes_size, out);
+  if (c->prototypes_size)
+    fprintf(out, "\n");
+  fwrite(c->functions, 1, c->functions_size, out);
+  fprintf(out, "static void program(void) {\n");
+  function_flush(&program, out);
+  fprintf(out, "}\n\nint main(void) { return lt_run(LT_SYMBOLS, program); "
+               "}\n");
+  fflush(out);
+  long end = ftell(out);
+  c->size = start >= 0 && end >= start ? (size_t)(end - start) : 0;
+  return !ferror(out);
+}
+
+void c_compiler_destroy(c_compiler_t *c) {
+  if (c->functions_out)
+    fclose(c->functions_out);
+  if (c->prototypes_out)
+    fclose(c->prototypes_out);
+  free(c->functions);
+  free(c->prototypes);
+  for (uint32_t k = 0; k < c->symbols_count; k++)
+    mem_free(c->symbols[k]);
+  mem_free(c->symbols);
+  mem_free(c->buckets);
+  memset(c, 0, sizeof(*c));
+  return;
+}
+
+void function_init(function_t *f, c_compiler_t *c, int function) {
+  memset(f, 0, sizeof(*f));
+  f->c = c;
+  f->body = NULL;
+  f->args = NULL;
+  f->out = open_memstream(&f->body, &f->body_size);
+  f->function = function;
+  f->indent = 1;
+  return;
+}
+
+void function_flush(function_t *f, FILE *out) {
+  fclose(f->out);
+  for (uint32_t k = 0; k < f->temps; k++)
+    fprintf(out, "%s t%u", k % 8 ? "," : k ? ";\n  lt_value_t" : "  lt_value_t",
+            k);
+  if (f->temps)
+    fprintf(out, ";\n");
+  for (uint32_t k = 0; k < f->marks; k++)
+    fprintf(out, "  uint32_t m%u;\n", k);
+  for (uint32_t k = 0; k < f->args_count; k++)
+    fprintf(out, "  lt_value_t a%u[%u];\n", k, f->args[k]);
+  fwrite(f->body, 1, f->body_size, out);
+  free(f->body);
+  mem_free(f->args);
+  return;
+}
+
+void line(function_t *f, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(f->out, "%*s", 2 * f->indent, "");
+  vfprintf(f->out, fmt, ap);
+  fputc('\n', f->out);
+  va_end(ap);
+  return;
+}
+
+uint32_t temp(function_t *f) { return f->temps++; }
+
+void write_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    unsigned char ch = *s;
+    // Octal escapes keep the literal valid whatever the source holds
+    if (ch < 0x20 || ch >= 0x7f || ch == '"' || ch == '\\' || ch == '?')
+      fprintf(out, "\\%03o", ch);
+    else
+      fputc(ch, out);
+  }
+  fputc('"', out);
+  return;
+}
+
+void emit_fail(function_t *f, const char *message) {
+  fprintf(f->out, "%*slt_error(", 2 * f->indent, "");
+  write_string(f->out, message);
+  fprintf(f->out, ");\n");
+  return;
+}
+
+uint32_t compile_exp(function_t *f, exp_t *e) {
+  uint32_t t;
+  switch (e->type) {
+  case EXP_LITERAL: {
+    exp_literal_t *l = exp_unwrap(e);
+    t = temp(f);
+    switch (l->type) {
+    case T_NUMBER:
+      // A folded literal may be any double, the sign of a NaN or a zero
+      // shows when it is printed
+      if (isnan(l->value.number))
+        line(f, "t%u = lt_number(%sNAN);", t,
+             signbit(l->value.number) ? "-" : "");
+      else if (isinf(l->value.number))
+        line(f, "t%u = lt_number(%sHUGE_VAL);", t,
+             l->value.number < 0 ? "-" : "");
+      else if (l->value.number == 0 && signbit(l->value.number))
+        line(f, "t%u = lt_number(-0.0);", t);
+      else
+        line(f, "t%u = lt_number(%.17g);", t, l->value.number);
+      break;
+    case T_STRING:
+      fprintf(f->out, "%*st%u = lt_string(", 2 * f->indent, "", t);
+      write_string(f->out, l->value.string);
+      fprintf(f->out, ");\n");
+      break;
+    case T_BOOLEAN:
+      line(f, "t%u = lt_boolean(%d);", t, l->value.boolean ? 1 : 0);
+      break;
+    default:
+      line(f, "t%u = lt_nil();", t);
+      break;
+    }
+    return t;
+  }
+  case EXP_IDENTIFIER: {
+    const char *name = ((exp_identifier_t *)exp_unwrap(e))->identifier;
+    symbol(f->c, name);
+    t = temp(f);
+    line(f, "t%u = lt_get(sym_%s, \"%s\");", t, name, name);
+    return t;
+  }
+  case EXP_GROUPING:
+    return compile_exp(f, ((exp_grouping_t *)exp_unwrap(e))->exp);
+  case EXP_UNARY: {
+    exp_unary_t *u = exp_unwrap(e);
+    uint32_t right = compile_exp(f, u->right);
+    t = temp(f);
+    line(f, "t%u = %s(t%u);", t, u->op == OP_MINUS ? "lt_negate" : "lt_not",
+         right);
+    return t;
+  }
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    if (b->op == OP_FORWARD) {
+      // Checked before evaluating the left side, like the tree walker does
+      if (b->right->type != EXP_CALL) {
+        emit_fail(f, "Expected a function call after |>\n");
+        t = temp(f);
+        line(f, "t%u = lt_nil();", t);
+        return t;
+      }
+      uint32_t left = compile_exp(f, b->left);
+      return compile_call(f, exp_unwrap(b->right), left);
+    }
+    uint32_t left = compile_exp(f, b->left);
+    if (b->op == OP_AND || b->op == OP_OR) {
+      // The right side is evaluated only if the left one does not decide
+      t = temp(f);
+      line(f, "lt_check_boolean(t%u);", left);
+      line(f, "t%u = t%u;", t, left);
+      line(f, "if (%st%u.as.boolean) {", b->op == OP_AND ? "" : "!", left);
+      f->indent++;
+      uint32_t right = compile_exp(f, b->right);
+      line(f, "lt_check_boolean(t%u);", right);
+      line(f, "t%u = t%u;", t, right);
+      f->indent--;
+      line(f, "}");
+      return t;
+    }
+    uint32_t right = compile_exp(f, b->right);
+    static const char *const functions[] = {
+        [OP_PLUS] = "lt_add",
+        [OP_MINUS] = "lt_subtract",
+        [OP_STAR] = "lt_multiply",
+        [OP_SLASH] = "lt_divide",
+        [OP_MOD] = "lt_mod",
+        [OP_GREATER] = "lt_greater",
+        [OP_GREATER_EQUAL] = "lt_greater_equal",
+        [OP_LESS] = "lt_less",
+        [OP_LESS_EQUAL] = "lt_less_equal",
+        [OP_EQUAL] = "lt_equal",
+        [OP_NOT_EQUAL] = "lt_not_equal",
+    };
+    t = temp(f);
+    line(f, "t%u = %s(t%u, t%u);", t, functions[b->op], left, right);
+    return t;
+  }
+  case EXP_CALL:
+    return compile_call(f, exp_unwrap(e), -1);
+  default:
+    __builtin_unreachable();
+  }
+}
+
+uint32_t compile_call(function_t *f, exp_call_t *call, int64_t forwarded) {
+  uint32_t count = list_len(call->actuals) + (forwarded >= 0);
+  symbol(f->c, call->identifier);
+  uint32_t t = temp(f);
+  if (count == 0) {
+    line(f, "t%u = lt_call(sym_%s, \"%s\", NULL, 0);", t, call->identifier,
+         call->identifier);
+    return t;
+  }
+  f->args = mem_reserve(f->args, &f->args_capacity, f->args_count + 1,
+                        sizeof(uint32_t));
+  uint32_t a = f->args_count;
+  f->args[f->args_count++] = count;
+  // The arguments are passed in source order, the forwarded value first
+  if (forwarded >= 0)
+    line(f, "a%u[0] = t%u;", a, (uint32_t)forwarded);
+  // The parser collects the actuals in reverse order, the tree walker
+  // evaluates them in that order
+  uint32_t k = count;
+  for (l_list_t current = call->actuals; current; current = current->next) {
+    uint32_t v = compile_exp(f, current->data);
+    line(f, "a%u[%u] = t%u;", a, --k, v);
+  }
+  line(f, "t%u = lt_call(sym_%s, \"%s\", a%u, %u);", t, call->identifier,
+       call->identifier, a, count);
+  return t;
+}
+
+void compile_stmt(function_t *f, stmt_t *s, const char *dest) {
+  switch (s->type) {
+  case STMT_EXPR: {
+    uint32_t v = compile_exp(f, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    if (dest)
+      line(f, "%s = t%u;", dest, v);
+    break;
+  }
+  case STMT_RETURN: {
+    // Checked before evaluating the returned value, like the tree walker does
+    if (!f->function) {
+      emit_fail(f, "return can used only inside a function\n");
+      if (dest)
+        line(f, "%s = lt_nil();", dest);
+      break;
+    }
+    uint32_t v = compile_exp(f, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    line(f, "r = t%u;", v);
+    line(f, "goto end;");
+    f->returns = 1;
+    break;
+  }
+  case STMT_PRINT: {
+    uint32_t v = compile_exp(f, ((stmt_print_t *)stmt_unwrap(s))->exp);
+    line(f, "lt_print(t%u);", v);
+    if (dest)
+      line(f, "%s = lt_nil();", dest);
+    break;
+  }
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    uint32_t condition = compile_exp(f, conditional->condition);
+    line(f, "if (lt_truthy(t%u)) {", condition);
+    f->indent++;
+    compile_stmt(f, conditional->then_branch, dest);
+    f->indent--;
+    if (conditional->else_branch || dest) {
+      line(f, "} else {");
+      f->indent++;
+      if (conditional->else_branch)
+        compile_stmt(f, conditional->else_branch, dest);
+      else
+        line(f, "%s = lt_nil();", dest);
+      f->indent--;
+    }
+    line(f, "}");
+    break;
+  }
+  case STMT_BLOCK: {
+    stmt_block_t *block = stmt_unwrap(s);
+    int scope = 0;
+    for (l_list_t current = block->statements; current && !scope;
+         current = current->next)
+      scope = binds(current->data);
+    uint32_t mark = f->marks;
+    if (scope) {
+      f->marks++;
+      line(f, "m%u = lt_mark();", mark);
+    }
+    for (l_list_t current = block->statements; current;
+         current = current->next)
+      compile_stmt(f, current->data, current->next == NULL ? dest : NULL);
+    if (dest && block->statements == NULL)
+      line(f, "%s = lt_nil();", dest);
+    if (scope)
+      line(f, "lt_restore(m%u);", mark);
+    break;
+  }
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    uint32_t v = compile_exp(f, d->exp);
+    symbol(f->c, d->identifier);
+    line(f, "%s(sym_%s, t%u);",
+         s->type == STMT_DECLARATION ? "lt_bind" : "lt_set", d->identifier,
+         v);
+    if (dest)
+      line(f, "%s = t%u;", dest, v);
+    break;
+  }
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    uint32_t k = compile_function(f->c, fun);
+    symbol(f->c, fun->identifier);
+    line(f, "lt_bind(sym_%s, lt_closure(&function_%u_%s));", fun->identifier,
+         k, fun->identifier);
+    if (dest)
+      line(f, "%s = lt_closure(&function_%u_%s);", dest, k, fun->identifier);
+    break;
+  }
+  default:
+    emit_fail(f, "Unimplemented Error\n");
+    if (dest)
+      line(f, "%s = lt_nil();", dest);
+    break;
+  }
+  return;
+}
+
+uint32_t compile_function(c_compiler_t *c, stmt_function_t *fun) {
+  uint32_t k = c->functions_count++;
+  uint32_t arity = list_len(fun->formals);
+  fprintf(c->prototypes_out,
+          "static lt_value_t fun_%u_%s(lt_value_t *, uint32_t);\n"
+          "static const lt_function_t function_%u_%s = {\"%s\", "
+          "fun_%u_%s};\n",
+          k, fun->identifier, k, fun->identifier, fun->identifier, k,
+          fun->identifier);
+  function_t body;
+  function_init(&body, c, 1);
+  line(&body, "uint32_t mark = lt_enter(count, %u);", arity);
+  // The parser collects the formals in reverse order, the last one is bound
+  // first as the tree walker does
+  uint32_t j = arity;
+  for (l_list_t current = fun->formals; current; current = current->next) {
+    symbol(c, current->data);
+    line(&body, "lt_bind(sym_%s, args[%u]);", (char *)current->data, --j);
+  }
+  compile_stmt(&body, fun->body, "r");
+  if (body.returns)
+    fprintf(body.out, "end:\n");
+  line(&body, "lt_leave(mark);");
+  line(&body, "return r;");
+  // Nested functions are written first, the definition follows them
+  FILE *out = c->functions_out;
+  fprintf(out,
+          "static lt_value_t fun_%u_%s(lt_value_t *args, uint32_t count) {\n"
+          "  lt_value_t r;\n",
+          k, fun->identifier);
+  function_flush(&body, out);
+  fprintf(out, "}\n\n");
+  return k;
+}
+
+int binds(stmt_t *s) {
+  switch (s->type) {
+  case STMT_DECLARATION:
+  case STMT_FUN:
+    return 1;
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    return binds(conditional->then_branch) ||
+           (conditional->else_branch && binds(conditional->else_branch));
+  }
+  default:
+    return 0;
+  }
+}
+
+uint32_t symbol(c_compiler_t *c, const char *name) {
+  // Kept at most half full
+  if (2 * (c->symbols_count + 1) > c->buckets_capacity) {
+    uint32_t capacity = c->buckets_capacity ? 2 * c->buckets_capacity
+                                            : C_COMPILER_INITIAL_CAPACITY;
+    uint32_t *buckets = mem_calloc(capacity, sizeof(uint32_t));
+    for (uint32_t k = 0; k < c->symbols_count; k++) {
+      uint32_t h = hash(c->symbols[k]) & (capacity - 1);
+      while (buckets[h])
+        h = (h + 1) & (capacity - 1);
+      buckets[h] = k + 1;
+    }
+    mem_free(c->buckets);
+    c->buckets = buckets;
+    c->buckets_capacity = capacity;
+  }
+  // Buckets hold the symbol plus one, zero is an empty bucket
+  uint32_t h = hash(name) & (c->buckets_capacity - 1);
+  while (c->buckets[h]) {
+    if (strcmp(c->symbols[c->buckets[h] - 1], name) == 0)
+      return c->buckets[h] - 1;
+    h = (h + 1) & (c->buckets_capacity - 1);
+  }
+  c->symbols = mem_reserve(c->symbols, &c->symbols_capacity,
+                           c->symbols_count + 1, sizeof(char *));
+  c->symbols[c->symbols_count] = strdup(name);
+  c->buckets[h] = c->symbols_count + 1;
+  return c->symbols_count++;
+}
+
+uint32_t hash(const char *name) {
+  uint32_t h = 2166136261u;
+  for (; *name; name++)
+    h = (h ^ (unsigned char)*name) * 16777619u;
+  return h;
+}
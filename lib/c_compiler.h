@@ -0,0 +1,57 @@
+#ifndef C_COMPILER_H
+#define C_COMPILER_H
+#include "list.h"
+#include "syntax.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * A translator of the AST to a C program running on the Lotus runtime
+ * (runtime.h), every function becomes a C function and the top level
+ * statements become the body of main
+ * @param symbols the interned identifiers (owned)
+ * @param buckets an open addressing index of the symbols
+ * @param functions the definitions of the C functions written so far
+ * @param functions_count the number of Lotus functions translated
+ * @param size the size of the last C program written, in bytes
+ */
+typedef struct {
+  char **symbols;
+  uint32_t symbols_count;
+  uint32_t symbols_capacity;
+  uint32_t *buckets;
+  uint32_t buckets_capacity;
+  char *functions;
+  size_t functions_size;
+  FILE *functions_out;
+  char *prototypes;
+  size_t prototypes_size;
+  FILE *prototypes_out;
+  uint32_t functions_count;
+  size_t size;
+} c_compiler_t;
+
+/**
+ * Initialize the given translator
+ * @param c a pointer to the translator to initialize
+ */
+void c_compiler_init(c_compiler_t *);
+
+/**
+ * Translate a program to C
+ * @param c a pointer to the translator
+ * @param statements the top level statements of the program
+ * @param out the stream the C program is written to
+ * @return 1 on success, 0 if the program could not be written
+ * @note The statements are only read, they can be destroyed afterwards
+ */
+int c_compiler_emit(c_compiler_t *, l_list_t, FILE *);
+
+/**
+ * Destroy the given translator
+ * @param c a pointer to the translator to destroy
+ */
+void c_compiler_destroy(c_compiler_t *);
+
+#endif // !C_COMPILER_H
@@ -0,0 +1,209 @@
+#include "cache.h"
+#include "config.h"
+#include "flat.h"
+#include "memory.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "LTSC"
+#define CACHE_FORMAT 2
+#define CACHE_HASH_SEED 0x4c6f747573ULL
+
+_Static_assert(sizeof(cache_header_t) == 64,
+               "the cache header must keep the nodes aligned");
+
+/**
+ * The offsets of the arrays of a flat AST inside a cache file
+ */
+typedef struct {
+  size_t nodes;
+  size_t lists;
+  size_t numbers;
+  size_t chars;
+  size_t end;
+} cache_layout_t;
+
+/**
+ * Compute where the arrays are stored in a cache file
+ * @param h a pointer to the header of the cache file
+ * @return the offsets of the arrays
+ */
+static cache_layout_t layout(const cache_header_t *);
+/**
+ * Hash a sequence of bytes, eight of them at a time
+ * @param data the bytes to hash
+ * @param size the number of bytes
+ * @return the hash
+ */
+static uint64_t hash_bytes(const unsigned char *, size_t);
+/**
+ * Write the given bytes followed by a zero padding
+ * @param file the file to write to
+ * @param data the bytes to write
+ * @param size the number of bytes
+ * @param padding the number of zero bytes to append
+ * @return 1 on success, 0 otherwise
+ */
+static int write_padded(FILE *, const void *, size_t, size_t);
+
+char *cache_path(const char *source_path) {
+  size_t length = strlen(source_path);
+  char *path = mem_calloc(length + sizeof(CACHE_EXTENSION), sizeof(char));
+  memcpy(path, source_path, length);
+  // "file.lts" becomes "file.ltsc", anything else gets the whole extension
+  if (length >= 4 && strcmp(source_path + length - 4, ".lts") == 0)
+    strcat(path, "c");
+  else
+    strcat(path, CACHE_EXTENSION);
+  return path;
+}
+
+int cache_hash_source(const char *source_path, uint64_t *hash,
+                      uint64_t *size) {
+  int fd = open(source_path, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return 0;
+  }
+  *size = st.st_size;
+  if (st.st_size == 0) {
+    *hash = hash_bytes(NULL, 0);
+    close(fd);
+    return 1;
+  }
+  void *source = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (source == MAP_FAILED)
+    return 0;
+  madvise(source, st.st_size, MADV_SEQUENTIAL);
+  *hash = hash_bytes(source, st.st_size);
+  munmap(source, st.st_size);
+  return 1;
+}
+
+int cache_load(const char *path, uint64_t hash, uint64_t size, flat_ast_t *f,
+               flat_index_t *program) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(cache_header_t)) {
+    close(fd);
+    return 0;
+  }
+  void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return 0;
+  const cache_header_t *h = mapping;
+  char version[sizeof(h->version)] = LOTUS_VERSION;
+  cache_layout_t l = layout(h);
+  if (memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+      h->format != CACHE_FORMAT ||
+      memcmp(h->version, version, sizeof(version)) != 0 || h->hash != hash ||
+      h->source_size != size || l.end != (size_t)st.st_size ||
+      h->program >= h->lists_count) {
+    munmap(mapping, st.st_size);
+    return 0;
+  }
+  char *base = mapping;
+  f->nodes = (flat_node_t *)(base + l.nodes);
+  f->nodes_count = h->nodes_count;
+  f->lists = (flat_index_t *)(base + l.lists);
+  f->lists_count = h->lists_count;
+  f->numbers = (double *)(base + l.numbers);
+  f->numbers_count = h->numbers_count;
+  f->chars = base + l.chars;
+  f->chars_count = h->chars_count;
+  f->mapping = mapping;
+  f->mapping_size = st.st_size;
+  *program = h->program;
+  return 1;
+}
+
+int cache_store(const char *path, uint64_t hash, uint64_t size, flat_ast_t *f,
+                flat_index_t program) {
+  cache_header_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+  h.format = CACHE_FORMAT;
+  strncpy(h.version, LOTUS_VERSION, sizeof(h.version) - 1);
+  h.hash = hash;
+  h.source_size = size;
+  h.nodes_count = f->nodes_count;
+  h.lists_count = f->lists_count;
+  h.numbers_count = f->numbers_count;
+  h.chars_count = f->chars_count;
+  h.program = program;
+  cache_layout_t l = layout(&h);
+  // Written aside and renamed, so readers see either nothing or everything
+  size_t length = strlen(path) + 32;
+  char *tmp = mem_calloc(length, sizeof(char));
+  snprintf(tmp, length, "%s.%d.tmp", path, (int)getpid());
+  FILE *file = fopen(tmp, "wb");
+  if (file == NULL) {
+    mem_free(tmp);
+    return 0;
+  }
+  int ok =
+      write_padded(file, &h, sizeof(h), 0) &&
+      write_padded(file, f->nodes, h.nodes_count * sizeof(flat_node_t), 0) &&
+      write_padded(file, f->lists, h.lists_count * sizeof(flat_index_t),
+                   l.numbers - (l.lists + h.lists_count *
+                                              sizeof(flat_index_t))) &&
+      write_padded(file, f->numbers, h.numbers_count * sizeof(double), 0) &&
+      write_padded(file, f->chars, h.chars_count, 0);
+  ok = fclose(file) == 0 && ok;
+  if (ok)
+    ok = rename(tmp, path) == 0;
+  if (!ok)
+    unlink(tmp);
+  mem_free(tmp);
+  return ok;
+}
+
+cache_layout_t layout(const cache_header_t *h) {
+  cache_layout_t l;
+  l.nodes = sizeof(cache_header_t);
+  l.lists = l.nodes + (size_t)h->nodes_count * sizeof(flat_node_t);
+  l.numbers = l.lists + (size_t)h->lists_count * sizeof(flat_index_t);
+  l.numbers = (l.numbers + sizeof(double) - 1) & ~(sizeof(double) - 1);
+  l.chars = l.numbers + (size_t)h->numbers_count * sizeof(double);
+  l.end = l.chars + h->chars_count;
+  return l;
+}
+
+uint64_t hash_bytes(const unsigned char *data, size_t size) {
+  uint64_t h = CACHE_HASH_SEED ^ (size * 0x9e3779b97f4a7c15ULL);
+  size_t k = 0;
+  for (; k + sizeof(uint64_t) <= size; k += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, data + k, sizeof(w));
+    w *= 0xff51afd7ed558ccdULL;
+    w ^= w >> 32;
+    h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+  uint64_t tail = 0;
+  if (size > k)
+    memcpy(&tail, data + k, size - k);
+  h = (h ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+int write_padded(FILE *file, const void *data, size_t size, size_t padding) {
+  static const char zeros[sizeof(double)] = {0};
+  if (size > 0 && fwrite(data, 1, size, file) != size)
+    return 0;
+  return padding == 0 || fwrite(zeros, 1, padding, file) == padding;
+}
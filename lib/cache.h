@@ -0,0 +1,77 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include "flat.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_EXTENSION ".ltsc"
+
+/**
+ * The header of a cache file, followed by the arrays of a flat AST (nodes,
+ * lists, numbers and chars, each one aligned to its element size)
+ * @param magic always "LTSC"
+ * @param format the layout version of the file
+ * @param version the LOTUS_VERSION of the interpreter that wrote the file
+ * @param hash the hash of the source the file was compiled from
+ * @param source_size the size of the source the file was compiled from
+ * @param program the index of the list of top level statements
+ */
+typedef struct {
+  char magic[4];
+  uint32_t format;
+  char version[16];
+  uint64_t hash;
+  uint64_t source_size;
+  uint32_t nodes_count;
+  uint32_t lists_count;
+  uint32_t numbers_count;
+  uint32_t chars_count;
+  flat_index_t program;
+  uint32_t padding;
+} cache_header_t;
+
+/**
+ * Get the path of the cache file of a source
+ * @param source_path the path of the source
+ * @return a new allocated string, "file.lts" becomes "file.ltsc"
+ */
+char *cache_path(const char *);
+
+/**
+ * Hash the content of a source file
+ * @param source_path the path of the source
+ * @param hash a pointer where the hash is stored
+ * @param size a pointer where the size of the source is stored
+ * @return 1 on success, 0 if the source is not a readable regular file
+ */
+int cache_hash_source(const char *, uint64_t *, uint64_t *);
+
+/**
+ * Map a cache file in memory
+ * @param path the path of the cache file
+ * @param hash the hash of the current source
+ * @param size the size of the current source
+ * @param f a pointer to an initialized (empty) flat AST
+ * @param program a pointer where the index of the program is stored
+ * @return 1 if the cache is valid, 0 otherwise (f is left empty)
+ * @note On success the arrays of f point inside the read-only mapping, no
+ * copy is made, flat_destroy unmaps it
+ */
+int cache_load(const char *, uint64_t, uint64_t, flat_ast_t *,
+               flat_index_t *);
+
+/**
+ * Write a flat AST to a cache file
+ * @param path the path of the cache file
+ * @param hash the hash of the source
+ * @param size the size of the source
+ * @param f a pointer to the flat AST
+ * @param program the index of the list of top level statements
+ * @return 1 on success, 0 otherwise
+ * @note The file is written aside and renamed, concurrent runs never see a
+ * partial cache
+ */
+int cache_store(const char *, uint64_t, uint64_t, flat_ast_t *,
+                flat_index_t);
+
+#endif // !CACHE_H
@@ -1,6 +1,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#define LOTUS_VERSION "0.2.0"
+
 char *config_read(char *);
 
 #endif // !CONFIG_H
@@ -0,0 +1,678 @@
+#include "direct_interpreter.h"
+#include "arena.h"
+#include "environment.h"
+#include "garbage.h"
+#include "interpreter.h"
+#include "list.h"
+#include "syntax.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct direct_node direct_node_t;
+
+/**
+ * The evaluation function of a node
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the node to evaluate
+ * @return the value obtained
+ */
+typedef value_t (*direct_eval_t)(interpreter_t *, direct_node_t *);
+
+/**
+ * A node of the translated tree, the operator and the kind of the AST node
+ * are encoded by the evaluation function, the children are already unwrapped
+ * @param eval the function evaluating the node
+ * @param as the operands of the node
+ */
+struct direct_node {
+  direct_eval_t eval;
+  union {
+    value_t constant;
+    struct {
+      char *identifier;
+      uint32_t symbol;
+    } identifier;
+    direct_node_t *child;
+    struct {
+      direct_node_t *left;
+      direct_node_t *right;
+      double constant;
+    } binary;
+    struct {
+      char *identifier;
+      uint32_t symbol;
+      direct_node_t **actuals;
+      int count;
+      int tail;
+    } call;
+    struct {
+      direct_node_t *condition;
+      direct_node_t *then_branch;
+      direct_node_t *else_branch;
+    } conditional;
+    struct {
+      direct_node_t **statements;
+      int count;
+    } block;
+    struct {
+      uint32_t symbol;
+      direct_node_t *exp;
+    } binding;
+    struct {
+      stmt_function_t *function;
+      uint32_t arity;
+      direct_node_t *body;
+    } function;
+  } as;
+};
+
+/**
+ * Translate an expression
+ * @param a a pointer to the arena holding the nodes
+ * @param e a pointer to the expression
+ * @return a pointer to the new node
+ */
+static direct_node_t *compile_exp(arena_t *, exp_t *);
+/**
+ * Translate a binary expression, a number literal on the right side selects
+ * an evaluation function that does not evaluate nor check it
+ * @param a a pointer to the arena holding the nodes
+ * @param n a pointer to the node to fill
+ * @param b a pointer to the binary expression
+ */
+static void compile_binary(arena_t *, direct_node_t *, exp_binary_t *);
+/**
+ * Translate a call expression
+ * @param a a pointer to the arena holding the nodes
+ * @param n a pointer to the node to fill
+ * @param call a pointer to the call expression
+ */
+static void compile_call(arena_t *, direct_node_t *, exp_call_t *);
+/**
+ * Translate a statement
+ * @param a a pointer to the arena holding the nodes
+ * @param s a pointer to the statement
+ * @return a pointer to the new node
+ */
+static direct_node_t *compile_stmt(arena_t *, stmt_t *);
+/**
+ * Build the value of a literal, shared by every evaluation (a string lives in
+ * the arena)
+ * @param a a pointer to the arena holding the value
+ * @param l a pointer to the literal
+ * @return the value
+ */
+static value_t constant(arena_t *, exp_literal_t *);
+/**
+ * Check if an expression is a number literal
+ * @param e a pointer to the expression
+ * @param n a pointer where the number is stored
+ * @return 1 if the expression is a number literal, 0 otherwise
+ */
+static int number_literal(exp_t *, double *);
+/**
+ * Call the closure bound to a name
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the call node
+ * @param forwarded a pointer to a forwarded value to be used as a first
+ * argument
+ * @return the value obtained
+ */
+static value_t call(interpreter_t *, direct_node_t *, value_t *);
+/**
+ * Turn a specialized binary node generic for good once its left side failed
+ * the guard, then finish its evaluation
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the binary node
+ * @param generic the generic evaluation function of the operator
+ * @param op the operator
+ * @param left the left side value, already evaluated
+ * @return the value obtained
+ */
+static value_t deoptimize(interpreter_t *, direct_node_t *, direct_eval_t,
+                          operator_t, value_t);
+
+void direct_interpreter_eval(interpreter_t *interpreter, arena_t *arena,
+                             l_list_t statements) {
+  for (l_list_t current = statements; current; current = current->next)
+    direct_interpreter_eval_statement(interpreter, arena, current->data);
+  return;
+}
+
+void direct_interpreter_eval_statement(interpreter_t *interpreter,
+                                       arena_t *arena, stmt_t *statement) {
+  direct_node_t *n = compile_stmt(arena, statement);
+  n->eval(interpreter, n);
+  return;
+}
+
+/********************************************************************
+ *                          Expressions                             *
+ ********************************************************************/
+
+static value_t eval_constant(interpreter_t *i, direct_node_t *n) {
+  return n->as.constant;
+}
+
+static value_t eval_identifier(interpreter_t *i, direct_node_t *n) {
+  value_t v;
+  if (!env_get(i->environment, n->as.identifier.symbol, &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      n->as.identifier.identifier);
+  return v;
+}
+
+static value_t eval_negate(interpreter_t *i, direct_node_t *n) {
+  value_t right = n->as.child->eval(i, n->as.child);
+  if (!value_is_number(right))
+    interpreter_error(i, "Type Error:\t Operand must be a number\n");
+  return value_number(-value_as_number(right));
+}
+
+static value_t eval_not(interpreter_t *i, direct_node_t *n) {
+  value_t right = n->as.child->eval(i, n->as.child);
+  return value_boolean(!interpreter_is_truthy(i, right));
+}
+
+// Both operands are evaluated and held like the tree walker does
+#define OPERANDS()                                                             \
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);                \
+  gc_hold(i->garbage_collector, left);                                         \
+  value_t right = n->as.binary.right->eval(i, n->as.binary.right);             \
+  gc_hold(i->garbage_collector, right);
+
+// An arithmetic or comparison operator on numbers, and its variant with a
+// number literal on the right side
+#define NUMERIC(name, init, operator)                                          \
+  static value_t eval_##name(interpreter_t *i, direct_node_t *n) {             \
+    OPERANDS();                                                                \
+    if (!value_is_number(left) || !value_is_number(right))                     \
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");        \
+    double l = value_as_number(left), r = value_as_number(right);              \
+    gc_release(i->garbage_collector, 2);                                       \
+    return init(l operator r);                                                 \
+  }                                                                            \
+  static value_t eval_##name##_constant(interpreter_t *i, direct_node_t *n) {  \
+    value_t left = n->as.binary.left->eval(i, n->as.binary.left);              \
+    if (!value_is_number(left))                                                \
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");        \
+    return init(value_as_number(left) operator n->as.binary.constant);         \
+  }
+
+NUMERIC(subtract, value_number, -)
+NUMERIC(multiply, value_number, *)
+NUMERIC(divide, value_number, /)
+NUMERIC(greater, value_boolean, >)
+NUMERIC(greater_equal, value_boolean, >=)
+NUMERIC(less, value_boolean, <)
+NUMERIC(less_equal, value_boolean, <=)
+
+#undef NUMERIC
+
+// An operator accepting several types observes its first operands and
+// rewrites its node into the variant for numbers if it saw two of them, the
+// variant rewrites it into the generic one as soon as its guard fails
+#define QUICKENED(name, op, init, operator)                                    \
+  static value_t eval_##name##_generic(interpreter_t *i, direct_node_t *n) {   \
+    OPERANDS();                                                                \
+    value_t result = interpreter_binary(i, op, left, right);                   \
+    gc_release(i->garbage_collector, 2);                                       \
+    return result;                                                             \
+  }                                                                            \
+  static value_t eval_##name##_numbers(interpreter_t *i, direct_node_t *n) {   \
+    value_t left = n->as.binary.left->eval(i, n->as.binary.left);              \
+    if (!value_is_number(left))                                                \
+      return deoptimize(i, n, eval_##name##_generic, op, left);                \
+    value_t right = n->as.binary.right->eval(i, n->as.binary.right);           \
+    if (!value_is_number(right)) {                                             \
+      n->eval = eval_##name##_generic;                                         \
+      i->deoptimized++;                                                        \
+      return interpreter_binary(i, op, left, right);                           \
+    }                                                                          \
+    return init(value_as_number(left) operator value_as_number(right));        \
+  }                                                                            \
+  static value_t eval_##name(interpreter_t *i, direct_node_t *n) {             \
+    OPERANDS();                                                                \
+    if (value_is_number(left) && value_is_number(right)) {                     \
+      n->eval = eval_##name##_numbers;                                         \
+      i->quickened++;                                                          \
+    } else {                                                                   \
+      n->eval = eval_##name##_generic;                                         \
+    }                                                                          \
+    value_t result = interpreter_binary(i, op, left, right);                   \
+    gc_release(i->garbage_collector, 2);                                       \
+    return result;                                                             \
+  }
+
+QUICKENED(add, OP_PLUS, value_number, +)
+QUICKENED(equal, OP_EQUAL, value_boolean, ==)
+QUICKENED(not_equal, OP_NOT_EQUAL, value_boolean, !=)
+
+#undef QUICKENED
+
+static value_t eval_add_constant(interpreter_t *i, direct_node_t *n) {
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);
+  if (!value_is_number(left))
+    interpreter_error(
+        i, "Type Error:\t Operands must be two numbers or two strings\n");
+  return value_number(value_as_number(left) + n->as.binary.constant);
+}
+
+static value_t eval_mod(interpreter_t *i, direct_node_t *n) {
+  OPERANDS();
+  value_t result = interpreter_binary(i, OP_MOD, left, right);
+  gc_release(i->garbage_collector, 2);
+  return result;
+}
+
+static value_t eval_mod_constant(interpreter_t *i, direct_node_t *n) {
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);
+  if (!value_is_number(left))
+    interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+  return value_number(fmod(value_as_number(left), n->as.binary.constant));
+}
+
+static value_t eval_equal_constant(interpreter_t *i, direct_node_t *n) {
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);
+  if (!value_is_number(left))
+    interpreter_error(i,
+                      "Type Error:\tComparison between 2 different type!\n");
+  return value_boolean(value_as_number(left) == n->as.binary.constant);
+}
+
+static value_t eval_not_equal_constant(interpreter_t *i, direct_node_t *n) {
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);
+  if (!value_is_number(left))
+    interpreter_error(i,
+                      "Type Error:\tComparison between 2 different type!\n");
+  return value_boolean(value_as_number(left) != n->as.binary.constant);
+}
+
+#undef OPERANDS
+
+// A short circuit operator, the result is the right side when it is reached
+#define LOGIC(name, shortcut)                                                  \
+  static value_t eval_##name(interpreter_t *i, direct_node_t *n) {             \
+    value_t left = n->as.binary.left->eval(i, n->as.binary.left);              \
+    if (!value_is_boolean(left))                                               \
+      interpreter_error(i, "Type Error:\t Operands must be booleans\n");       \
+    if (value_as_boolean(left) == shortcut)                                    \
+      return left;                                                             \
+    gc_hold(i->garbage_collector, left);                                       \
+    value_t right = n->as.binary.right->eval(i, n->as.binary.right);           \
+    if (!value_is_boolean(right))                                              \
+      interpreter_error(i, "Type Error:\t Operands must be booleans\n");       \
+    gc_release(i->garbage_collector, 1);                                       \
+    return right;                                                              \
+  }
+
+LOGIC(and, 0)
+LOGIC(or, 1)
+
+#undef LOGIC
+
+static value_t eval_forward(interpreter_t *i, direct_node_t *n) {
+  value_t left = n->as.binary.left->eval(i, n->as.binary.left);
+  gc_hold(i->garbage_collector, left);
+  value_t result = call(i, n->as.binary.right, &left);
+  gc_release(i->garbage_collector, 1);
+  return result;
+}
+
+static value_t eval_forward_error(interpreter_t *i, direct_node_t *n) {
+  interpreter_error(i, "Expected a function call after |>\n");
+}
+
+static value_t eval_call(interpreter_t *i, direct_node_t *n) {
+  return call(i, n, NULL);
+}
+
+/********************************************************************
+ *                          Statements                              *
+ ********************************************************************/
+
+static value_t eval_return(interpreter_t *i, direct_node_t *n) {
+  if (i->depth == 0)
+    interpreter_error(i, "return can used only inside a function\n");
+  value_t v = n->as.child->eval(i, n->as.child);
+  // The enclosing statements stop and pass the value up to the call
+  i->returning = 1;
+  return v;
+}
+
+static value_t eval_print(interpreter_t *i, direct_node_t *n) {
+  interpreter_print(n->as.child->eval(i, n->as.child));
+  return VALUE_NIL;
+}
+
+static value_t eval_if(interpreter_t *i, direct_node_t *n) {
+  direct_node_t *condition = n->as.conditional.condition;
+  if (interpreter_is_truthy(i, condition->eval(i, condition)))
+    return n->as.conditional.then_branch->eval(i,
+                                               n->as.conditional.then_branch);
+  if (n->as.conditional.else_branch)
+    return n->as.conditional.else_branch->eval(i,
+                                               n->as.conditional.else_branch);
+  return VALUE_NIL;
+}
+
+static value_t eval_block(interpreter_t *i, direct_node_t *n) {
+  int old_size = i->environment->size;
+  value_t v = VALUE_NIL;
+  int k = 0;
+  for (; k < n->as.block.count && !i->returning; k++) {
+    direct_node_t *statement = n->as.block.statements[k];
+    v = statement->eval(i, statement);
+    gc_hold(i->garbage_collector, v);
+  }
+  // The callee of a tail call sees the bindings of the block
+  if (i->tail_call == VALUE_NIL)
+    env_restore(i->environment, old_size);
+  gc_release(i->garbage_collector, k);
+  return v;
+}
+
+static value_t eval_declaration(interpreter_t *i, direct_node_t *n) {
+  value_t v = n->as.binding.exp->eval(i, n->as.binding.exp);
+  env_bind(i->environment, n->as.binding.symbol, v);
+  return v;
+}
+
+static value_t eval_assignment(interpreter_t *i, direct_node_t *n) {
+  value_t v = n->as.binding.exp->eval(i, n->as.binding.exp);
+  env_set(i->environment, n->as.binding.symbol, v);
+  return v;
+}
+
+static value_t eval_function(interpreter_t *i, direct_node_t *n) {
+  stmt_function_t *function = n->as.function.function;
+  closure_t tmp;
+  tmp.identifier = function->identifier;
+  tmp.formals = function->formals;
+  tmp.symbols = function->symbols;
+  tmp.arity = n->as.function.arity;
+  tmp.body = NULL;
+  tmp.code = 0;
+  tmp.compiled = n->as.function.body;
+  tmp.pure = function->pure;
+  value_t closure = gc_init_closure(i->garbage_collector, tmp);
+  env_bind(i->environment, function->symbol, closure);
+  return closure;
+}
+
+static value_t eval_unimplemented(interpreter_t *i, direct_node_t *n) {
+  interpreter_error(i, "Unimplemented Error\n");
+}
+
+value_t call(interpreter_t *i, direct_node_t *n, value_t *forwarded) {
+  garbage_collector_t *gc = i->garbage_collector;
+  // The actuals are evaluated on top of the held values, from the last one
+  // like the tree walker: they are the frame bound by the callee
+  int count = n->as.call.count;
+  uint32_t frame = gc->temporaries_count;
+  for (int k = 0; k < count; k++) {
+    direct_node_t *actual = n->as.call.actuals[k];
+    gc_hold(gc, actual->eval(i, actual));
+  }
+  if (forwarded)
+    gc_hold(gc, *forwarded);
+  int size = gc->temporaries_count - frame;
+  // Get the closure from the environment
+  value_t v;
+  if (!env_get(i->environment, n->as.call.symbol, &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      n->as.call.identifier);
+  if (value_type(v) != T_CLOSURE)
+    interpreter_error(i, "The identifier '%s' is not a function name\n",
+                      n->as.call.identifier);
+  closure_t *closure = value_as_closure(v);
+  // A pure callee already called with the same actuals is not run again, the
+  // key outlives the frame
+  value_t key[MEMO_MAX_ARITY];
+  direct_node_t *function = closure->compiled;
+  value_t res;
+  int memoized = i->memo && closure->pure && size == (int)closure->arity &&
+                 memo_accepts(gc->temporaries + frame, size);
+  if (memoized) {
+    memcpy(key, gc->temporaries + frame, size * sizeof(value_t));
+    int hit = memo_lookup(i->memo, function, key, size, &res);
+    closure->pure = memo_sample(&closure->lookups, &closure->hits, hit);
+    if (hit) {
+      gc_release(gc, size);
+      return res;
+    }
+  }
+  // Saving the current size of the environment
+  int old_size = i->environment->size;
+  // The formals are stored from the last one, as the values are
+  if (!env_bulk_bind(i->environment, closure->symbols, closure->arity,
+                     gc->temporaries + frame, size))
+    interpreter_error(i,
+                      "actuals number and formals number are not the same");
+  // Popping the frame (now it is reachable from the env)
+  gc_release(gc, size);
+  if (n->as.call.tail) {
+    // The callee replaces the caller, the caller statements unwind keeping
+    // their bindings and the call being replaced runs it
+    i->tail_call = v;
+    i->returning = 1;
+    return VALUE_NIL;
+  }
+  interpreter_enter(i);
+  direct_node_t *body = function;
+  res = body->eval(i, body);
+  // A tail call runs in place of this one
+  while (i->tail_call != VALUE_NIL) {
+    body = interpreter_tail(i, old_size)->compiled;
+    res = body->eval(i, body);
+    gc_release(gc, 1);
+  }
+  // A return unwinds up to here
+  interpreter_leave(i, old_size);
+  if (memoized && !value_is_object(res))
+    memo_store(i->memo, function, key, size, res);
+  return res;
+}
+
+value_t deoptimize(interpreter_t *i, direct_node_t *n, direct_eval_t generic,
+                   operator_t op, value_t left) {
+  n->eval = generic;
+  i->deoptimized++;
+  gc_hold(i->garbage_collector, left);
+  value_t right = n->as.binary.right->eval(i, n->as.binary.right);
+  gc_hold(i->garbage_collector, right);
+  value_t result = interpreter_binary(i, op, left, right);
+  gc_release(i->garbage_collector, 2);
+  return result;
+}
+
+/********************************************************************
+ *                          Translation                             *
+ ********************************************************************/
+
+direct_node_t *compile_exp(arena_t *a, exp_t *e) {
+  direct_node_t *n = arena_alloc(a, sizeof(direct_node_t));
+  switch (e->type) {
+  case EXP_LITERAL:
+    n->eval = eval_constant;
+    n->as.constant = constant(a, exp_unwrap(e));
+    break;
+  case EXP_IDENTIFIER: {
+    exp_identifier_t *identifier = exp_unwrap(e);
+    n->eval = eval_identifier;
+    n->as.identifier.identifier = identifier->identifier;
+    n->as.identifier.symbol = identifier->symbol;
+    break;
+  }
+  case EXP_GROUPING:
+    // The grouping has no behavior of its own, its child takes its place
+    return compile_exp(a, ((exp_grouping_t *)exp_unwrap(e))->exp);
+  case EXP_UNARY: {
+    exp_unary_t *u = exp_unwrap(e);
+    n->eval = u->op == OP_MINUS ? eval_negate : eval_not;
+    n->as.child = compile_exp(a, u->right);
+    break;
+  }
+  case EXP_BINARY:
+    compile_binary(a, n, exp_unwrap(e));
+    break;
+  case EXP_CALL:
+    n->eval = eval_call;
+    compile_call(a, n, exp_unwrap(e));
+    break;
+  default:
+    __builtin_unreachable();
+  }
+  return n;
+}
+
+void compile_binary(arena_t *a, direct_node_t *n, exp_binary_t *b) {
+  if (b->op == OP_FORWARD) {
+    if (b->right->type != EXP_CALL) {
+      n->eval = eval_forward_error;
+      return;
+    }
+    n->eval = eval_forward;
+    n->as.binary.left = compile_exp(a, b->left);
+    n->as.binary.right = arena_alloc(a, sizeof(direct_node_t));
+    n->as.binary.right->eval = eval_call;
+    compile_call(a, n->as.binary.right, exp_unwrap(b->right));
+    return;
+  }
+  static const struct {
+    direct_eval_t any;
+    direct_eval_t constant;
+  } table[] = {
+      [OP_PLUS] = {eval_add, eval_add_constant},
+      [OP_MINUS] = {eval_subtract, eval_subtract_constant},
+      [OP_STAR] = {eval_multiply, eval_multiply_constant},
+      [OP_SLASH] = {eval_divide, eval_divide_constant},
+      [OP_MOD] = {eval_mod, eval_mod_constant},
+      [OP_GREATER] = {eval_greater, eval_greater_constant},
+      [OP_GREATER_EQUAL] = {eval_greater_equal, eval_greater_equal_constant},
+      [OP_LESS] = {eval_less, eval_less_constant},
+      [OP_LESS_EQUAL] = {eval_less_equal, eval_less_equal_constant},
+      [OP_EQUAL] = {eval_equal, eval_equal_constant},
+      [OP_NOT_EQUAL] = {eval_not_equal, eval_not_equal_constant},
+      [OP_AND] = {eval_and, NULL},
+      [OP_OR] = {eval_or, NULL},
+  };
+  n->as.binary.left = compile_exp(a, b->left);
+  if (table[b->op].constant &&
+      number_literal(b->right, &n->as.binary.constant)) {
+    n->eval = table[b->op].constant;
+    n->as.binary.right = NULL;
+  } else {
+    n->eval = table[b->op].any;
+    n->as.binary.right = compile_exp(a, b->right);
+  }
+  return;
+}
+
+void compile_call(arena_t *a, direct_node_t *n, exp_call_t *call) {
+  int count = list_len(call->actuals);
+  n->as.call.identifier = call->identifier;
+  n->as.call.symbol = call->symbol;
+  n->as.call.count = count;
+  n->as.call.tail = call->tail;
+  n->as.call.actuals = arena_alloc(a, count * sizeof(direct_node_t *));
+  int k = 0;
+  for (l_list_t current = call->actuals; current; current = current->next)
+    n->as.call.actuals[k++] = compile_exp(a, current->data);
+  return;
+}
+
+direct_node_t *compile_stmt(arena_t *a, stmt_t *s) {
+  direct_node_t *n;
+  switch (s->type) {
+  case STMT_EXPR:
+    // An expression statement evaluates to its expression
+    return compile_exp(a, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+  case STMT_RETURN:
+  case STMT_PRINT:
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval = s->type == STMT_RETURN ? eval_return : eval_print;
+    // stmt_expr_t and stmt_print_t share the same layout
+    n->as.child = compile_exp(a, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    return n;
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval = eval_if;
+    n->as.conditional.condition = compile_exp(a, c->condition);
+    n->as.conditional.then_branch = compile_stmt(a, c->then_branch);
+    n->as.conditional.else_branch =
+        c->else_branch ? compile_stmt(a, c->else_branch) : NULL;
+    return n;
+  }
+  case STMT_BLOCK: {
+    stmt_block_t *b = stmt_unwrap(s);
+    int count = list_len(b->statements);
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval = eval_block;
+    n->as.block.count = count;
+    n->as.block.statements =
+        arena_alloc(a, count * sizeof(direct_node_t *));
+    int k = 0;
+    for (l_list_t current = b->statements; current; current = current->next)
+      n->as.block.statements[k++] = compile_stmt(a, current->data);
+    return n;
+  }
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval =
+        s->type == STMT_DECLARATION ? eval_declaration : eval_assignment;
+    n->as.binding.symbol = d->symbol;
+    n->as.binding.exp = compile_exp(a, d->exp);
+    return n;
+  }
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval = eval_function;
+    n->as.function.function = fun;
+    n->as.function.arity = list_len(fun->formals);
+    n->as.function.body = compile_stmt(a, fun->body);
+    return n;
+  }
+  default:
+    n = arena_alloc(a, sizeof(direct_node_t));
+    n->eval = eval_unimplemented;
+    return n;
+  }
+}
+
+value_t constant(arena_t *a, exp_literal_t *l) {
+  switch (l->type) {
+  case T_NUMBER:
+    return value_number(l->value.number);
+  case T_BOOLEAN:
+    return value_boolean(l->value.boolean);
+  case T_STRING: {
+    // Not tracked by the GC, the string lives as long as the arena
+    size_t length = strlen(l->value.string);
+    string_t *s = arena_alloc(a, sizeof(string_t) + length + 1);
+    s->object.type = T_STRING;
+    s->object.status = 0;
+    s->object.next = NULL;
+    memcpy(s->chars, l->value.string, length + 1);
+    return value_object(&s->object);
+  }
+  default:
+    return VALUE_NIL;
+  }
+}
+
+int number_literal(exp_t *e, double *n) {
+  while (e->type == EXP_GROUPING)
+    e = ((exp_grouping_t *)exp_unwrap(e))->exp;
+  if (e->type != EXP_LITERAL)
+    return 0;
+  exp_literal_t *l = exp_unwrap(e);
+  if (l->type != T_NUMBER)
+    return 0;
+  *n = l->value.number;
+  return 1;
+}
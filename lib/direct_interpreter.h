@@ -0,0 +1,27 @@
+#ifndef DIRECT_INTERPRETER_H
+#define DIRECT_INTERPRETER_H
+#include "arena.h"
+#include "interpreter.h"
+#include "list.h"
+#include "syntax.h"
+
+/**
+ * Run a list of top level statements, each one is first translated into a
+ * tree of nodes holding the C function that evaluates them
+ * @param interpreter a pointer to the interpreter to use
+ * @param arena a pointer to the arena holding the nodes
+ * @param statements the statements to run
+ */
+void direct_interpreter_eval(interpreter_t *, arena_t *, l_list_t);
+
+/**
+ * Translate and run a single top level statement
+ * @param interpreter a pointer to the interpreter to use
+ * @param arena a pointer to the arena holding the nodes
+ * @param statement a pointer to the statement to run
+ * @note The arena must outlive the interpreter, the closures keep pointers to
+ * the nodes of their bodies
+ */
+void direct_interpreter_eval_statement(interpreter_t *, arena_t *, stmt_t *);
+
+#endif // !DIRECT_INTERPRETER_H
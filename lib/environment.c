@@ -1,118 +1,132 @@
 #include "environment.h"
-#include "errors.h"
-#include "list.h"
 #include "memory.h"
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * Initialize a Ide x Val pair
- * @param ide the identifier
- * @param value a value pointer
- * @return a pointer to the Ide x Val pair
- */
-static env_item_t *env_item_init(char *, void *);
+#define ENV_INITIAL_CAPACITY 64
 
 /**
- * Destroy the given Ide x Val pair
- * @param item a pointer to the Ide x Val pair
+ * Grow the trail of the given environment
+ * @param e a pointer to the Env
  */
-static void env_item_destroy(env_item_t *);
-
+static void reserve(env_t *);
 /**
- * A wrapper for the env_item_destroy
+ * Grow the values of the given environment so that a symbol has a slot
+ * @param e a pointer to the Env
+ * @param symbol the symbol
  */
-static void env_item_free(void *);
+static void reserve_symbol(env_t *, uint32_t);
 
 void env_init(env_t *e) {
   memset(e, 0, sizeof(*e));
-  e->env = NULL;
+  e->values = NULL;
+  e->symbols = 0;
+  e->trail = NULL;
   e->size = 0;
+  e->capacity = 0;
+  e->marks = NULL;
+  e->epoch = 0;
   return;
 }
 
-void env_bind(env_t *e, char *identifier, void *value) {
-  list_add(&e->env, env_item_init(identifier, value));
+void env_bind(env_t *e, uint32_t symbol, value_t value) {
+  if (symbol >= e->symbols)
+    reserve_symbol(e, symbol);
+  if (e->size == e->capacity)
+    reserve(e);
+  e->trail[e->size].symbol = symbol;
+  e->trail[e->size].old = e->values[symbol];
+  e->values[symbol] = value;
   e->size++;
   return;
 }
 
-void *env_get(env_t *e, char *key) {
-  l_list_t current = e->env;
-  while (current != NULL) {
-    env_item_t *tmp = (env_item_t *)current->data;
-    if (strcmp(tmp->identifier, key) == 0)
-      return tmp->value;
-    current = current->next;
-  }
-  return NULL;
+int env_get(env_t *e, uint32_t symbol, value_t *value) {
+  if (symbol >= e->symbols || e->values[symbol] == VALUE_UNBOUND)
+    return 0;
+  *value = e->values[symbol];
+  return 1;
 }
 
-void *env_set(env_t *e, char *key, void *new_val) {
-  l_list_t current = e->env;
-  while (current != NULL) {
-    if (strcmp(((env_item_t *)current->data)->identifier, key) == 0) {
-      void *old_v = ((env_item_t *)current->data)->value = new_val;
-      return old_v;
-    }
-    current = current->next;
-  }
-  return NULL;
+int env_set(env_t *e, uint32_t symbol, value_t new_val) {
+  if (symbol >= e->symbols || e->values[symbol] == VALUE_UNBOUND)
+    return 0;
+  e->values[symbol] = new_val;
+  return 1;
 }
 
 void env_unbind(env_t *e) {
-  if (e->env->data == NULL)
+  if (e->size == 0)
     return;
-  l_list_t new_head = e->env->next;
-  l_list_t tmp = e->env;
-  env_item_free(tmp->data);
-  e->env = new_head;
-  mem_free(tmp);
   e->size--;
+  e->values[e->trail[e->size].symbol] = e->trail[e->size].old;
   return;
 }
 
 void env_destroy(env_t *e) {
-  list_free(e->env, env_item_free);
+  mem_free(e->values);
+  mem_free(e->trail);
+  mem_free(e->marks);
+  e->values = NULL;
+  e->trail = NULL;
+  e->marks = NULL;
+  e->symbols = 0;
+  e->size = e->capacity = 0;
   return;
 }
 
 void env_restore(env_t *current, int old_size) {
-  int n = current->size - old_size;
-  for (int i = 0; i < n; i++)
-    env_unbind(current);
+  while (current->size > old_size) {
+    env_binding_t *b = &current->trail[--current->size];
+    current->values[b->symbol] = b->old;
+  }
   return;
 }
 
-int env_bulk_bind(env_t *env, l_list_t identifiers, l_list_t values) {
-  l_list_t current_ide = identifiers;
-  l_list_t current_val = values;
-  while (current_ide != NULL && current_val != NULL) {
-    env_bind(env, current_ide->data, current_val->data);
-    current_val = current_val->next;
-    current_ide = current_ide->next;
+void env_squash(env_t *e, int old_size) {
+  // A new epoch makes the marks of the previous squashes stale
+  if (++e->epoch == 0) {
+    memset(e->marks, 0, e->symbols * sizeof(uint32_t));
+    e->epoch = 1;
   }
+  int size = old_size;
+  for (int k = old_size; k < e->size; k++) {
+    env_binding_t b = e->trail[k];
+    if (e->marks[b.symbol] == e->epoch)
+      continue;
+    e->marks[b.symbol] = e->epoch;
+    e->trail[size++] = b;
+  }
+  e->size = size;
+  return;
+}
 
-  if (current_ide != NULL || current_val != NULL)
+int env_bulk_bind(env_t *env, uint32_t *symbols, uint32_t arity,
+                  value_t *values, uint32_t count) {
+  if (arity != count)
     return 0;
+  for (uint32_t k = 0; k < count; k++)
+    env_bind(env, symbols[k], values[k]);
   return 1;
 }
 
-env_item_t *env_item_init(char *ide, void *value) {
-  env_item_t *new = mem_calloc(0, sizeof(env_item_t));
-  new->value = value;
-  new->identifier = strdup(ide);
-  return new;
-}
-
-void env_item_destroy(env_item_t *item) {
-  mem_free(item->identifier);
-  mem_free(item);
+void reserve(env_t *e) {
+  e->capacity = e->capacity ? e->capacity * 2 : ENV_INITIAL_CAPACITY;
+  e->trail = mem_realloc(e->trail, e->capacity * sizeof(env_binding_t));
   return;
 }
 
-void env_item_free(void *item) {
-  env_item_destroy(item);
+void reserve_symbol(env_t *e, uint32_t symbol) {
+  // The symbols of a lazily parsed body are assigned while running
+  uint32_t symbols = e->symbols ? e->symbols : ENV_INITIAL_CAPACITY;
+  while (symbols <= symbol)
+    symbols *= 2;
+  e->values = mem_realloc(e->values, symbols * sizeof(value_t));
+  e->marks = mem_realloc(e->marks, symbols * sizeof(uint32_t));
+  for (uint32_t k = e->symbols; k < symbols; k++) {
+    e->values[k] = VALUE_UNBOUND;
+    e->marks[k] = 0;
+  }
+  e->symbols = symbols;
   return;
 }
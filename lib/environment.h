@@ -1,14 +1,38 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
-#include "list.h"
+#include "value.h"
+#include <stdint.h>
+
+/**
+ * A binding shadowed by a newer one
+ * @param symbol the symbol bound
+ * @param old the value bound before, VALUE_UNBOUND if none
+ */
 typedef struct {
-  char *identifier;
-  void *value;
-} env_item_t;
+  uint32_t symbol;
+  value_t old;
+} env_binding_t;
 
+/**
+ * The bindings of the identifiers, resolved by shallow binding: every symbol
+ * assigned by the resolver has a slot holding its current value, the values
+ * it shadows are kept in a trail, the most recent binding on the top
+ * @param values the current value of every symbol, VALUE_UNBOUND if none
+ * @param symbols the number of slots of the values
+ * @param trail the shadowed bindings, from the oldest one
+ * @param size the number of bindings
+ * @param capacity the number of bindings the trail can hold
+ * @param marks the last squash that met every symbol, by symbol
+ * @param epoch the number of squashes
+ */
 typedef struct {
-  l_list_t env;
+  value_t *values;
+  uint32_t symbols;
+  env_binding_t *trail;
   int size;
+  int capacity;
+  uint32_t *marks;
+  uint32_t epoch;
 } env_t;
 
 /**
@@ -18,33 +42,34 @@ typedef struct {
 void env_init(env_t *);
 
 /**
- * Bind the Ide x Val pair to the given environment
+ * Bind a value to the given symbol in the given environment
  * @param e a pointer to the Env
- * @param identifier the identifier associated to the value
- * @param value a pointer to the value to bind
+ * @param symbol the symbol associated to the value
+ * @param value the value to bind
  */
-void env_bind(env_t *, char *, void *);
+void env_bind(env_t *, uint32_t, value_t);
 
 /**
- * Get the value associated to the given Ide in the given Env
+ * Get the value associated to the given symbol in the given Env
  * @param e a pointer to the Env
- * @param key the identifier to search
- * @return a void ptr to the value if found NULL otherwise
+ * @param symbol the symbol to search
+ * @param value a pointer where the value found is stored
+ * @return 1 if the symbol is bound, 0 otherwise
  */
-void *env_get(env_t *, char *);
+int env_get(env_t *, uint32_t, value_t *);
 
 /**
- * Change the value associated to the given Ide with the given Val in the given
- * Env
+ * Change the value associated to the given symbol with the given Val in the
+ * given Env
  * @param e a pointer to the Env
- * @param key the identifier for the value to be changed
- * @param new_val a pointer to the new value
- * @return the old value on a successful call, NULL otherwise
+ * @param symbol the symbol for the value to be changed
+ * @param new_val the new value
+ * @return 1 on a successful call, 0 if the symbol is not bound
  */
-void *env_set(env_t *, char *, void *);
+int env_set(env_t *, uint32_t, value_t);
 
 /**
- * Unbind the last Ide x Val pair from the given environment
+ * Unbind the last binding from the given environment
  * @param e a pointer to the Env
  */
 void env_unbind(env_t *);
@@ -56,19 +81,32 @@ void env_unbind(env_t *);
 void env_destroy(env_t *);
 
 /**
- * Unbind the last n Ide x Val pairs in the given environment
+ * Unbind the last n bindings in the given environment
  * @param current a pointer to the Env
  * @param old_size the size of the Env to restore
  */
 void env_restore(env_t *, int);
 
 /**
- * Bind multiple Ide x Val pairs to the given environment
+ * Drop the bindings made since the given size that shadow a binding made
+ * since then too, keeping the oldest binding of every symbol: the current
+ * values are left untouched and restoring the size gives the same result
+ * @param e a pointer to the Env
+ * @param old_size the size of the Env when the bindings began
+ * @note A tail call squashes the frame it replaces, the environment then
+ * stays the same size however many tail calls follow each other
+ */
+void env_squash(env_t *, int);
+
+/**
+ * Bind multiple values to the given environment
  * @param env a pointer to the Env
- * @param identifiers a list of identifiers
- * @param values a list of value pointers
+ * @param symbols the symbols, in the order of the formals list
+ * @param arity the number of symbols
+ * @param values the values, in the order of the symbols
+ * @param count the number of values
+ * @return 1 on success, 0 if the number of symbols and values differ
  */
-int env_bulk_bind(env_t *, l_list_t, l_list_t);
+int env_bulk_bind(env_t *, uint32_t *, uint32_t, value_t *, uint32_t);
 
 #endif // !ENVIRONMENT_H
-#define ENVIRONMENT_H
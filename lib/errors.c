@@ -37,6 +37,24 @@ void err_log_v(enum log_level_t level, const char *restrict fmt, va_list args) {
   }
 }
 
+void err_log_file(FILE *out, enum log_level_t level, const char *restrict fmt,
+                  ...) {
+  if (level > LOG_LEVELS || level < internal_log_level)
+    return;
+  va_list args;
+  va_start(args, fmt);
+  if (level == INFO) {
+    fprintf(out, "%s[%s] " ANSI_COLOR_RESET, get_ansi_color(level),
+            pretty_log_level(level));
+    vfprintf(out, fmt, args);
+  } else {
+    fprintf(out, "%s[%s] ", get_ansi_color(level), pretty_log_level(level));
+    vfprintf(out, fmt, args);
+    fprintf(out, ANSI_COLOR_RESET);
+  }
+  va_end(args);
+}
+
 void err_log_set_level(enum log_level_t level) {
   if (level > LOG_LEVELS)
     return;
@@ -1,6 +1,7 @@
 #ifndef ERRORS_H
 #define ERRORS_H
 #include <stdarg.h>
+#include <stdio.h>
 
 #define ANSI_COLOR_RED "\x1b[31m"
 #define ANSI_COLOR_GREEN "\x1b[32m"
@@ -21,6 +22,8 @@ enum log_level_t {
 __attribute__((format(printf, 2, 3))) void err_log(enum log_level_t,
                                                    const char *restrict, ...);
 void err_log_v(enum log_level_t, const char *restrict, va_list);
+__attribute__((format(printf, 3, 4))) void
+err_log_file(FILE *, enum log_level_t, const char *restrict, ...);
 
 void err_log_set_level(enum log_level_t);
 
@@ -0,0 +1,245 @@
+#include "flat.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <string.h>
+#include <sys/mman.h>
+
+_Static_assert(sizeof(flat_node_t) == 16, "flat nodes must stay 16 bytes");
+
+/**
+ * Append an empty node
+ * @param f a pointer to the flat AST
+ * @return the index of the new node
+ */
+static flat_index_t node_push(flat_ast_t *);
+/**
+ * Append an empty list
+ * @param f a pointer to the flat AST
+ * @param length the number of elements of the list
+ * @return the index of the new list
+ */
+static flat_index_t list_push(flat_ast_t *, uint32_t);
+/**
+ * Append a string to the characters of the flat AST
+ * @param f a pointer to the flat AST
+ * @param s the string to append
+ * @return the offset of the copy
+ */
+static uint32_t chars_push(flat_ast_t *, const char *);
+/**
+ * Append a number constant
+ * @param f a pointer to the flat AST
+ * @param n the number
+ * @return the index of the constant
+ */
+static uint32_t number_push(flat_ast_t *, double);
+/**
+ * Append an expression (and all its children)
+ * @param f a pointer to the flat AST
+ * @param e a pointer to the expression to lower
+ * @return the index of the expression node
+ */
+static flat_index_t lower_exp(flat_ast_t *, exp_t *);
+
+void flat_init(flat_ast_t *f) {
+  memset(f, 0, sizeof(*f));
+  f->nodes = NULL;
+  f->lists = NULL;
+  f->numbers = NULL;
+  f->chars = NULL;
+  f->mapping = NULL;
+  return;
+}
+
+flat_index_t flat_lower(flat_ast_t *f, stmt_t *s) {
+  flat_index_t index = node_push(f);
+  flat_node_t n;
+  memset(&n, 0, sizeof(n));
+  switch (s->type) {
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    n.kind = FLAT_IF;
+    n.as.conditional.condition = lower_exp(f, c->condition);
+    n.as.conditional.then_branch = flat_lower(f, c->then_branch);
+    n.as.conditional.else_branch =
+        c->else_branch ? flat_lower(f, c->else_branch) : FLAT_NONE;
+    break;
+  }
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    n.kind = FLAT_FUN;
+    n.as.function.name = chars_push(f, fun->identifier);
+    uint32_t count = list_len(fun->formals);
+    n.as.function.formals = list_push(f, count);
+    // The parser collects formals in reverse order
+    uint32_t k = n.as.function.formals + count;
+    for (l_list_t current = fun->formals; current; current = current->next)
+      f->lists[k--] = chars_push(f, current->data);
+    n.as.function.body = flat_lower(f, fun->body);
+    break;
+  }
+  case STMT_PRINT:
+    n.kind = FLAT_PRINT;
+    n.as.child = lower_exp(f, ((stmt_print_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_EXPR:
+  case STMT_RETURN:
+    n.kind = s->type == STMT_EXPR ? FLAT_EXPR : FLAT_RETURN;
+    n.as.child = lower_exp(f, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_BLOCK: {
+    stmt_block_t *b = stmt_unwrap(s);
+    n.kind = FLAT_BLOCK;
+    n.as.statements = flat_lower_program(f, b->statements);
+    break;
+  }
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    n.kind =
+        s->type == STMT_DECLARATION ? FLAT_DECLARATION : FLAT_ASSIGNMENT;
+    n.as.binding.name = chars_push(f, d->identifier);
+    n.as.binding.exp = lower_exp(f, d->exp);
+    break;
+  }
+  default:
+    __builtin_unreachable();
+  }
+  f->nodes[index] = n;
+  return index;
+}
+
+flat_index_t flat_lower_program(flat_ast_t *f, l_list_t statements) {
+  flat_index_t list = list_push(f, list_len(statements));
+  uint32_t k = list + 1;
+  // The lists array may move while lowering, hence the index
+  for (l_list_t current = statements; current; current = current->next) {
+    flat_index_t statement = flat_lower(f, current->data);
+    f->lists[k++] = statement;
+  }
+  return list;
+}
+
+size_t flat_size(flat_ast_t *f) {
+  return f->nodes_count * sizeof(flat_node_t) +
+         f->lists_count * sizeof(flat_index_t) +
+         f->numbers_count * sizeof(double) + f->chars_count;
+}
+
+void flat_destroy(flat_ast_t *f) {
+  if (f->mapping) {
+    munmap(f->mapping, f->mapping_size);
+  } else {
+    mem_free(f->nodes);
+    mem_free(f->lists);
+    mem_free(f->numbers);
+    mem_free(f->chars);
+  }
+  flat_init(f);
+  return;
+}
+
+flat_index_t lower_exp(flat_ast_t *f, exp_t *e) {
+  flat_index_t index = node_push(f);
+  flat_node_t n;
+  memset(&n, 0, sizeof(n));
+  switch (e->type) {
+  case EXP_UNARY: {
+    exp_unary_t *u = exp_unwrap(e);
+    n.kind = FLAT_UNARY;
+    n.op = u->op;
+    n.as.child = lower_exp(f, u->right);
+    break;
+  }
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    n.kind = FLAT_BINARY;
+    n.op = b->op;
+    n.as.binary.left = lower_exp(f, b->left);
+    n.as.binary.right = lower_exp(f, b->right);
+    break;
+  }
+  case EXP_GROUPING:
+    n.kind = FLAT_GROUPING;
+    n.as.child = lower_exp(f, ((exp_grouping_t *)exp_unwrap(e))->exp);
+    break;
+  case EXP_LITERAL: {
+    exp_literal_t *l = exp_unwrap(e);
+    switch (l->type) {
+    case T_NUMBER:
+      n.kind = FLAT_NUMBER;
+      n.as.literal = number_push(f, l->value.number);
+      break;
+    case T_STRING:
+      n.kind = FLAT_STRING;
+      n.as.literal = chars_push(f, l->value.string);
+      break;
+    case T_BOOLEAN:
+      n.kind = FLAT_BOOLEAN;
+      n.as.literal = l->value.boolean;
+      break;
+    default:
+      n.kind = FLAT_NIL;
+      break;
+    }
+    break;
+  }
+  case EXP_IDENTIFIER:
+    n.kind = FLAT_IDENTIFIER;
+    n.as.name =
+        chars_push(f, ((exp_identifier_t *)exp_unwrap(e))->identifier);
+    break;
+  case EXP_CALL: {
+    exp_call_t *c = exp_unwrap(e);
+    n.kind = FLAT_CALL;
+    n.tail = c->tail;
+    n.as.call.name = chars_push(f, c->identifier);
+    uint32_t count = list_len(c->actuals);
+    n.as.call.actuals = list_push(f, count);
+    // The parser collects actuals in reverse order
+    uint32_t k = n.as.call.actuals + count;
+    for (l_list_t current = c->actuals; current; current = current->next) {
+      flat_index_t actual = lower_exp(f, current->data);
+      f->lists[k--] = actual;
+    }
+    break;
+  }
+  default:
+    __builtin_unreachable();
+  }
+  f->nodes[index] = n;
+  return index;
+}
+
+flat_index_t node_push(flat_ast_t *f) {
+  f->nodes = mem_reserve(f->nodes, &f->nodes_capacity, f->nodes_count + 1,
+                         sizeof(flat_node_t));
+  return f->nodes_count++;
+}
+
+flat_index_t list_push(flat_ast_t *f, uint32_t length) {
+  f->lists = mem_reserve(f->lists, &f->lists_capacity,
+                         f->lists_count + length + 1, sizeof(flat_index_t));
+  flat_index_t list = f->lists_count;
+  f->lists[list] = length;
+  f->lists_count += length + 1;
+  return list;
+}
+
+uint32_t chars_push(flat_ast_t *f, const char *s) {
+  uint32_t length = strlen(s) + 1;
+  f->chars = mem_reserve(f->chars, &f->chars_capacity, f->chars_count + length,
+                         sizeof(char));
+  uint32_t offset = f->chars_count;
+  memcpy(f->chars + offset, s, length);
+  f->chars_count += length;
+  return offset;
+}
+
+uint32_t number_push(flat_ast_t *f, double n) {
+  f->numbers = mem_reserve(f->numbers, &f->numbers_capacity,
+                           f->numbers_count + 1, sizeof(double));
+  f->numbers[f->numbers_count] = n;
+  return f->numbers_count++;
+}
@@ -0,0 +1,147 @@
+#ifndef FLAT_H
+#define FLAT_H
+#include "list.h"
+#include "syntax.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The position of a node (or of a list) inside a flat AST
+ */
+typedef uint32_t flat_index_t;
+
+#define FLAT_NONE UINT32_MAX
+
+typedef enum {
+  FLAT_UNARY,
+  FLAT_BINARY,
+  FLAT_GROUPING,
+  FLAT_NUMBER,
+  FLAT_STRING,
+  FLAT_BOOLEAN,
+  FLAT_NIL,
+  FLAT_IDENTIFIER,
+  FLAT_CALL,
+  FLAT_IF,
+  FLAT_FUN,
+  FLAT_PRINT,
+  FLAT_EXPR,
+  FLAT_BLOCK,
+  FLAT_DECLARATION,
+  FLAT_ASSIGNMENT,
+  FLAT_RETURN,
+} flat_kind_t;
+
+/**
+ * A single expression or statement, children are referenced by index
+ * @param kind a flat_kind_t
+ * @param op the operator_t of unary and binary expressions
+ * @param tail 1 for a call in tail position
+ * @param as the payload, names are offsets inside the flat AST characters,
+ * lists are indexes inside the flat AST lists
+ * @note Nodes are stored in pre-order, so the children of a node usually
+ * follow it in memory
+ */
+typedef struct {
+  uint8_t kind;
+  uint8_t op;
+  uint8_t tail;
+  union {
+    // UNARY, GROUPING, PRINT, EXPR, RETURN
+    flat_index_t child;
+    struct {
+      flat_index_t left;
+      flat_index_t right;
+    } binary;
+    // NUMBER (index of the constant), STRING (name), BOOLEAN (value)
+    uint32_t literal;
+    // IDENTIFIER
+    uint32_t name;
+    struct {
+      uint32_t name;
+      flat_index_t actuals;
+    } call;
+    struct {
+      flat_index_t condition;
+      flat_index_t then_branch;
+      flat_index_t else_branch;
+    } conditional;
+    // BLOCK
+    flat_index_t statements;
+    // DECLARATION, ASSIGNMENT
+    struct {
+      uint32_t name;
+      flat_index_t exp;
+    } binding;
+    struct {
+      uint32_t name;
+      flat_index_t formals;
+      flat_index_t body;
+    } function;
+  } as;
+} flat_node_t;
+
+/**
+ * An AST stored in a few contiguous arrays
+ * @param nodes all the nodes
+ * @param lists the lists, each one is stored as its length followed by its
+ * elements
+ * @param numbers the number constants
+ * @param chars the NULL terminated identifiers and strings
+ * @param mapping the file mapping holding the arrays, NULL if they are
+ * allocated on the heap (a mapped flat AST is read-only)
+ */
+typedef struct {
+  flat_node_t *nodes;
+  uint32_t nodes_count;
+  uint32_t nodes_capacity;
+  flat_index_t *lists;
+  uint32_t lists_count;
+  uint32_t lists_capacity;
+  double *numbers;
+  uint32_t numbers_count;
+  uint32_t numbers_capacity;
+  char *chars;
+  uint32_t chars_count;
+  uint32_t chars_capacity;
+  void *mapping;
+  size_t mapping_size;
+} flat_ast_t;
+
+/**
+ * Initialize the given flat AST
+ * @param f a pointer to the flat AST to initialize
+ */
+void flat_init(flat_ast_t *);
+
+/**
+ * Append a statement (and all its children) to the given flat AST
+ * @param f a pointer to the flat AST
+ * @param s a pointer to the statement to lower
+ * @return the index of the statement node
+ * @note The statement is only read, it can be destroyed afterwards
+ */
+flat_index_t flat_lower(flat_ast_t *, stmt_t *);
+
+/**
+ * Append a list of statements to the given flat AST
+ * @param f a pointer to the flat AST
+ * @param statements a list of statements to lower
+ * @return the index of the list of lowered statements
+ */
+flat_index_t flat_lower_program(flat_ast_t *, l_list_t);
+
+/**
+ * The memory used by the given flat AST
+ * @param f a pointer to the flat AST
+ * @return the number of bytes in use
+ */
+size_t flat_size(flat_ast_t *);
+
+/**
+ * Destroy the given flat AST
+ * @param f a pointer to the flat AST to destroy
+ */
+void flat_destroy(flat_ast_t *);
+
+#endif // !FLAT_H
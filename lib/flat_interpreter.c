@@ -0,0 +1,301 @@
+#include "flat_interpreter.h"
+#include "environment.h"
+#include "flat.h"
+#include "garbage.h"
+#include "interpreter.h"
+#include <stdint.h>
+
+/**
+ * Evaluate the given expression
+ * @param i a pointer to the interpreter
+ * @param index the index of the expression to evaluate
+ * @return the value obtained
+ */
+static value_t eval(interpreter_t *, flat_index_t);
+/**
+ * Evaluate the given binary expression
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the expression node
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval function
+ */
+static value_t eval_binary(interpreter_t *, flat_node_t *);
+/**
+ * Evaluate the given call expression
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the expression node
+ * @param forwarded a pointer to a forwarded value to be used as a first
+ * argument
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval function
+ */
+static value_t eval_call(interpreter_t *, flat_node_t *, value_t *);
+/**
+ * Evaluate the given statement
+ * @param i a pointer to the interpreter
+ * @param index the index of the statement to evaluate
+ * @return the value obtained
+ */
+static value_t eval_stmt(interpreter_t *, flat_index_t);
+/**
+ * Evaluate the given statement block
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the statement node
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval_stmt function
+ */
+static value_t eval_stmt_block(interpreter_t *, flat_node_t *);
+/**
+ * Evaluate the given statement conditional
+ * @param i a pointer to the interpreter
+ * @param n a pointer to the statement node
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval_stmt function
+ */
+static value_t eval_stmt_conditional(interpreter_t *, flat_node_t *);
+/**
+ * Evaluate the given statement function declaration
+ * @param i a pointer to the interpreter
+ * @param index the index of the statement node
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval_stmt function
+ */
+static value_t eval_stmt_function(interpreter_t *, flat_index_t);
+/**
+ * Get a name stored in the flat AST
+ * @param i a pointer to the interpreter
+ * @param offset the offset of the name
+ * @return a pointer to the NULL terminated name
+ */
+static char *name(interpreter_t *, uint32_t);
+/**
+ * Get the symbol of a name stored in the flat AST
+ * @param i a pointer to the interpreter
+ * @param offset the offset of the name
+ * @return the symbol assigned by the resolver
+ */
+static uint32_t symbol(interpreter_t *, uint32_t);
+
+void flat_interpreter_eval(interpreter_t *interpreter, flat_ast_t *f,
+                           flat_index_t program) {
+  interpreter->flat = f;
+  uint32_t count = f->lists[program];
+  for (uint32_t k = 1; k <= count; k++)
+    eval_stmt(interpreter, f->lists[program + k]);
+  return;
+}
+
+void flat_interpreter_eval_statement(interpreter_t *interpreter,
+                                     flat_ast_t *f, flat_index_t statement) {
+  interpreter->flat = f;
+  eval_stmt(interpreter, statement);
+  return;
+}
+
+value_t eval(interpreter_t *i, flat_index_t index) {
+  flat_node_t *n = &i->flat->nodes[index];
+  switch (n->kind) {
+  case FLAT_UNARY:
+    return interpreter_unary(i, n->op, eval(i, n->as.child));
+  case FLAT_BINARY:
+    return eval_binary(i, n);
+  case FLAT_GROUPING:
+    return eval(i, n->as.child);
+  case FLAT_NUMBER:
+    return value_number(i->flat->numbers[n->as.literal]);
+  case FLAT_STRING:
+    return gc_init_string(i->garbage_collector, name(i, n->as.literal));
+  case FLAT_BOOLEAN:
+    return value_boolean(n->as.literal);
+  case FLAT_NIL:
+    return VALUE_NIL;
+  case FLAT_IDENTIFIER: {
+    value_t v;
+    if (!env_get(i->environment, symbol(i, n->as.name), &v))
+      interpreter_error(i, "The identifier '%s' was not declared\n",
+                        name(i, n->as.name));
+    return v;
+  }
+  case FLAT_CALL:
+    return eval_call(i, n, NULL);
+  default:
+    interpreter_error(i, "Unknown expression\n");
+  }
+}
+
+value_t eval_binary(interpreter_t *i, flat_node_t *n) {
+  garbage_collector_t *gc = i->garbage_collector;
+  if (n->op == OP_FORWARD) {
+    flat_node_t *right = &i->flat->nodes[n->as.binary.right];
+    if (right->kind != FLAT_CALL)
+      interpreter_error(i, "Expected a function call after |>\n");
+    value_t left = eval(i, n->as.binary.left);
+    gc_hold(gc, left);
+    value_t res = eval_call(i, right, &left);
+    gc_release(gc, 1);
+    return res;
+  }
+  value_t left = eval(i, n->as.binary.left);
+  gc_hold(gc, left);
+  int logic = n->op == OP_AND || n->op == OP_OR;
+  if (logic && !value_is_boolean(left))
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+  // Short circuit: false && ... or true || ...
+  if (logic && value_as_boolean(left) == (n->op == OP_OR)) {
+    value_t result = interpreter_binary(i, n->op, left, VALUE_NIL);
+    gc_release(gc, 1);
+    return result;
+  }
+  value_t right = eval(i, n->as.binary.right);
+  if (logic && !value_is_boolean(right))
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+  gc_hold(gc, right);
+  value_t result = interpreter_binary(i, n->op, left, right);
+  gc_release(gc, 2);
+  return result;
+}
+
+value_t eval_call(interpreter_t *i, flat_node_t *n, value_t *forwarded) {
+  flat_ast_t *f = i->flat;
+  garbage_collector_t *gc = i->garbage_collector;
+  // The actuals are evaluated on top of the held values, right to left like
+  // the tree walking interpreter does: they are the frame bound by the callee
+  flat_index_t *actuals = &f->lists[n->as.call.actuals];
+  uint32_t count = actuals[0];
+  uint32_t frame = gc->temporaries_count;
+  for (uint32_t k = count; k >= 1; k--)
+    gc_hold(gc, eval(i, actuals[k]));
+  if (forwarded)
+    gc_hold(gc, *forwarded);
+  uint32_t size = gc->temporaries_count - frame;
+  // Get the closure from the environment
+  value_t v;
+  if (!env_get(i->environment, symbol(i, n->as.call.name), &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      name(i, n->as.call.name));
+  if (value_type(v) != T_CLOSURE)
+    interpreter_error(i, "The identifier '%s' is not a function name\n",
+                      name(i, n->as.call.name));
+  flat_node_t *function = &f->nodes[value_as_closure(v)->code];
+  flat_index_t *formals = &f->lists[function->as.function.formals];
+  // Saving the current size of the environment
+  int old_size = i->environment->size;
+  if (formals[0] != size)
+    interpreter_error(i,
+                      "actuals number and formals number are not the same");
+  // The first formal gets the value pushed last
+  value_t *values = gc->temporaries + frame;
+  for (uint32_t k = 0; k < size; k++)
+    env_bind(i->environment, symbol(i, formals[k + 1]),
+             values[size - 1 - k]);
+  // Popping the frame (now it is reachable from the env)
+  gc_release(gc, size);
+  if (n->tail) {
+    // The callee replaces the caller, the caller statements unwind keeping
+    // their bindings and the call being replaced runs it
+    i->tail_call = v;
+    i->returning = 1;
+    return VALUE_NIL;
+  }
+  interpreter_enter(i);
+  value_t res = eval_stmt(i, function->as.function.body);
+  // A tail call runs in place of this one
+  while (i->tail_call != VALUE_NIL) {
+    function = &f->nodes[interpreter_tail(i, old_size)->code];
+    res = eval_stmt(i, function->as.function.body);
+    gc_release(gc, 1);
+  }
+  // A return unwinds up to here
+  interpreter_leave(i, old_size);
+  return res;
+}
+
+value_t eval_stmt(interpreter_t *i, flat_index_t index) {
+  flat_node_t *n = &i->flat->nodes[index];
+  switch (n->kind) {
+  case FLAT_RETURN: {
+    if (i->depth == 0)
+      interpreter_error(i, "return can used only inside a function\n");
+    value_t v = eval(i, n->as.child);
+    // The enclosing statements stop and pass the value up to the call
+    i->returning = 1;
+    return v;
+  }
+  case FLAT_EXPR:
+    return eval(i, n->as.child);
+  case FLAT_PRINT:
+    interpreter_print(eval(i, n->as.child));
+    return VALUE_NIL;
+  case FLAT_IF:
+    return eval_stmt_conditional(i, n);
+  case FLAT_BLOCK:
+    return eval_stmt_block(i, n);
+  case FLAT_DECLARATION: {
+    value_t v = eval(i, n->as.binding.exp);
+    env_bind(i->environment, symbol(i, n->as.binding.name), v);
+    return v;
+  }
+  case FLAT_ASSIGNMENT: {
+    value_t v = eval(i, n->as.binding.exp);
+    env_set(i->environment, symbol(i, n->as.binding.name), v);
+    return v;
+  }
+  case FLAT_FUN:
+    return eval_stmt_function(i, index);
+  default:
+    interpreter_error(i, "Unimplemented Error\n");
+  }
+}
+
+value_t eval_stmt_conditional(interpreter_t *i, flat_node_t *n) {
+  value_t cond = eval(i, n->as.conditional.condition);
+  gc_hold(i->garbage_collector, cond);
+  value_t res = VALUE_NIL;
+  if (interpreter_is_truthy(i, cond))
+    res = eval_stmt(i, n->as.conditional.then_branch);
+  else if (n->as.conditional.else_branch != FLAT_NONE)
+    res = eval_stmt(i, n->as.conditional.else_branch);
+  gc_release(i->garbage_collector, 1);
+  return res;
+}
+
+value_t eval_stmt_block(interpreter_t *i, flat_node_t *n) {
+  flat_index_t *statements = &i->flat->lists[n->as.statements];
+  uint32_t count = statements[0];
+  int old_size = i->environment->size;
+  value_t v = VALUE_NIL;
+  uint32_t k = 1;
+  for (; k <= count && !i->returning; k++) {
+    v = eval_stmt(i, statements[k]);
+    gc_hold(i->garbage_collector, v);
+  }
+  // The callee of a tail call sees the bindings of the block
+  if (i->tail_call == VALUE_NIL)
+    env_restore(i->environment, old_size);
+  gc_release(i->garbage_collector, k - 1);
+  return v;
+}
+
+value_t eval_stmt_function(interpreter_t *i, flat_index_t index) {
+  flat_node_t *n = &i->flat->nodes[index];
+  closure_t tmp;
+  tmp.identifier = name(i, n->as.function.name);
+  tmp.formals = NULL;
+  tmp.symbols = NULL;
+  tmp.arity = 0;
+  tmp.body = NULL;
+  tmp.code = index;
+  tmp.compiled = NULL;
+  tmp.pure = 0;
+  value_t closure = gc_init_closure(i->garbage_collector, tmp);
+  env_bind(i->environment, symbol(i, n->as.function.name), closure);
+  return closure;
+}
+
+char *name(interpreter_t *i, uint32_t offset) {
+  return i->flat->chars + offset;
+}
+
+uint32_t symbol(interpreter_t *i, uint32_t offset) {
+  return i->resolver->flat[offset];
+}
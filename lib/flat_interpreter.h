@@ -0,0 +1,25 @@
+#ifndef FLAT_INTERPRETER_H
+#define FLAT_INTERPRETER_H
+#include "flat.h"
+#include "interpreter.h"
+
+/**
+ * Run a list of top level statements stored in a flat AST
+ * @param interpreter a pointer to the interpreter to use
+ * @param f a pointer to the flat AST
+ * @param program the index of the list of statements to run
+ * @note The interpreter takes the ownership of the flat AST
+ */
+void flat_interpreter_eval(interpreter_t *, flat_ast_t *, flat_index_t);
+
+/**
+ * Run a single top level statement stored in a flat AST
+ * @param interpreter a pointer to the interpreter to use
+ * @param f a pointer to the flat AST
+ * @param statement the index of the statement to run
+ * @note The interpreter takes the ownership of the flat AST
+ */
+void flat_interpreter_eval_statement(interpreter_t *, flat_ast_t *,
+                                     flat_index_t);
+
+#endif // !FLAT_INTERPRETER_H
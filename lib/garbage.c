@@ -1,5 +1,4 @@
 #include "garbage.h"
-#include "list.h"
 #include "memory.h"
 #include "syntax.h"
 #include <stdio.h>
@@ -7,13 +6,14 @@
 
 #define MARKED 1
 #define UNMARKED 0
+#define TEMPORARIES_INITIAL_CAPACITY 64
 
 /**
  * Perform a DFS og the given value
  * @param gc a pointer to the GC (used for debug purpose)
- * @param v a pointer to the value
+ * @param v the value
  */
-static void dfs(garbage_collector_t *, value_t *);
+static void dfs(garbage_collector_t *, value_t);
 
 /**
  * Perform the marking phase of the mark and sweep algorithm
@@ -28,21 +28,28 @@ static void mark(garbage_collector_t *);
 static void sweep(garbage_collector_t *);
 
 /**
- * Destroy the given value
- * @param val a pointer to the value to destroy
+ * Allocate an object and track it in the GC
+ * @param gc a pointer to the GC that will track the object
+ * @param type the type of the object
+ * @param size the size of the object, header included
+ * @return a pointer to the object
  */
-static void value_destroy(value_t *);
+static object_t *track(garbage_collector_t *, literal_type_t, size_t);
 
 /**
- * A wrapper for the value_destroy() function
+ * Destroy the given object
+ * @param o a pointer to the object to destroy
  */
-static void value_free(void *);
+static void object_destroy(object_t *);
 
 void gc_init(garbage_collector_t *gc, env_t *env, mutex *mtx, cond *cond) {
   memset(gc, 0, sizeof(*gc));
-  gc->values = NULL;
+  gc->objects = NULL;
+  gc->count = 0;
   gc->environment = env;
-  gc->temporary_values = NULL;
+  gc->temporaries = NULL;
+  gc->temporaries_count = 0;
+  gc->temporaries_capacity = 0;
   gc->mtx_memory = mtx;
   gc->cond_between_statements = cond;
   gc->marked = 0;
@@ -51,43 +58,57 @@ void gc_init(garbage_collector_t *gc, env_t *env, mutex *mtx, cond *cond) {
 }
 
 void gc_destroy(garbage_collector_t *gc) {
-  list_dl_free(gc->values, value_free);
-  list_free(gc->temporary_values, value_free);
+  while (gc->objects) {
+    object_t *next = gc->objects->next;
+    object_destroy(gc->objects);
+    gc->objects = next;
+  }
+  gc->count = 0;
+  // Temporary values are owned by the objects list, only the stack is freed
+  mem_free(gc->temporaries);
+  gc->temporaries = NULL;
+  gc->temporaries_count = gc->temporaries_capacity = 0;
   return;
 }
 
-void gc_hold(garbage_collector_t *gc, value_t *val) {
-  list_add(&gc->temporary_values, val);
+void gc_hold(garbage_collector_t *gc, value_t val) {
+  if (gc->temporaries_count == gc->temporaries_capacity) {
+    gc->temporaries_capacity = gc->temporaries_capacity
+                                   ? gc->temporaries_capacity * 2
+                                   : TEMPORARIES_INITIAL_CAPACITY;
+    gc->temporaries = mem_realloc(gc->temporaries,
+                                  gc->temporaries_capacity * sizeof(value_t));
+  }
+  gc->temporaries[gc->temporaries_count++] = val;
   return;
 }
 
 void gc_release(garbage_collector_t *gc, int count) {
-  for (int i = 0; i < count; i++) {
-    l_list_t current = gc->temporary_values;
-    gc->temporary_values = current->next;
-    current->data = NULL;
-    current->next = NULL;
-    mem_free(current);
-  }
+  gc->temporaries_count -= count;
   return;
 }
 
 void gc_run(garbage_collector_t *gc) {
   gc->marked = 0;
   gc->swept = 0;
-  int total = list_dl_len(gc->values);
+  gc->cycles++;
+  int total = gc->count;
   mark(gc);
   sweep(gc);
-  dprintf(2, "[GC]: Count:%d -> %d\tMarked:%d\tSwept:%d\n", total,
-          list_dl_len(gc->values), gc->marked, gc->swept);
+  dprintf(2, "[GC]: Count:%d -> %d\tMarked:%d\tSwept:%d\n", total, gc->count,
+          gc->marked, gc->swept);
 }
 
-void dfs(garbage_collector_t *gc, value_t *v) {
-  if (v->status == UNMARKED)
+void dfs(garbage_collector_t *gc, value_t v) {
+  // Numbers, booleans and nil are not on the heap
+  if (!value_is_object(v))
+    return;
+  object_t *o = value_as_object(v);
+  if (o->status == UNMARKED)
     gc->marked++;
-  v->status = MARKED;
+  o->status = MARKED;
   // TODO: in case of array or list
-  switch (v->type) {
+  switch (o->type) {
   case T_NIL:
   case T_NUMBER:
   case T_STRING:
@@ -99,128 +120,77 @@ void dfs(garbage_collector_t *gc, value_t *v) {
 }
 
 void mark(garbage_collector_t *gc) {
-  l_list_t current = gc->environment->env;
-  while (current) {
-    value_t *v = (value_t *)current->data;
-    dfs(gc, v);
-    current = current->next;
-  }
-  current = gc->temporary_values;
-  while (current) {
-    value_t *v = (value_t *)current->data;
-    dfs(gc, v);
-    current = current->next;
-  }
+  env_t *env = gc->environment;
+  for (uint32_t k = 0; k < env->symbols; k++)
+    dfs(gc, env->values[k]);
+  for (int k = 0; k < env->size; k++)
+    dfs(gc, env->trail[k].old);
+  for (uint32_t k = 0; k < gc->temporaries_count; k++)
+    dfs(gc, gc->temporaries[k]);
   return;
 }
 
 void sweep(garbage_collector_t *gc) {
-  dl_list_t current = gc->values;
-  while (current) {
-    dl_list_t next = current->next;
-    value_t *v = (value_t *)current->data;
-    if (v->status == MARKED)
-      v->status = UNMARKED;
-    else {
+  object_t **current = &gc->objects;
+  while (*current) {
+    object_t *o = *current;
+    if (o->status == MARKED) {
+      o->status = UNMARKED;
+      current = &o->next;
+    } else {
       gc->swept++;
-      value_destroy(v);
-      dl_list_t p = current->prev;
-      dl_list_t n = current->next;
-      if (p)
-        p->next = n;
-      if (n)
-        n->prev = p;
-      mem_free(current);
+      gc->count--;
+      *current = o->next;
+      object_destroy(o);
     }
-    current = next;
   }
   return;
 }
 
-value_t *gc_init_number(garbage_collector_t *gc, double v) {
-  value_t *val = mem_calloc(1, sizeof(value_t));
-  double *d = mem_calloc(1, sizeof(double));
-  *d = v;
-  val->type = T_NUMBER;
-  val->value = d;
-  val->status = MARKED;
-  list_dl_add(&gc->values, val);
-  return val;
+object_t *track(garbage_collector_t *gc, literal_type_t type, size_t size) {
+  object_t *o = mem_calloc(1, size);
+  o->type = type;
+  o->status = MARKED;
+  o->next = gc->objects;
+  gc->objects = o;
+  gc->count++;
+  return o;
 }
 
-value_t *gc_init_boolean(garbage_collector_t *gc, int v) {
-  value_t *val = mem_calloc(1, sizeof(value_t));
-  int *i = mem_calloc(1, sizeof(int));
-  *i = v;
-  val->type = T_BOOLEAN;
-  val->value = i;
-  val->status = MARKED;
-  list_dl_add(&gc->values, val);
-  return val;
+value_t gc_init_string(garbage_collector_t *gc, const char *s) {
+  size_t length = strlen(s);
+  string_t *str =
+      (string_t *)track(gc, T_STRING, sizeof(string_t) + length + 1);
+  memcpy(str->chars, s, length + 1);
+  return value_object(&str->object);
 }
 
-value_t *gc_init_string(garbage_collector_t *gc, char *s) {
-  value_t *val = mem_calloc(1, sizeof(value_t));
-  val->type = T_STRING;
-  val->value = strdup(s);
-  val->status = MARKED;
-  list_dl_add(&gc->values, val);
-  return val;
+value_t gc_init_concat(garbage_collector_t *gc, const char *left,
+                       const char *right) {
+  size_t l = strlen(left);
+  size_t r = strlen(right);
+  string_t *str = (string_t *)track(gc, T_STRING, sizeof(string_t) + l + r + 1);
+  memcpy(str->chars, left, l);
+  memcpy(str->chars + l, right, r);
+  str->chars[l + r] = '\0';
+  return value_object(&str->object);
 }
 
-value_t *gc_init_closure(garbage_collector_t *gc, closure_t c) {
-  value_t *val = mem_calloc(1, sizeof(value_t));
-  closure_t *cls = mem_calloc(1, sizeof(closure_t));
-  l_list_t f = NULL;
-  l_list_t current = c.formals;
-  while (current) {
-    list_add(&f, strdup(current->data));
-    current = current->next;
-  }
-  list_reverse_in_place(&f);
-  cls->identifier = strdup(c.identifier);
-  cls->formals = f;
-  cls->body = stmt_dup(c.body);
-  val->type = T_CLOSURE;
-  val->value = cls;
-  val->status = MARKED;
-  list_dl_add(&gc->values, val);
-  return val;
+value_t gc_init_closure(garbage_collector_t *gc, closure_t c) {
+  closure_object_t *obj =
+      (closure_object_t *)track(gc, T_CLOSURE, sizeof(closure_object_t));
+  obj->closure = c;
+  obj->closure.calls = 0;
+  obj->closure.jit = NULL;
+  obj->closure.lookups = 0;
+  obj->closure.hits = 0;
+  return value_object(&obj->object);
 }
 
-value_t *gc_init_nil(garbage_collector_t *gc) {
-  value_t *val = mem_calloc(1, sizeof(value_t));
-  val->type = T_NIL;
-  val->value = NULL;
-  val->status = MARKED;
-  list_dl_add(&gc->values, val);
-  return val;
-}
-
-void value_destroy(value_t *val) {
-  if (val == NULL)
-    return;
-  switch (val->type) {
-  case T_CLOSURE: {
-    closure_t *tmp = (closure_t *)val->value;
-    mem_free(tmp->identifier);
-    list_free(tmp->formals, NULL);
-    stmt_destroy(tmp->body);
-    mem_free(tmp);
-    break;
-  }
-  case T_STRING:
-  case T_NUMBER:
-  case T_BOOLEAN:
-    mem_free(val->value);
-    break;
-  case T_NIL:
-    break;
-  }
-  val->type = 0;
-  val->status = 0;
-  mem_free(val);
+void object_destroy(object_t *o) {
+  // A closure only borrows the body of its function
+  o->type = 0;
+  o->status = 0;
+  mem_free(o);
   return;
 }
-
-void value_free(void *v) { value_destroy(v); }
@@ -4,21 +4,30 @@
 #include "list.h"
 #include "syntax.h"
 #include "thread.h"
+#include "value.h"
+#include <stdint.h>
 
+/**
+ * A "Mark & Sweep" garbage collector of the objects (strings and closures),
+ * the other values are immediates
+ * @param objects the objects tracked, linked through their header
+ * @param count the number of objects tracked
+ * @param environment the environment, a root of the marking
+ * @param temporaries the values held by the interpreter, also roots
+ * @param cycles the number of collections run
+ */
 typedef struct {
-  literal_type_t type;
-  void *value;
-  int status;
-} value_t;
-
-typedef struct {
-  dl_list_t values;
+  object_t *objects;
+  int count;
   env_t *environment;
-  l_list_t temporary_values;
+  value_t *temporaries;
+  uint32_t temporaries_count;
+  uint32_t temporaries_capacity;
   mutex *mtx_memory;
   cond *cond_between_statements;
   int marked;
   int swept;
+  uint32_t cycles;
 
 } garbage_collector_t;
 
@@ -48,9 +57,9 @@ void gc_run(garbage_collector_t *);
 /**
  * Hold a given value and prevent the deletion until release
  * @param gc a pointer to the GC that will hold the value
- * @param val a pointer to the value to hold
+ * @param val the value to hold
  */
-void gc_hold(garbage_collector_t *, value_t *);
+void gc_hold(garbage_collector_t *, value_t);
 
 /**
  *  Release the last x values hold by the garbage collector
@@ -61,46 +70,29 @@ void gc_hold(garbage_collector_t *, value_t *);
 void gc_release(garbage_collector_t *, int);
 
 /**
- * Initialize a number value in the lotus language and add it in the GC values
- * list
- * @param gc a pointer to the GC that will track the value
- * @param v the number value
- * @return a pointer to the value created by the GC
- */
-value_t *gc_init_number(garbage_collector_t *, double);
-
-/**
- * Initialize a number value in the lotus language and add it in the GC values
- * list
- * @param gc a pointer to the GC that will track the value
- * @param v the boolean value
- * @return a pointer to the value created by the GC
- */
-value_t *gc_init_boolean(garbage_collector_t *, int);
-
-/**
- * Initialize a number value in the lotus language and add it in the GC values
- * list
+ * Initialize a string value in the lotus language and track it in the GC
  * @param gc a pointer to the GC that will track the value
- * @param s the string value
- * @return a pointer to the value created by the GC
+ * @param s the string value, copied
+ * @return the value created by the GC
  */
-value_t *gc_init_string(garbage_collector_t *, char *);
+value_t gc_init_string(garbage_collector_t *, const char *);
 
 /**
- * Initialize a number value in the lotus language and add it in the GC values
- * list
+ * Initialize the concatenation of two strings in the lotus language and track
+ * it in the GC
  * @param gc a pointer to the GC that will track the value
- * @param c the closure value
- * @return a pointer to the value created by the GC
+ * @param left the first string
+ * @param right the second string
+ * @return the value created by the GC
  */
-value_t *gc_init_closure(garbage_collector_t *, closure_t);
+value_t gc_init_concat(garbage_collector_t *, const char *, const char *);
 
 /**
- * Initialize a nil value in the lotus language and add it in the GC values list
+ * Initialize a closure value in the lotus language and track it in the GC
  * @param gc a pointer to the GC that will track the value
- * @return a pointer to the value created by the GC
+ * @param c the closure value, its body and names are shared, not copied
+ * @return the value created by the GC
  */
-value_t *gc_init_nil(garbage_collector_t *);
+value_t gc_init_closure(garbage_collector_t *, closure_t);
 
 #endif // !GARBAGE_H
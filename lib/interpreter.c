@@ -1,87 +1,139 @@
 #include "./interpreter.h"
 #include "./errors.h"
 #include "./garbage.h"
+#include "./jit.h"
 #include "./list.h"
 #include "./memory.h"
+#include "./parser.h"
 #include "./syntax.h"
 #include <math.h>
-#include <setjmp.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-static int stack_pointer;
-static jmp_buf stack[STACK_SIZE];
+#include <sys/resource.h>
 
 /**
  * Evaluate the given expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note This is a facade for the real evaluation functions
  */
-static value_t *eval(interpreter_t *, exp_t *);
+static value_t eval(interpreter_t *, exp_t *);
 /**
  * Evaluate the given literal expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_literal(interpreter_t *, exp_t *);
+static value_t eval_literal(interpreter_t *, exp_t *);
 /**
  * Evaluate the given grouping expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_grouping(interpreter_t *, exp_t *);
+static value_t eval_grouping(interpreter_t *, exp_t *);
 /**
  * Evaluate the given unary expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_unary(interpreter_t *, exp_t *);
+static value_t eval_unary(interpreter_t *, exp_t *);
 /**
  * Evaluate the given binary expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_binary(interpreter_t *, exp_t *);
+static value_t eval_binary(interpreter_t *, exp_t *);
 /**
  * Evaluate the given identifier expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_identifier(interpreter_t *, exp_t *);
+static value_t eval_identifier(interpreter_t *, exp_t *);
 /**
  * Evaluate the given call expression
  * @param i a pointer to the interpreter
  * @param exp a pointer to the expression to evaluate
  * @param forwarded a pointer to a forwarded value to be used as a first
- * argument
- * @return a pointer to the value obtained
+ * argument, NULL if none
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval function
  */
-static value_t *eval_call(interpreter_t *, exp_t *, value_t *);
+static value_t eval_call(interpreter_t *, exp_t *, value_t *);
+/**
+ * Evaluate a binary expression whose site has seen only numbers, a number
+ * left side needs no rooting while the right one is evaluated
+ * @param i a pointer to the interpreter
+ * @param b a pointer to the binary expression
+ * @return the value obtained
+ */
+static value_t eval_numbers(interpreter_t *, exp_binary_t *);
+/**
+ * Specialize an unobserved binary site on the types of its operands, a site
+ * whose operator has no variant for them turns generic
+ * @param i a pointer to the interpreter
+ * @param b a pointer to the binary expression
+ * @param left the left side value
+ * @param right the right side value
+ */
+static void quicken(interpreter_t *, exp_binary_t *, value_t, value_t);
+/**
+ * Apply an arithmetic or comparison operator to two numbers, without checks
+ * @param op the operator
+ * @param l the left side number
+ * @param r the right side number
+ * @return the value obtained
+ */
+static value_t numbers(operator_t, double, double);
 /**
  * Evaluate the given forwarding expression
  * @param i a pointer to the interpreter
  * @param left a pointer to the left side expression
  * @param right a pointer to the right side expression
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the eval_binary function
  */
-static value_t *eval_forwarding(interpreter_t *, exp_t *, exp_t *);
+static value_t eval_forwarding(interpreter_t *, exp_t *, exp_t *);
+/**
+ * Bind the formals of a closure to already evaluated actuals
+ * @param i a pointer to the interpreter
+ * @param closure a pointer to the closure to call
+ * @param values the actuals, in the order of the closure formals
+ * @param count the number of actuals
+ * @return the size of the environment before the binding
+ */
+static int call_bind(interpreter_t *, closure_t *, value_t *, uint32_t);
+/**
+ * Run the body of a closure whose formals are bound
+ * @param i a pointer to the interpreter
+ * @param body a pointer to the body of the closure
+ * @param old_size the size of the environment before the binding
+ * @return the value returned
+ * @note Inlined even without optimizations, so that a call of the program
+ * takes a single frame of eval_call on the C stack
+ */
+__attribute__((always_inline)) static inline value_t
+call_body(interpreter_t *, stmt_t *, int);
+/**
+ * Prepare the pending tail call to run in place of the current one
+ * @param i a pointer to the interpreter
+ * @param old_size the size of the environment before the current call
+ * @return a pointer to the body of the closure called in tail position
+ * @note The closure called is held, it is released once its body has run
+ */
+static stmt_t *call_tail(interpreter_t *, int);
 
 /**
  * Lazy evaluate left and right side of values of an expression
@@ -89,141 +141,136 @@ static value_t *eval_forwarding(interpreter_t *, exp_t *, exp_t *);
  * @param op the type of the operation
  * @param left a pointer to the left side expression
  * @param right a pointer to the right side expression
- * @param left_v a pointer to the left side value
- * @param right_v a pointer to the right side value
+ * @param left_v a pointer where the left side value is stored
+ * @param right_v a pointer where the right side value is stored
  * @return 1 if a short circuit happened, 0 otherwise
  * @note This function do not perform the operation
  */
-static int eval_lazy(interpreter_t *, operator_t, exp_t *, exp_t *, value_t **,
-                     value_t **);
+static int eval_lazy(interpreter_t *, operator_t, exp_t *, exp_t *, value_t *,
+                     value_t *);
 
 /**
  * Evaluate the given statement
  * @param i a pointer to the interpreter
  * @param s a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note This is a facade for the real statement evaluation functions
  */
-static value_t *eval_stmt(interpreter_t *, stmt_t *);
+static value_t eval_stmt(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement expression
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
+ * @note Auxiliary function used inside the main eval_stmt function
+ */
+static value_t eval_stmt_exp(interpreter_t *, stmt_t *);
+/**
+ * Evaluate the given return statement, the enclosing statements stop and
+ * pass the value up to the call
+ * @param i a pointer to the interpreter
+ * @param stmt a pointer to the statement to evaluate
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_exp(interpreter_t *, stmt_t *);
+static value_t eval_stmt_return(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement print
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_print(interpreter_t *, stmt_t *);
+static value_t eval_stmt_print(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement conditional
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_conditional(interpreter_t *, stmt_t *);
+static value_t eval_stmt_conditional(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement block
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_block(interpreter_t *, stmt_t *);
+static value_t eval_stmt_block(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement expression
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_declaration(interpreter_t *, stmt_t *);
+static value_t eval_stmt_declaration(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement assignment
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_assignment(interpreter_t *, stmt_t *);
+static value_t eval_stmt_assignment(interpreter_t *, stmt_t *);
 /**
  * Evaluate the given statement function declaration
  * @param i a pointer to the interpreter
  * @param stmt a pointer to the statement to evaluate
- * @return a pointer to the value obtained
+ * @return the value obtained
  * @note Auxiliary function used inside the main eval_stmt function
  */
-static value_t *eval_stmt_function(interpreter_t *, stmt_t *);
+static value_t eval_stmt_function(interpreter_t *, stmt_t *);
 
 /**
  * @note Utility function
  * @return Nil in the Lotus Language
  */
-static value_t *return_null(interpreter_t *);
+static value_t return_null(interpreter_t *);
 /**
  * Concatenate two strings in the Lotus Language
- * @return a value pointer to the new string
+ * @return the new string
  * @note Utility function
  */
-static value_t *str_concat(interpreter_t *, value_t *, value_t *);
+static value_t str_concat(interpreter_t *, value_t, value_t);
 /**
  * Check if the two given value in the Lotus Language are equal
  * @param i a pointer to the interpreter
- * @param l a pointer to the left side value
- * @param r a pointer to the right side value
+ * @param l the left side value
+ * @param r the right side value
  * @return 1 if they are they are equal, 0 otherwise
  * @note Utility function
  */
-static int is_equal(interpreter_t *, value_t *, value_t *);
-/**
- * Check if the given value is truthy
- * @param i a pointer to the interpreter
- * @param v a pointer to the value
- * @note Utility function
- */
-static int is_truthy(interpreter_t *, value_t *);
-/**
- * Pretty print a list of values
- * @param values a list of values to be printed
- * @note Utility function
- */
-static void bulk_pretty_print(l_list_t);
-/**
- * Pretty print a value
- * @param v a pointer to the value to be printed
- * @note Utility function
- */
-static void pretty_print(value_t *);
-/**
- * Stop the execution and show a formatted error message
- * @param i a pointer to the interpreter
- * @param msg the message to be printed
- */
-__attribute__((noreturn)) __attribute__((format(printf, 2, 3))) static void
-raise_runtime_error(interpreter_t *, char *, ...);
+static int is_equal(interpreter_t *, value_t, value_t);
 
 void interpreter_init(interpreter_t *interpreter, env_t *env,
-                      l_list_t statements,
+                      l_list_t statements, arena_t *arena,
+                      resolver_t *resolver,
                       garbage_collector_t *garbage_collector) {
   memset(interpreter, 0, sizeof(interpreter_t));
   interpreter->statements = statements;
+  interpreter->arena = arena;
+  interpreter->flat = NULL;
   interpreter->environment = env;
+  interpreter->resolver = resolver;
   interpreter->garbage_collector = garbage_collector;
-  interpreter->returned_value = NULL;
-  stack_pointer = 0;
-  memset(stack, 0, sizeof(jmp_buf) * STACK_SIZE);
+  interpreter->max_depth = STACK_SIZE;
+  interpreter->tail_call = VALUE_NIL;
+  // The C stack grows down from about here, up to the size allowed for it
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_STACK, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > 2 * STACK_MARGIN)
+    interpreter->stack_limit = (const char *)__builtin_frame_address(0) -
+                               limit.rlim_cur + STACK_MARGIN;
   return;
 }
 
 void interpreter_destroy(interpreter_t interpreter) {
-  list_free(interpreter.statements, stmt_free);
+  // Statements, identifiers and literals all live in the arena
+  arena_destroy(interpreter.arena);
+  if (interpreter.flat)
+    flat_destroy(interpreter.flat);
   env_destroy(interpreter.environment);
   return;
 }
@@ -237,13 +284,16 @@ void interpreter_eval(interpreter_t *interpreter) {
   return;
 }
 
-value_t *eval_stmt(interpreter_t *i, stmt_t *s) {
+void interpreter_eval_statement(interpreter_t *interpreter,
+                                stmt_t *statement) {
+  eval_stmt(interpreter, statement);
+  return;
+}
+
+value_t eval_stmt(interpreter_t *i, stmt_t *s) {
   switch (s->type) {
   case STMT_RETURN:
-    if (stack_pointer - 1 < 0)
-      raise_runtime_error(i, "return can used only inside a function\n");
-    i->returned_value = eval_stmt_exp(i, s);
-    longjmp(stack[stack_pointer - 1], 1);
+    return eval_stmt_return(i, s);
   case STMT_EXPR:
     return eval_stmt_exp(i, s);
     break;
@@ -269,11 +319,11 @@ value_t *eval_stmt(interpreter_t *i, stmt_t *s) {
     // gc_run(i->garbage_collector);
     break;
   default:
-    raise_runtime_error(i, "Unimplemented Error\n");
+    interpreter_error(i, "Unimplemented Error\n");
   }
 }
 
-value_t *eval(interpreter_t *i, exp_t *exp) {
+value_t eval(interpreter_t *i, exp_t *exp) {
   switch (exp->type) {
   case EXP_UNARY:
     return eval_unary(i, exp);
@@ -288,287 +338,464 @@ value_t *eval(interpreter_t *i, exp_t *exp) {
   case EXP_CALL:
     return eval_call(i, exp, NULL);
   default:
-    raise_runtime_error(i, "Unknown expression\n");
+    interpreter_error(i, "Unknown expression\n");
   }
 }
 
-value_t *eval_literal(interpreter_t *i, exp_t *exp) {
+value_t eval_literal(interpreter_t *i, exp_t *exp) {
   exp_literal_t *unwrapped_exp = exp_unwrap(exp);
   switch (unwrapped_exp->type) {
   case T_STRING:
-    return gc_init_string(i->garbage_collector, unwrapped_exp->value);
+    return gc_init_string(i->garbage_collector, unwrapped_exp->value.string);
   case T_NUMBER:
-    return gc_init_number(i->garbage_collector,
-                          *((double *)unwrapped_exp->value));
+    return value_number(unwrapped_exp->value.number);
   case T_BOOLEAN:
-    return gc_init_boolean(i->garbage_collector,
-                           *((int *)unwrapped_exp->value));
+    return value_boolean(unwrapped_exp->value.boolean);
   case T_NIL:
-    return gc_init_nil(i->garbage_collector);
+    return VALUE_NIL;
   default:
     __builtin_unreachable();
   }
 }
 
-value_t *eval_identifier(interpreter_t *i, exp_t *exp) {
+value_t eval_identifier(interpreter_t *i, exp_t *exp) {
   exp_identifier_t *unwrapped_exp = exp_unwrap(exp);
-  value_t *v = env_get(i->environment, unwrapped_exp->identifier);
-  if (v == NULL)
-    raise_runtime_error(i, "The identifier '%s' was not declared\n",
-                        unwrapped_exp->identifier);
+  value_t v;
+  if (!env_get(i->environment, unwrapped_exp->symbol, &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      unwrapped_exp->identifier);
   return v;
 }
 
-value_t *eval_grouping(interpreter_t *i, exp_t *exp) {
+value_t eval_grouping(interpreter_t *i, exp_t *exp) {
   exp_grouping_t *unwrapped_exp = exp_unwrap(exp);
   return eval(i, unwrapped_exp->exp);
 }
 
-value_t *eval_unary(interpreter_t *i, exp_t *exp) {
+value_t eval_unary(interpreter_t *i, exp_t *exp) {
   exp_unary_t *unwrapped_exp = exp_unwrap(exp);
-  value_t *right = eval(i, unwrapped_exp->right);
-  switch (unwrapped_exp->op) {
+  value_t right = eval(i, unwrapped_exp->right);
+  return interpreter_unary_site(i, unwrapped_exp, right);
+}
+
+value_t interpreter_unary(interpreter_t *i, operator_t op, value_t right) {
+  switch (op) {
   case OP_MINUS:
-    if (right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operand must be a number\n");
-    return gc_init_number(i->garbage_collector, -(*(double *)right->value));
+    if (!value_is_number(right))
+      interpreter_error(i, "Type Error:\t Operand must be a number\n");
+    return value_number(-value_as_number(right));
   case OP_NOT:
-    return gc_init_boolean(i->garbage_collector, !is_truthy(i, right));
+    return value_boolean(!interpreter_is_truthy(i, right));
   default: // Theoretically unreachable
-    raise_runtime_error(i, "Unkown operation\n");
+    interpreter_error(i, "Unkown operation\n");
   }
 }
 
-value_t *eval_binary(interpreter_t *i, exp_t *exp) {
+value_t eval_binary(interpreter_t *i, exp_t *exp) {
   exp_binary_t *unwrapped_exp = exp_unwrap(exp);
-  int short_circuit = 0;
-  value_t *right = NULL;
-  value_t *left = NULL;
-  value_t *result = NULL;
-  switch (unwrapped_exp->op) {
-  case OP_FORWARD:
+  if (unwrapped_exp->op == OP_FORWARD)
     return eval_forwarding(i, unwrapped_exp->left, unwrapped_exp->right);
+  if (unwrapped_exp->quick == QUICK_NUMBERS)
+    return eval_numbers(i, unwrapped_exp);
+  value_t right = VALUE_NIL;
+  value_t left = VALUE_NIL;
+  int short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
+                                unwrapped_exp->right, &left, &right);
+  value_t result = interpreter_binary_site(i, unwrapped_exp, left, right);
+  gc_release(i->garbage_collector, short_circuit ? 1 : 2);
+  return result;
+}
+
+value_t eval_numbers(interpreter_t *i, exp_binary_t *b) {
+  value_t left = eval(i, b->left);
+  if (value_is_number(left)) {
+    value_t right = eval(i, b->right);
+    if (value_is_number(right))
+      return numbers(b->op, value_as_number(left), value_as_number(right));
+    // Nothing is allocated by an operator with a number operand
+    return interpreter_binary_site(i, b, left, right);
+  }
+  gc_hold(i->garbage_collector, left);
+  value_t right = eval(i, b->right);
+  gc_hold(i->garbage_collector, right);
+  value_t result = interpreter_binary_site(i, b, left, right);
+  gc_release(i->garbage_collector, 2);
+  return result;
+}
+
+value_t interpreter_unary_site(interpreter_t *i, exp_unary_t *u,
+                               value_t right) {
+  switch (u->quick) {
+  case QUICK_NUMBERS:
+    if (value_is_number(right))
+      return value_number(-value_as_number(right));
+    break;
+  case QUICK_BOOLEANS:
+    if (value_is_boolean(right))
+      return value_boolean(!value_as_boolean(right));
+    break;
+  case QUICK_NONE:
+    if (u->op == OP_MINUS && value_is_number(right))
+      u->quick = QUICK_NUMBERS;
+    else if (u->op == OP_NOT && value_is_boolean(right))
+      u->quick = QUICK_BOOLEANS;
+    else
+      u->quick = QUICK_GENERIC;
+    if (u->quick != QUICK_GENERIC)
+      i->quickened++;
+    return interpreter_unary(i, u->op, right);
+  default:
+    return interpreter_unary(i, u->op, right);
+  }
+  // The guard failed, the site is polymorphic
+  u->quick = QUICK_GENERIC;
+  i->deoptimized++;
+  return interpreter_unary(i, u->op, right);
+}
+
+value_t interpreter_binary_site(interpreter_t *i, exp_binary_t *b,
+                                value_t left, value_t right) {
+  switch (b->quick) {
+  case QUICK_NUMBERS:
+    if (value_is_number(left) && value_is_number(right))
+      return numbers(b->op, value_as_number(left), value_as_number(right));
+    break;
+  case QUICK_STRINGS:
+    if (value_type(left) != T_STRING || value_type(right) != T_STRING)
+      break;
+    if (b->op == OP_PLUS)
+      return str_concat(i, left, right);
+    return value_boolean(
+        (strcmp(value_as_string(left), value_as_string(right)) == 0) ==
+        (b->op == OP_EQUAL));
+  case QUICK_BOOLEANS:
+    if (value_is_boolean(left) && value_is_boolean(right))
+      return value_boolean((left == right) == (b->op == OP_EQUAL));
+    break;
+  case QUICK_NONE:
+    quicken(i, b, left, right);
+    return interpreter_binary(i, b->op, left, right);
+  default:
+    return interpreter_binary(i, b->op, left, right);
+  }
+  // A guard failed, the site is polymorphic
+  b->quick = QUICK_GENERIC;
+  i->deoptimized++;
+  return interpreter_binary(i, b->op, left, right);
+}
+
+void quicken(interpreter_t *i, exp_binary_t *b, value_t left, value_t right) {
+  literal_type_t type = value_type(left);
+  int equality = b->op == OP_EQUAL || b->op == OP_NOT_EQUAL;
+  b->quick = QUICK_GENERIC;
+  if (b->op == OP_AND || b->op == OP_OR || type != value_type(right))
+    return;
+  if (type == T_NUMBER)
+    b->quick = QUICK_NUMBERS;
+  else if (type == T_STRING && (equality || b->op == OP_PLUS))
+    b->quick = QUICK_STRINGS;
+  else if (type == T_BOOLEAN && equality)
+    b->quick = QUICK_BOOLEANS;
+  if (b->quick != QUICK_GENERIC)
+    i->quickened++;
+  return;
+}
+
+value_t numbers(operator_t op, double l, double r) {
+  switch (op) {
+  case OP_PLUS:
+    return value_number(l + r);
   case OP_MINUS:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_number(i->garbage_collector,
-                       *((double *)left->value) - *((double *)right->value));
+    return value_number(l - r);
+  case OP_STAR:
+    return value_number(l * r);
+  case OP_SLASH:
+    return value_number(l / r);
+  case OP_MOD:
+    return value_number(fmod(l, r));
+  case OP_GREATER:
+    return value_boolean(l > r);
+  case OP_GREATER_EQUAL:
+    return value_boolean(l >= r);
+  case OP_LESS:
+    return value_boolean(l < r);
+  case OP_LESS_EQUAL:
+    return value_boolean(l <= r);
+  case OP_EQUAL:
+    return value_boolean(l == r);
+  default: // OP_NOT_EQUAL, the logic operators are never specialized
+    return value_boolean(l != r);
+  }
+}
+
+value_t interpreter_binary(interpreter_t *i, operator_t op, value_t left,
+                           value_t right) {
+  value_t result = VALUE_NIL;
+  int numbers = value_is_number(left) && value_is_number(right);
+  switch (op) {
+  case OP_MINUS:
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_number(value_as_number(left) - value_as_number(right));
     break;
   case OP_STAR:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_number(i->garbage_collector,
-                       *((double *)left->value) * *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_number(value_as_number(left) * value_as_number(right));
     break;
   case OP_SLASH:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_number(i->garbage_collector,
-                       *((double *)left->value) / *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_number(value_as_number(left) / value_as_number(right));
     break;
   case OP_PLUS:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type == T_NUMBER && right->type == T_NUMBER)
-      result =
-          gc_init_number(i->garbage_collector,
-                         *((double *)left->value) + *((double *)right->value));
-    else if (left->type == T_STRING && right->type == T_STRING)
+    if (numbers)
+      result = value_number(value_as_number(left) + value_as_number(right));
+    else if (value_type(left) == T_STRING && value_type(right) == T_STRING)
       result = str_concat(i, left, right);
     else
-      raise_runtime_error(
+      interpreter_error(
           i, "Type Error:\t Operands must be two numbers or two strings\n");
     break;
   case OP_MOD:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER) {
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
+    if (!numbers) {
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
     }
     result =
-        gc_init_number(i->garbage_collector, fmod(*((double *)left->value),
-                                                  *((double *)right->value)));
+        value_number(fmod(value_as_number(left), value_as_number(right)));
     break;
   case OP_GREATER:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_boolean(i->garbage_collector,
-                        *((double *)left->value) > *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_boolean(value_as_number(left) > value_as_number(right));
     break;
   case OP_GREATER_EQUAL:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_boolean(i->garbage_collector,
-                        *((double *)left->value) >= *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_boolean(value_as_number(left) >= value_as_number(right));
     break;
   case OP_LESS:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_boolean(i->garbage_collector,
-                        *((double *)left->value) < *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_boolean(value_as_number(left) < value_as_number(right));
     break;
   case OP_LESS_EQUAL:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    if (left->type != T_NUMBER || right->type != T_NUMBER)
-      raise_runtime_error(i, "Type Error:\t Operands must be numbers\n");
-    result =
-        gc_init_boolean(i->garbage_collector,
-                        *((double *)left->value) <= *((double *)right->value));
+    if (!numbers)
+      interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+    result = value_boolean(value_as_number(left) <= value_as_number(right));
     break;
   case OP_EQUAL:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    result = gc_init_boolean(i->garbage_collector, is_equal(i, left, right));
+    result = value_boolean(is_equal(i, left, right));
     break;
   case OP_NOT_EQUAL:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    result = gc_init_boolean(i->garbage_collector, !is_equal(i, left, right));
+    result = value_boolean(!is_equal(i, left, right));
     break;
   case OP_AND:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    result = gc_init_boolean(i->garbage_collector,
-                             *((int *)left->value) && *((int *)right->value));
+    result = value_boolean(value_as_boolean(left) && value_as_boolean(right));
     break;
   case OP_OR:
-    short_circuit = eval_lazy(i, unwrapped_exp->op, unwrapped_exp->left,
-                              unwrapped_exp->right, &left, &right);
-    result = gc_init_boolean(i->garbage_collector,
-                             *((int *)left->value) || *((int *)right->value));
+    result = value_boolean(value_as_boolean(left) || value_as_boolean(right));
     break;
   default: // Theoretically unreachable
-    raise_runtime_error(i, "Unkown Operation\n");
+    interpreter_error(i, "Unkown Operation\n");
   }
-  gc_release(i->garbage_collector, short_circuit ? 1 : 2);
   return result;
 }
 
 int eval_lazy(interpreter_t *i, operator_t op, exp_t *left, exp_t *right,
-              value_t **left_v, value_t **right_v) {
+              value_t *left_v, value_t *right_v) {
   *left_v = eval(i, left);
   gc_hold(i->garbage_collector, *left_v);
   switch (op) {
   case OP_AND:
-    if ((*left_v)->type != T_BOOLEAN)
-      raise_runtime_error(i, "Type Error:\t Operands must be booleans\n");
-    if (*((int *)(*left_v)->value) == 0)
+    if (!value_is_boolean(*left_v))
+      interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+    if (!value_as_boolean(*left_v))
       return 1;
     break;
   case OP_OR:
-    if ((*left_v)->type != T_BOOLEAN)
-      raise_runtime_error(i, "Type Error:\t Operands must be booleans\n");
-    if (*((int *)(*left_v)->value) == 1)
+    if (!value_is_boolean(*left_v))
+      interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+    if (value_as_boolean(*left_v))
       return 1;
     break;
   default:
     break;
   }
   *right_v = eval(i, right);
-  if ((op == OP_AND || op == OP_OR) && (*right_v)->type != T_BOOLEAN)
-    raise_runtime_error(i, "Type Error:\t Operands must be booleans\n");
+  if ((op == OP_AND || op == OP_OR) && !value_is_boolean(*right_v))
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
   gc_hold(i->garbage_collector, *right_v);
   return 0;
 }
 
-value_t *eval_forwarding(interpreter_t *i, exp_t *left, exp_t *right) {
+value_t eval_forwarding(interpreter_t *i, exp_t *left, exp_t *right) {
   if (right->type != EXP_CALL)
-    raise_runtime_error(i, "Expected a function call after |>\n");
-  value_t *left_v = eval(i, left);
+    interpreter_error(i, "Expected a function call after |>\n");
+  value_t left_v = eval(i, left);
   gc_hold(i->garbage_collector, left_v);
-  value_t *res = eval_call(i, right, left_v);
+  value_t res = eval_call(i, right, &left_v);
   gc_release(i->garbage_collector, 1);
   return res;
 }
 
-value_t *eval_call(interpreter_t *i, exp_t *exp, value_t *forwarded) {
+value_t eval_call(interpreter_t *i, exp_t *exp, value_t *forwarded) {
   exp_call_t *unwrapped_exp = exp_unwrap(exp);
-  // Evaluating all actuals parameters
-  l_list_t values = NULL;
-  l_list_t expressions = unwrapped_exp->actuals;
-  int count = 0;
-  while (expressions != NULL) {
-    value_t *tmp = eval(i, expressions->data);
-    gc_hold(i->garbage_collector, tmp);
-    list_add(&values, tmp);
-    count++;
-    expressions = expressions->next;
-  }
+  garbage_collector_t *gc = i->garbage_collector;
+  // The actuals are evaluated on top of the held values, the forwarded value
+  // comes last: they are the frame bound by the callee, popped on return
+  uint32_t frame = gc->temporaries_count;
+  for (l_list_t e = unwrapped_exp->actuals; e; e = e->next)
+    gc_hold(gc, eval(i, e->data));
   if (forwarded)
-    list_add(&values, forwarded);
-  list_reverse_in_place(&values);
-  // Get the closure from the environment
-  value_t *v = env_get(i->environment, unwrapped_exp->identifier);
-  if (v == NULL)
-    raise_runtime_error(i, "The identifier '%s' was not declared\n",
-                        unwrapped_exp->identifier);
-  if (v->type != T_CLOSURE)
-    raise_runtime_error(i, "The identifier '%s' is not a function name\n",
-                        unwrapped_exp->identifier);
-  closure_t *closure = (closure_t *)v->value;
+    gc_hold(gc, *forwarded);
+  uint32_t k = gc->temporaries_count - frame;
+  stmt_t *body;
+  closure_t *closure =
+      value_as_closure(interpreter_callee(i, unwrapped_exp, &body));
+  // A pure callee already called with the same actuals is not run again, in
+  // tail position too (a wrong number of actuals still raises its error)
+  value_t res;
+  int memoized = i->memo && closure->pure && k == closure->arity &&
+                 memo_accepts(gc->temporaries + frame, k);
+  if (memoized) {
+    int hit = memo_lookup(i->memo, body, gc->temporaries + frame, k, &res);
+    closure->pure = memo_sample(&closure->lookups, &closure->hits, hit);
+    if (hit) {
+      gc_release(gc, k);
+      return res;
+    }
+  }
+  if (unwrapped_exp->tail) {
+    // The callee replaces the caller: its formals are bound now, the caller
+    // statements unwind keeping their bindings and interpreter_call runs it
+    call_bind(i, closure, gc->temporaries + frame, k);
+    gc_release(gc, k);
+    // The cache of the call holds the callee just looked up
+    i->tail_call = unwrapped_exp->cache.closure;
+    i->returning = 1;
+    return VALUE_NIL;
+  }
+  // A hot closure runs natively, unless its arguments fail the type guards
+  if (i->jit == NULL ||
+      !jit_call(i->jit, closure, gc->temporaries + frame, k, &res))
+    res = call_body(i, body, call_bind(i, closure, gc->temporaries + frame, k));
+  // The table is not a root of the GC, the results on its heap are not kept
+  if (memoized && !value_is_object(res))
+    memo_store(i->memo, body, gc->temporaries + frame, k, res);
+  // Popping the frame
+  gc_release(gc, k);
+  return res;
+}
+
+stmt_t *interpreter_body(interpreter_t *i, closure_t *closure) {
+  if (closure->body->type != STMT_LAZY)
+    return closure->body;
+  stmt_lazy_t *lazy = stmt_unwrap(closure->body);
+  if (lazy->body)
+    return lazy->body;
+  stmt_t *body = parser_parse_lazy(lazy);
+  if (body)
+    resolver_resolve_body(i->resolver, body);
+  if (body && i->optimizer)
+    optimizer_optimize_statement(i->optimizer, body);
+  return body;
+}
+
+value_t interpreter_callee(interpreter_t *i, exp_call_t *call, stmt_t **body) {
+  value_t v;
+  if (!env_get(i->environment, call->symbol, &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      call->identifier);
+  if (v == call->cache.closure &&
+      call->cache.cycle == i->garbage_collector->cycles) {
+    i->cache_hits++;
+    *body = call->cache.body;
+    return v;
+  }
+  i->cache_misses++;
+  if (value_type(v) != T_CLOSURE)
+    interpreter_error(i, "The identifier '%s' is not a function name\n",
+                      call->identifier);
+  closure_t *closure = value_as_closure(v);
+  *body = interpreter_body(i, closure);
+  if (*body == NULL)
+    interpreter_error(i, "The body of '%s' has syntax errors\n",
+                      closure->identifier);
+  call->cache.closure = v;
+  call->cache.body = *body;
+  call->cache.cycle = i->garbage_collector->cycles;
+  return v;
+}
+
+value_t interpreter_call(interpreter_t *i, closure_t *closure,
+                         value_t *values, uint32_t count) {
+  stmt_t *body = interpreter_body(i, closure);
+  if (body == NULL)
+    interpreter_error(i, "The body of '%s' has syntax errors\n",
+                      closure->identifier);
+  return call_body(i, body, call_bind(i, closure, values, count));
+}
+
+int call_bind(interpreter_t *i, closure_t *closure, value_t *values,
+              uint32_t count) {
   // Saving the current size of the environment
   int old_size = i->environment->size;
-  if (!env_bulk_bind(i->environment, closure->formals, values))
-    raise_runtime_error(i,
-                        "actuals number and formals number are not the same");
-  // Releasing the actuals (now they are reachable from the env)
-  gc_release(i->garbage_collector, count);
-  // Saving the stack pointer preparing for the long jump (return)
-  int old_sp = stack_pointer;
-  if (stack_pointer >= STACK_SIZE)
-    raise_runtime_error(i, "Stack overflow\n");
-  int jmp = setjmp(stack[stack_pointer++]);
-  // Check if a jmp (return) has happened and set the return value properly
-  value_t *res = jmp ? i->returned_value : eval_stmt(i, closure->body);
-  // Restoring the environment, stack pointer and cleaning memory
-  env_restore(i->environment, old_size);
-  while (values) {
-    l_list_t tmp = values;
-    values = values->next;
-    mem_free(tmp);
+  if (!env_bulk_bind(i->environment, closure->symbols, closure->arity, values,
+                     count))
+    interpreter_error(i, "actuals number and formals number are not the same");
+  return old_size;
+}
+
+value_t call_body(interpreter_t *i, stmt_t *body, int old_size) {
+  interpreter_enter(i);
+  value_t res = eval_stmt(i, body);
+  // A tail call runs in place of this one
+  while (i->tail_call != VALUE_NIL) {
+    res = eval_stmt(i, call_tail(i, old_size));
+    gc_release(i->garbage_collector, 1);
   }
-  stack_pointer = old_sp;
-  res->status = 1;
+  // A return unwinds up to here
+  interpreter_leave(i, old_size);
   return res;
 }
 
-value_t *eval_stmt_exp(interpreter_t *i, stmt_t *s) {
+stmt_t *call_tail(interpreter_t *i, int old_size) {
+  closure_t *closure = interpreter_tail(i, old_size);
+  stmt_t *body = interpreter_body(i, closure);
+  if (body == NULL)
+    interpreter_error(i, "The body of '%s' has syntax errors\n",
+                      closure->identifier);
+  return body;
+}
+
+value_t eval_stmt_exp(interpreter_t *i, stmt_t *s) {
   stmt_expr_t *unwrapped_stmt = stmt_unwrap(s);
   return eval(i, unwrapped_stmt->exp);
 }
 
-value_t *eval_stmt_print(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_return(interpreter_t *i, stmt_t *s) {
+  if (i->depth == 0)
+    interpreter_error(i, "return can used only inside a function\n");
+  stmt_expr_t *unwrapped_stmt = stmt_unwrap(s);
+  value_t v = eval(i, unwrapped_stmt->exp);
+  i->returning = 1;
+  return v;
+}
+
+value_t eval_stmt_print(interpreter_t *i, stmt_t *s) {
   stmt_print_t *unwrapped_stmt = stmt_unwrap(s);
-  value_t *v = eval(i, unwrapped_stmt->exp);
-  pretty_print(v);
+  value_t v = eval(i, unwrapped_stmt->exp);
+  interpreter_print(v);
   return return_null(i);
 }
 
-value_t *eval_stmt_conditional(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_conditional(interpreter_t *i, stmt_t *s) {
   stmt_conditional_t *unwrapped_stmt = stmt_unwrap(s);
-  value_t *cond = eval(i, unwrapped_stmt->condition);
+  value_t cond = eval(i, unwrapped_stmt->condition);
   gc_hold(i->garbage_collector, cond);
-  value_t *res = return_null(i);
-  if (is_truthy(i, cond))
+  value_t res = return_null(i);
+  if (interpreter_is_truthy(i, cond))
     res = eval_stmt(i, unwrapped_stmt->then_branch);
   else if (unwrapped_stmt->else_branch != NULL)
     res = eval_stmt(i, unwrapped_stmt->else_branch);
@@ -576,126 +803,116 @@ value_t *eval_stmt_conditional(interpreter_t *i, stmt_t *s) {
   return res;
 }
 
-value_t *eval_stmt_block(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_block(interpreter_t *i, stmt_t *s) {
   stmt_block_t *unwrapped_stmt = stmt_unwrap(s);
   l_list_t stmts = unwrapped_stmt->statements;
   int old_size = i->environment->size;
-  value_t *v = return_null(i);
+  value_t v = return_null(i);
   int count = 0;
-  while (stmts) {
+  while (stmts && !i->returning) {
     stmt_t *stmt = (stmt_t *)stmts->data;
     v = eval_stmt(i, stmt);
     gc_hold(i->garbage_collector, v);
     count++;
     stmts = stmts->next;
   }
-  env_restore(i->environment, old_size);
+  // The callee of a tail call sees the bindings of the block
+  if (i->tail_call == VALUE_NIL)
+    env_restore(i->environment, old_size);
   gc_release(i->garbage_collector, count);
   return v;
 }
 
-value_t *eval_stmt_declaration(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_declaration(interpreter_t *i, stmt_t *s) {
   stmt_declaration_t *unwrapped_stmt = stmt_unwrap(s);
-  value_t *v = eval(i, unwrapped_stmt->exp);
-  env_bind(i->environment, unwrapped_stmt->identifier, v);
+  value_t v = eval(i, unwrapped_stmt->exp);
+  env_bind(i->environment, unwrapped_stmt->symbol, v);
   return v;
 }
 
-value_t *eval_stmt_assignment(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_assignment(interpreter_t *i, stmt_t *s) {
   stmt_assignment_t *unwrapped_stmt = stmt_unwrap(s);
-  value_t *res = eval(i, unwrapped_stmt->exp);
-  env_set(i->environment, unwrapped_stmt->identifier, res);
+  value_t res = eval(i, unwrapped_stmt->exp);
+  env_set(i->environment, unwrapped_stmt->symbol, res);
   return res;
 }
 
-value_t *eval_stmt_function(interpreter_t *i, stmt_t *s) {
+value_t eval_stmt_function(interpreter_t *i, stmt_t *s) {
   stmt_function_t *unwrapped_stmt = stmt_unwrap(s);
   closure_t tmp;
   tmp.body = unwrapped_stmt->body;
   tmp.formals = unwrapped_stmt->formals;
+  tmp.symbols = unwrapped_stmt->symbols;
+  tmp.arity = unwrapped_stmt->arity;
   tmp.identifier = unwrapped_stmt->identifier;
-  value_t *closure = gc_init_closure(i->garbage_collector, tmp);
-  env_bind(i->environment, unwrapped_stmt->identifier, closure);
+  tmp.code = 0;
+  tmp.compiled = NULL;
+  tmp.pure = unwrapped_stmt->pure;
+  value_t closure = gc_init_closure(i->garbage_collector, tmp);
+  env_bind(i->environment, unwrapped_stmt->symbol, closure);
   return closure;
 }
 
-value_t *return_null(interpreter_t *i) {
-  return gc_init_nil(i->garbage_collector);
-}
+value_t return_null(interpreter_t *i) { return VALUE_NIL; }
 
-int is_equal(interpreter_t *i, value_t *l, value_t *r) {
-  if (l->type != r->type)
-    raise_runtime_error(i,
+int is_equal(interpreter_t *i, value_t l, value_t r) {
+  literal_type_t type = value_type(l);
+  if (type != value_type(r))
+    interpreter_error(i,
                         "Type Error:\tComparison between 2 different type!\n");
 
-  switch (l->type) {
+  switch (type) {
   case T_NUMBER:
-    return *(double *)l->value == *(double *)r->value;
+    return value_as_number(l) == value_as_number(r);
   case T_NIL:
     return 1;
   case T_BOOLEAN:
-    return *(int *)l->value == *(int *)r->value;
+    return l == r;
   case T_STRING:
-    return strcmp((char *)l->value, (char *)r->value) == 0;
+    return strcmp(value_as_string(l), value_as_string(r)) == 0;
   case T_CLOSURE:
-    raise_runtime_error(i, "Type Error:\t Functions cannot be compared\n");
+    interpreter_error(i, "Type Error:\t Functions cannot be compared\n");
   }
   __builtin_unreachable();
 }
 
-int is_truthy(interpreter_t *i, value_t *v) {
-  switch (v->type) {
-  case T_BOOLEAN:
-    return *((int *)v->value);
-  default:
-    raise_runtime_error(i, "Type Error:\tImplicit casting is not permitted!\n");
-  }
+int interpreter_is_truthy(interpreter_t *i, value_t v) {
+  if (!value_is_boolean(v))
+    interpreter_error(i, "Type Error:\tImplicit casting is not permitted!\n");
+  return value_as_boolean(v);
 }
 
-void pretty_print(value_t *v) {
-  switch (v->type) {
+void interpreter_print(value_t v) {
+  switch (value_type(v)) {
   case T_NUMBER:
-    if (fmod(*((double *)v->value), 1) == 0)
-      printf("%.0f\n", *((double *)v->value));
+    if (fmod(value_as_number(v), 1) == 0)
+      printf("%.0f\n", value_as_number(v));
     else
-      printf("%.2f\n", *((double *)v->value));
+      printf("%.2f\n", value_as_number(v));
     break;
   case T_STRING:
-    printf("%s\n", (char *)v->value);
+    printf("%s\n", value_as_string(v));
     break;
   case T_NIL:
     printf("nil\n");
     break;
   case T_BOOLEAN:
-    printf("%s\n", *((int *)v->value) ? "true" : "false");
+    printf("%s\n", value_as_boolean(v) ? "true" : "false");
     break;
   case T_CLOSURE:
-    printf("fun%s\n", ((closure_t *)v->value)->identifier);
+    printf("fun%s\n", value_as_closure(v)->identifier);
     break;
   }
   fflush(stdout);
   return;
 }
 
-value_t *str_concat(interpreter_t *i, value_t *left, value_t *right) {
-  char *l = strdup((char *)left->value);
-  char *r = strdup((char *)right->value);
-  value_t *res = gc_init_string(i->garbage_collector, strcat(l, r));
-  mem_free(l);
-  mem_free(r);
-  return res;
-}
-
-void bulk_pretty_print(l_list_t values) {
-  l_list_t value = values;
-  while (value != NULL) {
-    pretty_print(value->data);
-    value = value->next;
-  }
-  return;
+value_t str_concat(interpreter_t *i, value_t left, value_t right) {
+  return gc_init_concat(i->garbage_collector, value_as_string(left),
+                        value_as_string(right));
 }
 
-void raise_runtime_error(interpreter_t *i, char *msg, ...) {
+void interpreter_error(interpreter_t *i, char *msg, ...) {
   va_list ap;
   va_start(ap, msg);
   err_log_v(ERROR, msg, ap);
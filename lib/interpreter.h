@@ -1,18 +1,64 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
+#include "arena.h"
 #include "environment.h"
+#include "flat.h"
 #include "garbage.h"
 #include "list.h"
+#include "memo.h"
+#include "optimizer.h"
+#include "resolver.h"
 #include "syntax.h"
-#include <setjmp.h>
+#include "value.h"
+#include <stdint.h>
 
 #define STACK_SIZE 100000
+// The C stack left below the guard of the engines recursing on it, for the
+// natives they call and for the report of the overflow
+#define STACK_MARGIN (256 * 1024)
 
+/**
+ * @param depth the number of calls being evaluated
+ * @param max_depth the depth raising a stack overflow, 0 for no limit
+ * @param stack_limit the lowest address of the C stack a call may start
+ * from, past it a stack overflow is raised instead of crashing, NULL for no
+ * guard
+ * @param returning 1 while a return statement unwinds to its function, the
+ * statements evaluators stop as soon as it is set
+ * @param tail_call the closure called in tail position while the statements
+ * unwind to the call it replaces (its formals are already bound), VALUE_NIL
+ * if none
+ * @param cache_hits the calls whose closure was found in the inline cache of
+ * their call site
+ * @param cache_misses the calls that looked their closure up and filled the
+ * inline cache of their call site
+ * @param quickened the operator sites specialized on the types of their
+ * operands
+ * @param deoptimized the specialized operator sites that turned generic
+ * @param optimizer the optimizer of the bodies parsed lazily, NULL to run them
+ * as parsed
+ * @param memo the results of the calls of the pure closures, NULL to run every
+ * call
+ */
 typedef struct {
   l_list_t statements;
+  arena_t *arena;
+  flat_ast_t *flat;
   env_t *environment;
+  resolver_t *resolver;
+  optimizer_t *optimizer;
+  memo_t *memo;
   garbage_collector_t *garbage_collector;
-  value_t *returned_value;
+  uint32_t depth;
+  uint32_t max_depth;
+  const char *stack_limit;
+  int returning;
+  value_t tail_call;
+  uint64_t cache_hits;
+  uint64_t cache_misses;
+  uint64_t quickened;
+  uint64_t deoptimized;
+  struct jit *jit;
 } interpreter_t;
 
 /**
@@ -20,10 +66,13 @@ typedef struct {
  * @param interpreter a pointer to the interpreter to initialize
  * @param env a pointer to the environment to use
  * @param statements a list of statements to be interpreted
+ * @param arena a pointer to the arena owning the statements
+ * @param resolver a pointer to the resolver that assigned the symbols
  * @param garbage_collector a pointer to the GC to use
+ * @note The interpreter takes the ownership of the arena
  */
-void interpreter_init(interpreter_t *, env_t *, l_list_t,
-                      garbage_collector_t *);
+void interpreter_init(interpreter_t *, env_t *, l_list_t, arena_t *,
+                      resolver_t *, garbage_collector_t *);
 
 /**
  * Destroy the given interpreter
@@ -37,4 +86,169 @@ void interpreter_destroy(interpreter_t);
  */
 void interpreter_eval(interpreter_t *);
 
+/**
+ * Run a single top level statement with the given interpreter
+ * @param interpreter a pointer to the interpreter to use
+ * @param statement a pointer to the statement to run
+ * @note The statement must live in the interpreter arena
+ */
+void interpreter_eval_statement(interpreter_t *, stmt_t *);
+
+/**
+ * Get the body of a closure, a body skipped by a lazy parser is parsed and
+ * resolved on its first use
+ * @param interpreter a pointer to the interpreter
+ * @param closure a pointer to the closure
+ * @return a pointer to the body, NULL if it has syntax errors
+ */
+stmt_t *interpreter_body(interpreter_t *, closure_t *);
+
+/**
+ * Get the closure called by a call expression, through the inline cache of the
+ * call site: the closure cached is still the callee as long as the slot of the
+ * name holds it, a rebinding or an assignment of the name is a miss
+ * @param interpreter a pointer to the interpreter
+ * @param call a pointer to the call
+ * @param body where the body of the closure is stored, parsed and resolved
+ * @return the closure
+ */
+value_t interpreter_callee(interpreter_t *, exp_call_t *, stmt_t **);
+
+/**
+ * Call a closure with already evaluated actuals, bypassing the JIT
+ * @param interpreter a pointer to the interpreter
+ * @param closure a pointer to the closure to call
+ * @param values the actuals, in the order of the closure formals
+ * @param count the number of actuals
+ * @return the value returned
+ */
+value_t interpreter_call(interpreter_t *, closure_t *, value_t *, uint32_t);
+
+/**
+ * Apply a unary operator to an already evaluated operand
+ * @param interpreter a pointer to the interpreter
+ * @param op the operator
+ * @param right the operand
+ * @return the value obtained
+ */
+value_t interpreter_unary(interpreter_t *, operator_t, value_t);
+
+/**
+ * Apply a binary operator (but the forwarding) to already evaluated operands
+ * @param interpreter a pointer to the interpreter
+ * @param op the operator
+ * @param left the left side value
+ * @param right the right side value, ignored if a AND/OR short circuit
+ * happened
+ * @return the value obtained
+ * @note The operands type checks are performed here
+ */
+value_t interpreter_binary(interpreter_t *, operator_t, value_t, value_t);
+
+/**
+ * Apply the operator of a unary expression to its already evaluated operand
+ * through the variant specialized on the type its site has seen
+ * @param interpreter a pointer to the interpreter
+ * @param unary a pointer to the unary expression, its site is specialized by
+ * its first evaluation
+ * @param right the operand
+ * @return the value obtained
+ */
+value_t interpreter_unary_site(interpreter_t *, exp_unary_t *, value_t);
+
+/**
+ * Apply the operator of a binary expression (but the forwarding) to its
+ * already evaluated operands through the variant specialized on the types its
+ * site has seen
+ * @param interpreter a pointer to the interpreter
+ * @param binary a pointer to the binary expression, its site is specialized
+ * by its first evaluation
+ * @param left the left side value
+ * @param right the right side value, ignored if a AND/OR short circuit
+ * happened
+ * @return the value obtained
+ */
+value_t interpreter_binary_site(interpreter_t *, exp_binary_t *, value_t,
+                                value_t);
+
+/**
+ * Check if the given value is truthy
+ * @param interpreter a pointer to the interpreter
+ * @param v the value
+ * @return 1 if the value is true, 0 otherwise
+ */
+int interpreter_is_truthy(interpreter_t *, value_t);
+
+/**
+ * Pretty print a value
+ * @param v the value to be printed
+ */
+void interpreter_print(value_t);
+
+/**
+ * Stop the execution and show a formatted error message
+ * @param interpreter a pointer to the interpreter
+ * @param msg the message to be printed
+ */
+__attribute__((noreturn)) __attribute__((format(printf, 2, 3))) void
+interpreter_error(interpreter_t *, char *, ...);
+
+/**
+ * Check whether the C stack can hold another call
+ * @param interpreter a pointer to the interpreter
+ * @return 1 if the C stack grew past the limit of the interpreter, 0
+ * otherwise
+ */
+static inline int interpreter_stack_exhausted(interpreter_t *interpreter) {
+  return (const char *)__builtin_frame_address(0) < interpreter->stack_limit;
+}
+
+/**
+ * Enter the body of a closure whose formals are bound, raising a stack
+ * overflow past the maximum depth or when the C stack is about to run out
+ * @param interpreter a pointer to the interpreter
+ * @note The engines recursing on the C stack share the calls protocol: a
+ * return sets returning and the statements unwind up to the call, a call in
+ * tail position binds its formals, sets tail_call and unwinds as well
+ */
+static inline void interpreter_enter(interpreter_t *interpreter) {
+  if ((interpreter->max_depth &&
+       interpreter->depth >= interpreter->max_depth) ||
+      interpreter_stack_exhausted(interpreter))
+    interpreter_error(interpreter, "Stack overflow\n");
+  interpreter->depth++;
+  return;
+}
+
+/**
+ * Take the pending tail call in place of the call being run, the bindings it
+ * shadows are squashed so that a loop of tail calls keeps the environment size
+ * @param interpreter a pointer to the interpreter
+ * @param old_size the size of the environment before the call being run
+ * @return a pointer to the closure called in tail position
+ * @note The closure is held, it is released once its body has run
+ */
+static inline closure_t *interpreter_tail(interpreter_t *interpreter,
+                                          int old_size) {
+  value_t callee = interpreter->tail_call;
+  gc_hold(interpreter->garbage_collector, callee);
+  interpreter->tail_call = VALUE_NIL;
+  interpreter->returning = 0;
+  env_squash(interpreter->environment, old_size);
+  return value_as_closure(callee);
+}
+
+/**
+ * Leave the body of a closure once a return unwound up to its call
+ * @param interpreter a pointer to the interpreter
+ * @param old_size the size of the environment before the call
+ */
+static inline void interpreter_leave(interpreter_t *interpreter,
+                                     int old_size) {
+  interpreter->returning = 0;
+  interpreter->depth--;
+  env_restore(interpreter->environment, old_size);
+  return;
+}
+
 #endif // !INTERPRETER_H
@@ -0,0 +1,1101 @@
+#include "jit.h"
+#include "environment.h"
+#include "garbage.h"
+#include "interpreter.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define JIT_CHUNK_SIZE (64 * 1024)
+#define JIT_STACK_SIZE ((size_t)64 * 1024 * 1024)
+// The static type of a value that can be anything
+#define JIT_ANY 0xff
+
+// The registers used by the templates, the native code keeps the JIT in r12,
+// the arguments in rbx and the top of its values in r13
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define XMM0 0
+#define XMM1 1
+
+// The condition codes of jcc and setcc
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_A 0x7
+#define CC_P 0xa
+#define CC_NP 0xb
+#define CC_ALWAYS 0xff
+
+// The errors raised by the native code itself
+#define FAIL_BOOLEANS 0
+#define FAIL_CASTING 1
+
+/**
+ * A function being compiled
+ * @param code the native code
+ * @param returns the jumps to the epilogue
+ * @param guards the jumps taken when an argument has not the expected type
+ * @param formals the formals symbols, in the order of the source
+ * @param types the type of every formal checked on entry, JIT_ANY if none
+ * @param arity the number of formals
+ * @param depth the number of values pushed at this point
+ * @param max_depth the maximum depth reached
+ * @param sites the calls made by the function
+ */
+typedef struct {
+  uint8_t *code;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *returns;
+  uint32_t returns_count;
+  uint32_t returns_capacity;
+  uint32_t *guards;
+  uint32_t guards_count;
+  uint32_t guards_capacity;
+  uint32_t *formals;
+  uint8_t *types;
+  uint32_t arity;
+  uint32_t depth;
+  uint32_t max_depth;
+  l_list_t sites;
+} emitter_t;
+
+/**
+ * A region of executable memory
+ * @param memory the start of the region
+ * @param size the size of the region
+ */
+typedef struct {
+  uint8_t *memory;
+  size_t size;
+} chunk_t;
+
+/**
+ * Convert a value of the interpreter to a native one
+ * @param v the value
+ * @return the native value
+ */
+static jit_value_t to_native(value_t);
+/**
+ * Convert a native value to a value of the interpreter
+ * @param jit a pointer to the JIT
+ * @param v the native value
+ * @return the value
+ */
+static value_t to_value(jit_t *, jit_value_t);
+/**
+ * Run the native code of a closure, compiling it if it just became hot
+ * @param jit a pointer to the JIT
+ * @param closure a pointer to the called closure
+ * @param base a pointer to the arguments, in formals order
+ * @param count the number of arguments
+ * @return 0 if the result has been written in base[0], 1 if the call must be
+ * interpreted
+ */
+static int enter(jit_t *, closure_t *, jit_value_t *, uint32_t);
+/**
+ * Interpret a call made by native code, the formals of the native frames are
+ * bound in the environment for its duration and read back afterwards
+ * @param jit a pointer to the JIT
+ * @param closure a pointer to the called closure
+ * @param base a pointer to the arguments, in formals order
+ * @param count the number of arguments
+ * @note The result is written in base[0]
+ */
+static void interpret(jit_t *, closure_t *, jit_value_t *, uint32_t);
+/**
+ * Find the closure called by a call site, the formals of the native frames
+ * shadow the environment
+ * @param jit a pointer to the JIT
+ * @param site a pointer to the call site
+ * @return a pointer to the closure
+ */
+static closure_t *resolve(jit_t *, jit_site_t *);
+/**
+ * Called by native code to make a call
+ * @param jit a pointer to the JIT
+ * @param top a pointer to the first free value, the arguments are below
+ * @param count the number of arguments
+ * @param site a pointer to the call site
+ */
+static void native_call(jit_t *, jit_value_t *, uint64_t, uint64_t);
+/**
+ * Called by native code to apply a binary operator to operands that are not
+ * both numbers (or to compute a remainder)
+ * @param jit a pointer to the JIT
+ * @param top a pointer to the first free value, the operands are below
+ * @param op the operator
+ */
+static void native_binary(jit_t *, jit_value_t *, uint64_t, uint64_t);
+/**
+ * Called by native code to apply a unary operator to an operand of an
+ * unexpected type
+ * @param jit a pointer to the JIT
+ * @param top a pointer to the first free value, the operand is below
+ * @param op the operator
+ */
+static void native_unary(jit_t *, jit_value_t *, uint64_t, uint64_t);
+/**
+ * Called by native code to raise a type error
+ * @param jit a pointer to the JIT
+ * @param top a pointer to the first free value
+ * @param message the error (FAIL_BOOLEANS or FAIL_CASTING)
+ */
+__attribute__((noreturn)) static void native_fail(jit_t *, jit_value_t *,
+                                                  uint64_t, uint64_t);
+/**
+ * Compile the body of a closure, specialized on the types of the given
+ * arguments
+ * @param jit a pointer to the JIT
+ * @param closure a pointer to the closure
+ * @param args a pointer to the arguments of the call making it hot
+ * @param count the number of arguments
+ * @return a pointer to the compiled function, whose code is NULL if the body
+ * cannot be compiled
+ */
+static jit_function_t *compile(jit_t *, closure_t *, jit_value_t *, uint32_t);
+/**
+ * Copy the code of a compiled function into executable memory
+ * @param jit a pointer to the JIT
+ * @param e a pointer to the emitter holding the code
+ * @return a pointer to the native code, NULL if no memory can be mapped
+ */
+static uint8_t *install(jit_t *, emitter_t *);
+/**
+ * Compile a statement
+ * @param e a pointer to the emitter
+ * @param s a pointer to the statement
+ * @param value 1 if the value of the statement must be pushed
+ * @return 1 on success, 0 if the statement cannot be compiled
+ */
+static int compile_stmt(emitter_t *, stmt_t *, int);
+/**
+ * Compile an expression, pushing its value
+ * @param e a pointer to the emitter
+ * @param exp a pointer to the expression
+ * @param type a pointer to the static type of the value (JIT_ANY if unknown)
+ * @return 1 on success, 0 if the expression cannot be compiled
+ */
+static int compile_exp(emitter_t *, exp_t *, uint8_t *);
+/**
+ * Compile a call, pushing its result
+ * @param e a pointer to the emitter
+ * @param call a pointer to the call
+ * @param forwarded 1 if the first argument has already been pushed
+ * @return 1 on success, 0 if the call cannot be compiled
+ */
+static int compile_call(emitter_t *, exp_call_t *, int);
+/**
+ * Compile a binary operator (but AND, OR and the forwarding) applied to the
+ * two values on top
+ * @param e a pointer to the emitter
+ * @param op the operator
+ * @param left the static type of the left operand
+ * @param right the static type of the right operand
+ * @return the static type of the result
+ */
+static uint8_t compile_operator(emitter_t *, operator_t, uint8_t, uint8_t);
+/**
+ * Raise the given error unless the value on top is a boolean
+ * @param e a pointer to the emitter
+ * @param message the error (FAIL_BOOLEANS or FAIL_CASTING)
+ */
+static void compile_boolean_check(emitter_t *, uint64_t);
+
+static void emit_byte(emitter_t *, uint8_t);
+static void emit_u32(emitter_t *, uint32_t);
+static void emit_u64(emitter_t *, uint64_t);
+/**
+ * Emit the REX prefix, if any is needed
+ * @param e a pointer to the emitter
+ * @param w 1 for a 64 bit operand
+ * @param reg the register in the reg field
+ * @param base the register in the r/m field
+ */
+static void emit_rex(emitter_t *, int, int, int);
+/**
+ * Emit an instruction with a [base + disp] operand
+ * @param e a pointer to the emitter
+ * @param prefix the mandatory prefix (0 if none)
+ * @param w 1 for a 64 bit operand
+ * @param opcode the opcode, a two bytes one is escaped by 0x0f
+ * @param reg the register (or the opcode extension) in the reg field
+ * @param base the base register
+ * @param disp the displacement
+ */
+static void emit_mem(emitter_t *, uint8_t, int, uint16_t, int, int, int32_t);
+static void emit_mov_imm(emitter_t *, int, uint64_t);
+static void emit_mov_reg(emitter_t *, int, int);
+static void emit_add_imm(emitter_t *, int, int32_t);
+/**
+ * Emit the comparison of the type of a value with the given one
+ * @param e a pointer to the emitter
+ * @param base the register pointing near the value
+ * @param disp the offset of the value from the register
+ * @param type the expected type
+ */
+static void emit_cmp_type(emitter_t *, int, int32_t, uint8_t);
+/**
+ * Emit a call to a helper taking the JIT, the top of the values and two
+ * operands
+ * @param e a pointer to the emitter
+ * @param helper the address of the helper
+ * @param a the first operand
+ * @param b the second operand
+ */
+static void emit_helper(emitter_t *, uintptr_t, uint64_t, uint64_t);
+/**
+ * Emit a jump whose target is patched later
+ * @param e a pointer to the emitter
+ * @param cc the condition, CC_ALWAYS for an unconditional jump
+ * @return the offset of the displacement to patch
+ */
+static uint32_t emit_jump(emitter_t *, uint8_t);
+/**
+ * Make a jump land on the next emitted instruction
+ * @param e a pointer to the emitter
+ * @param at the offset of the displacement
+ */
+static void patch_jump(emitter_t *, uint32_t);
+/**
+ * Account for the values pushed (or popped if negative) by the code emitted
+ * @param e a pointer to the emitter
+ * @param n the number of values
+ */
+static void push(emitter_t *, int);
+static void emit_push_constant(emitter_t *, uint8_t, uint64_t);
+static void emit_pop(emitter_t *);
+/**
+ * Emit the return to the caller of the native code
+ * @param e a pointer to the emitter
+ * @param status the value returned (0 on success, 1 for a deoptimization)
+ */
+static void emit_epilogue(emitter_t *, uint32_t);
+
+int jit_init(jit_t *jit, interpreter_t *interpreter, uint32_t threshold) {
+  memset(jit, 0, sizeof(jit_t));
+#if defined(__x86_64__) && defined(__linux__)
+  void *stack = mmap(NULL, JIT_STACK_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (stack == MAP_FAILED)
+    return 0;
+  jit->interpreter = interpreter;
+  jit->threshold = threshold;
+  jit->stack = stack;
+  jit->top = stack;
+  jit->limit = jit->stack + JIT_STACK_SIZE / sizeof(jit_value_t);
+  interpreter->jit = jit;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+int jit_call(jit_t *jit, closure_t *closure, value_t *values, uint32_t count,
+             value_t *result) {
+  jit_function_t *f = closure->jit;
+  if (f == NULL ? closure->calls + 1 < jit->threshold : f->code == NULL) {
+    closure->calls++;
+    return 0;
+  }
+  jit_value_t *base = jit->top;
+  if (base + count > jit->limit)
+    interpreter_error(jit->interpreter, "Stack overflow\n");
+  // The values are in the order of the formals list, the last formal first
+  for (uint32_t k = 0; k < count; k++)
+    base[count - 1 - k] = to_native(values[k]);
+  // The frames of the callers are all bound in the environment
+  uint32_t segment = jit->segment;
+  jit->segment = jit->frames_count;
+  int interpreted = enter(jit, closure, base, count);
+  jit->segment = segment;
+  if (interpreted)
+    return 0;
+  *result = to_value(jit, base[0]);
+  return 1;
+}
+
+void jit_destroy(jit_t *jit) {
+  while (jit->functions) {
+    l_list_t current = jit->functions;
+    jit_function_t *f = current->data;
+    while (f->sites) {
+      l_list_t site = f->sites;
+      mem_free(((jit_site_t *)site->data)->identifier);
+      mem_free(site->data);
+      f->sites = site->next;
+      mem_free(site);
+    }
+    mem_free(f);
+    jit->functions = current->next;
+    mem_free(current);
+  }
+  while (jit->chunks) {
+    l_list_t current = jit->chunks;
+    chunk_t *chunk = current->data;
+    munmap(chunk->memory, chunk->size);
+    mem_free(chunk);
+    jit->chunks = current->next;
+    mem_free(current);
+  }
+  if (jit->stack)
+    munmap(jit->stack, JIT_STACK_SIZE);
+  if (jit->perf_map)
+    fclose(jit->perf_map);
+  mem_free(jit->frames);
+  mem_free(jit->names);
+  if (jit->interpreter)
+    jit->interpreter->jit = NULL;
+  memset(jit, 0, sizeof(jit_t));
+  return;
+}
+
+jit_value_t to_native(value_t v) {
+  jit_value_t res;
+  res.type = value_type(v);
+  switch (res.type) {
+  case T_NUMBER:
+    res.as.number = value_as_number(v);
+    break;
+  case T_BOOLEAN:
+    res.as.boolean = value_as_boolean(v);
+    break;
+  default:
+    res.as.boxed = v;
+    break;
+  }
+  return res;
+}
+
+value_t to_value(jit_t *jit, jit_value_t v) {
+  switch (v.type) {
+  case T_NUMBER:
+    return value_number(v.as.number);
+  case T_BOOLEAN:
+    return value_boolean((int)v.as.boolean);
+  case T_NIL:
+    return VALUE_NIL;
+  default:
+    return v.as.boxed;
+  }
+}
+
+int enter(jit_t *jit, closure_t *closure, jit_value_t *base, uint32_t count) {
+  if (closure->jit == NULL && ++closure->calls >= jit->threshold)
+    closure->jit = compile(jit, closure, base, count);
+  jit_function_t *f = closure->jit;
+  if (f == NULL || f->code == NULL || f->arity != count)
+    return 1;
+  // The native frames nest in the interpreted calls, on the same C stack
+  interpreter_t *i = jit->interpreter;
+  if ((i->max_depth && i->depth + jit->frames_count >= i->max_depth) ||
+      interpreter_stack_exhausted(i) || base + f->slots > jit->limit)
+    interpreter_error(i, "Stack overflow\n");
+  jit->frames = mem_reserve(jit->frames, &jit->frames_capacity,
+                            jit->frames_count + 1, sizeof(jit_frame_t));
+  jit->frames[jit->frames_count].closure = closure;
+  jit->frames[jit->frames_count].base = base;
+  jit->frames_count++;
+  jit->native_calls++;
+  int deopt = f->code(jit, base);
+  jit->frames_count--;
+  if (!deopt)
+    return 0;
+  // A guard failed, after too many failures the code is dropped for good
+  f->deopts++;
+  jit->deopts++;
+  if (f->deopts >= JIT_MAX_DEOPTS)
+    f->code = NULL;
+  return 1;
+}
+
+void interpret(jit_t *jit, closure_t *closure, jit_value_t *base,
+               uint32_t count) {
+  interpreter_t *i = jit->interpreter;
+  env_t *env = i->environment;
+  int old_size = env->size;
+  // The formals are bound as the tree walker would have, oldest frame first
+  uint32_t segment = jit->segment;
+  for (uint32_t f = segment; f < jit->frames_count; f++) {
+    jit_frame_t *frame = &jit->frames[f];
+    uint32_t arity = ((jit_function_t *)frame->closure->jit)->arity;
+    for (uint32_t k = 0; k < arity; k++)
+      env_bind(env, frame->closure->symbols[k],
+               to_value(jit, frame->base[arity - 1 - k]));
+  }
+  jit_value_t *top = jit->top;
+  jit->segment = jit->frames_count;
+  jit->top = base + count;
+  // The frame of the callee is pushed on the values held by the GC
+  garbage_collector_t *gc = i->garbage_collector;
+  for (uint32_t k = count; k-- > 0;)
+    gc_hold(gc, to_value(jit, base[k]));
+  value_t res = interpreter_call(
+      i, closure, gc->temporaries + gc->temporaries_count - count, count);
+  gc_release(gc, count);
+  base[0] = to_native(res);
+  // The callee may have assigned the formals, the last bound comes first and
+  // unbinding it uncovers the value of a shadowed one
+  for (uint32_t f = jit->frames_count; f-- > segment;) {
+    jit_frame_t *frame = &jit->frames[f];
+    uint32_t arity = ((jit_function_t *)frame->closure->jit)->arity;
+    for (uint32_t k = 0; k < arity; k++) {
+      frame->base[k] =
+          to_native(env->values[env->trail[env->size - 1].symbol]);
+      env_unbind(env);
+    }
+  }
+  env_restore(env, old_size);
+  jit->top = top;
+  jit->segment = segment;
+  return;
+}
+
+closure_t *resolve(jit_t *jit, jit_site_t *site) {
+  interpreter_t *i = jit->interpreter;
+  value_t v;
+  int found_value = 0;
+  // A function name can be shadowed by a formal of a caller, the frames are
+  // searched only if a compiled function has such a formal
+  for (; site->names < jit->names_count; site->names++)
+    if (jit->names[site->names] == site->symbol)
+      site->shadowed = 1;
+  for (uint32_t f = jit->frames_count; site->shadowed && f-- > jit->segment;) {
+    jit_frame_t *frame = &jit->frames[f];
+    uint32_t arity = ((jit_function_t *)frame->closure->jit)->arity;
+    int found = -1;
+    for (uint32_t k = 0; k < arity; k++)
+      if (frame->closure->symbols[k] == site->symbol)
+        found = arity - 1 - k;
+    if (found >= 0) {
+      v = to_value(jit, frame->base[found]);
+      found_value = 1;
+      break;
+    }
+  }
+  if (!found_value && !env_get(i->environment, site->symbol, &v))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      site->identifier);
+  if (value_type(v) != T_CLOSURE)
+    interpreter_error(i, "The identifier '%s' is not a function name\n",
+                      site->identifier);
+  return value_as_closure(v);
+}
+
+void native_call(jit_t *jit, jit_value_t *top, uint64_t count,
+                 uint64_t address) {
+  jit_site_t *site = (jit_site_t *)(uintptr_t)address;
+  closure_t *closure = resolve(jit, site);
+  jit_value_t *base = top - count;
+  // The actuals were pushed from the last one, after the forwarded value
+  for (uint32_t l = site->forwarded, r = count; l + 1 < r; l++) {
+    r--;
+    jit_value_t tmp = base[l];
+    base[l] = base[r];
+    base[r] = tmp;
+  }
+  if (enter(jit, closure, base, count))
+    interpret(jit, closure, base, count);
+  return;
+}
+
+void native_binary(jit_t *jit, jit_value_t *top, uint64_t op,
+                   uint64_t unused) {
+  value_t left = to_value(jit, top[-2]);
+  value_t right = to_value(jit, top[-1]);
+  top[-2] = to_native(interpreter_binary(jit->interpreter, op, left, right));
+  return;
+}
+
+void native_unary(jit_t *jit, jit_value_t *top, uint64_t op,
+                  uint64_t unused) {
+  value_t right = to_value(jit, top[-1]);
+  top[-1] = to_native(interpreter_unary(jit->interpreter, op, right));
+  return;
+}
+
+void native_fail(jit_t *jit, jit_value_t *top, uint64_t message,
+                 uint64_t unused) {
+  if (message == FAIL_BOOLEANS)
+    interpreter_error(jit->interpreter,
+                      "Type Error:\t Operands must be booleans\n");
+  interpreter_error(jit->interpreter,
+                    "Type Error:\tImplicit casting is not permitted!\n");
+}
+
+jit_function_t *compile(jit_t *jit, closure_t *closure, jit_value_t *args,
+                        uint32_t count) {
+  jit_function_t *f = mem_calloc(1, sizeof(jit_function_t));
+  list_add(&jit->functions, f);
+  stmt_t *body =
+      closure->body ? interpreter_body(jit->interpreter, closure) : NULL;
+  emitter_t e;
+  memset(&e, 0, sizeof(emitter_t));
+  e.arity = closure->arity;
+  if (body == NULL || e.arity != count) {
+    jit->rejected++;
+    return f;
+  }
+  e.formals = mem_calloc(e.arity + 1, sizeof(uint32_t));
+  e.types = mem_calloc(e.arity + 1, sizeof(uint8_t));
+  uint32_t k;
+  for (k = 0; k < e.arity; k++)
+    e.formals[e.arity - 1 - k] = closure->symbols[k];
+  // push rbx; push r12; push r13
+  emit_byte(&e, 0x53);
+  emit_byte(&e, 0x41);
+  emit_byte(&e, 0x54);
+  emit_byte(&e, 0x41);
+  emit_byte(&e, 0x55);
+  emit_mov_reg(&e, R12, RDI);
+  emit_mov_reg(&e, RBX, RSI);
+  emit_mem(&e, 0, 1, 0x8d, R13, RBX, e.arity * sizeof(jit_value_t));
+  // The numbers and booleans seen are checked on entry, the operations on
+  // them need no further check
+  for (k = 0; k < e.arity; k++) {
+    e.types[k] = JIT_ANY;
+    if (args[k].type != T_NUMBER && args[k].type != T_BOOLEAN)
+      continue;
+    e.types[k] = args[k].type;
+    emit_cmp_type(&e, RBX, k * sizeof(jit_value_t), e.types[k]);
+    e.guards = mem_reserve(e.guards, &e.guards_capacity, e.guards_count + 1,
+                           sizeof(uint32_t));
+    e.guards[e.guards_count++] = emit_jump(&e, CC_NE);
+  }
+  int ok = compile_stmt(&e, body, 1);
+  if (ok) {
+    // movups xmm0, [r13 - 16]; movups [rbx], xmm0
+    emit_mem(&e, 0, 0, 0x0f10, XMM0, R13, -16);
+    emit_mem(&e, 0, 0, 0x0f11, XMM0, RBX, 0);
+    for (k = 0; k < e.returns_count; k++)
+      patch_jump(&e, e.returns[k]);
+    emit_epilogue(&e, 0);
+    for (k = 0; k < e.guards_count; k++)
+      patch_jump(&e, e.guards[k]);
+    emit_epilogue(&e, 1);
+  }
+  uint8_t *code = ok ? install(jit, &e) : NULL;
+  if (code) {
+    f->code = (jit_code_t)(uintptr_t)code;
+    f->size = e.count;
+    f->arity = e.arity;
+    f->slots = e.arity + e.max_depth + 1;
+    f->sites = e.sites;
+    jit->compiled++;
+    jit->code_size += e.count;
+    for (k = 0; k < e.arity; k++) {
+      uint32_t n = 0;
+      while (n < jit->names_count && jit->names[n] != e.formals[k])
+        n++;
+      if (n < jit->names_count)
+        continue;
+      jit->names = mem_reserve(jit->names, &jit->names_capacity,
+                               jit->names_count + 1, sizeof(uint32_t));
+      jit->names[jit->names_count++] = e.formals[k];
+    }
+    // perf symbolizes the native code with the map of the process
+    if (jit->perf_map == NULL) {
+      char path[64];
+      snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+      jit->perf_map = fopen(path, "w");
+    }
+    if (jit->perf_map) {
+      fprintf(jit->perf_map, "%lx %x lotus::%s\n", (unsigned long)code,
+              e.count, closure->identifier);
+      fflush(jit->perf_map);
+    }
+  } else {
+    while (e.sites) {
+      l_list_t site = e.sites;
+      mem_free(((jit_site_t *)site->data)->identifier);
+      mem_free(site->data);
+      e.sites = site->next;
+      mem_free(site);
+    }
+    jit->rejected++;
+  }
+  mem_free(e.code);
+  mem_free(e.returns);
+  mem_free(e.guards);
+  mem_free(e.formals);
+  mem_free(e.types);
+  return f;
+}
+
+uint8_t *install(jit_t *jit, emitter_t *e) {
+  size_t size = (e->count + 15) & ~(size_t)15;
+  if (jit->chunk == NULL || jit->chunk_used + size > jit->chunk_size) {
+    long page = sysconf(_SC_PAGESIZE);
+    size_t chunk_size = JIT_CHUNK_SIZE;
+    if (size > chunk_size)
+      chunk_size = (size + page - 1) & ~(size_t)(page - 1);
+    void *memory = mmap(NULL, chunk_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+      return NULL;
+    chunk_t *chunk = mem_calloc(1, sizeof(chunk_t));
+    chunk->memory = memory;
+    chunk->size = chunk_size;
+    list_add(&jit->chunks, chunk);
+    jit->chunk = memory;
+    jit->chunk_used = 0;
+    jit->chunk_size = chunk_size;
+  } else if (mprotect(jit->chunk, jit->chunk_size, PROT_READ | PROT_WRITE)) {
+    return NULL;
+  }
+  // The memory is never writable and executable at the same time
+  uint8_t *code = jit->chunk + jit->chunk_used;
+  memcpy(code, e->code, e->count);
+  jit->chunk_used += size;
+  if (mprotect(jit->chunk, jit->chunk_size, PROT_READ | PROT_EXEC))
+    return NULL;
+  return code;
+}
+
+int compile_stmt(emitter_t *e, stmt_t *s, int value) {
+  switch (s->type) {
+  case STMT_EXPR: {
+    uint8_t type;
+    if (!compile_exp(e, ((stmt_expr_t *)stmt_unwrap(s))->exp, &type))
+      return 0;
+    if (!value)
+      emit_pop(e);
+    return 1;
+  }
+  case STMT_RETURN: {
+    uint8_t type;
+    if (!compile_exp(e, ((stmt_expr_t *)stmt_unwrap(s))->exp, &type))
+      return 0;
+    // movups xmm0, [r13 - 16]; movups [rbx], xmm0
+    emit_mem(e, 0, 0, 0x0f10, XMM0, R13, -16);
+    emit_mem(e, 0, 0, 0x0f11, XMM0, RBX, 0);
+    e->returns = mem_reserve(e->returns, &e->returns_capacity,
+                             e->returns_count + 1, sizeof(uint32_t));
+    e->returns[e->returns_count++] = emit_jump(e, CC_ALWAYS);
+    // The code following is unreachable, the value is counted as pushed
+    if (!value)
+      push(e, -1);
+    return 1;
+  }
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    uint8_t type;
+    if (!compile_exp(e, conditional->condition, &type))
+      return 0;
+    if (type != T_BOOLEAN)
+      compile_boolean_check(e, FAIL_CASTING);
+    emit_pop(e);
+    // cmp qword [r13 + 8], 0
+    emit_mem(e, 0, 1, 0x83, 7, R13, 8);
+    emit_byte(e, 0);
+    uint32_t otherwise = emit_jump(e, CC_E);
+    if (!compile_stmt(e, conditional->then_branch, value))
+      return 0;
+    uint32_t end = emit_jump(e, CC_ALWAYS);
+    patch_jump(e, otherwise);
+    push(e, -value);
+    if (conditional->else_branch) {
+      if (!compile_stmt(e, conditional->else_branch, value))
+        return 0;
+    } else if (value) {
+      emit_push_constant(e, T_NIL, 0);
+    }
+    patch_jump(e, end);
+    return 1;
+  }
+  case STMT_BLOCK: {
+    l_list_t statements = ((stmt_block_t *)stmt_unwrap(s))->statements;
+    if (statements == NULL && value)
+      emit_push_constant(e, T_NIL, 0);
+    for (; statements; statements = statements->next)
+      if (!compile_stmt(e, statements->data, value && !statements->next))
+        return 0;
+    return 1;
+  }
+  default:
+    // The bindings, the prints and the nested functions stay interpreted
+    return 0;
+  }
+}
+
+int compile_exp(emitter_t *e, exp_t *exp, uint8_t *type) {
+  switch (exp->type) {
+  case EXP_LITERAL: {
+    exp_literal_t *literal = exp_unwrap(exp);
+    uint64_t payload = 0;
+    if (literal->type == T_NUMBER)
+      memcpy(&payload, &literal->value.number, sizeof(double));
+    else if (literal->type == T_BOOLEAN)
+      payload = literal->value.boolean;
+    else if (literal->type != T_NIL)
+      return 0;
+    emit_push_constant(e, literal->type, payload);
+    *type = literal->type;
+    return 1;
+  }
+  case EXP_GROUPING:
+    return compile_exp(e, ((exp_grouping_t *)exp_unwrap(exp))->exp, type);
+  case EXP_IDENTIFIER: {
+    uint32_t symbol = ((exp_identifier_t *)exp_unwrap(exp))->symbol;
+    for (uint32_t k = 0; k < e->arity; k++) {
+      if (e->formals[k] != symbol)
+        continue;
+      // movups xmm0, [rbx + 16k]; movups [r13], xmm0
+      emit_mem(e, 0, 0, 0x0f10, XMM0, RBX, k * sizeof(jit_value_t));
+      emit_mem(e, 0, 0, 0x0f11, XMM0, R13, 0);
+      emit_add_imm(e, R13, sizeof(jit_value_t));
+      push(e, 1);
+      *type = e->types[k];
+      return 1;
+    }
+    // Any other identifier is dynamically scoped
+    return 0;
+  }
+  case EXP_UNARY: {
+    exp_unary_t *unary = exp_unwrap(exp);
+    uint8_t right;
+    if (!compile_exp(e, unary->right, &right))
+      return 0;
+    *type = unary->op == OP_MINUS ? T_NUMBER : T_BOOLEAN;
+    uint32_t slow = 0;
+    if (right != *type) {
+      emit_cmp_type(e, R13, -16, *type);
+      slow = emit_jump(e, CC_NE);
+    }
+    if (unary->op == OP_MINUS) {
+      // mov rax, [r13 - 8]; btc rax, 63; mov [r13 - 8], rax
+      emit_mem(e, 0, 1, 0x8b, RAX, R13, -8);
+      emit_byte(e, 0x48);
+      emit_byte(e, 0x0f);
+      emit_byte(e, 0xba);
+      emit_byte(e, 0xf8);
+      emit_byte(e, 63);
+      emit_mem(e, 0, 1, 0x89, RAX, R13, -8);
+    } else {
+      // xor qword [r13 - 8], 1
+      emit_mem(e, 0, 1, 0x83, 6, R13, -8);
+      emit_byte(e, 1);
+    }
+    if (right != *type) {
+      uint32_t done = emit_jump(e, CC_ALWAYS);
+      patch_jump(e, slow);
+      emit_helper(e, (uintptr_t)native_unary, unary->op, 0);
+      patch_jump(e, done);
+    }
+    return 1;
+  }
+  case EXP_BINARY: {
+    exp_binary_t *binary = exp_unwrap(exp);
+    uint8_t left, right;
+    if (binary->op == OP_FORWARD) {
+      if (binary->right->type != EXP_CALL)
+        return 0;
+      *type = JIT_ANY;
+      return compile_exp(e, binary->left, &left) &&
+             compile_call(e, exp_unwrap(binary->right), 1);
+    }
+    if (!compile_exp(e, binary->left, &left))
+      return 0;
+    if (binary->op == OP_AND || binary->op == OP_OR) {
+      if (left != T_BOOLEAN)
+        compile_boolean_check(e, FAIL_BOOLEANS);
+      // cmp qword [r13 - 8], 0
+      emit_mem(e, 0, 1, 0x83, 7, R13, -8);
+      emit_byte(e, 0);
+      uint32_t end = emit_jump(e, binary->op == OP_AND ? CC_E : CC_NE);
+      emit_pop(e);
+      if (!compile_exp(e, binary->right, &right))
+        return 0;
+      if (right != T_BOOLEAN)
+        compile_boolean_check(e, FAIL_BOOLEANS);
+      patch_jump(e, end);
+      *type = T_BOOLEAN;
+      return 1;
+    }
+    if (!compile_exp(e, binary->right, &right))
+      return 0;
+    *type = compile_operator(e, binary->op, left, right);
+    return 1;
+  }
+  case EXP_CALL:
+    *type = JIT_ANY;
+    return compile_call(e, exp_unwrap(exp), 0);
+  default:
+    return 0;
+  }
+}
+
+int compile_call(emitter_t *e, exp_call_t *call, int forwarded) {
+  // A call in tail position replaces the frame of its caller, only the
+  // interpreter can do that
+  if (call->tail)
+    return 0;
+  // A call through a formal would need the callee of every call
+  for (uint32_t k = 0; k < e->arity; k++)
+    if (e->formals[k] == call->symbol)
+      return 0;
+  int count = forwarded;
+  for (l_list_t actual = call->actuals; actual; actual = actual->next) {
+    uint8_t type;
+    if (!compile_exp(e, actual->data, &type))
+      return 0;
+    count++;
+  }
+  jit_site_t *site = mem_calloc(1, sizeof(jit_site_t));
+  site->identifier = strdup(call->identifier);
+  site->symbol = call->symbol;
+  site->forwarded = forwarded;
+  list_add(&e->sites, site);
+  emit_helper(e, (uintptr_t)native_call, count, (uintptr_t)site);
+  // The result replaces the arguments: lea r13, [r13 + 16 * (1 - count)]
+  emit_mem(e, 0, 1, 0x8d, R13, R13, (1 - count) * (int)sizeof(jit_value_t));
+  push(e, 1 - count);
+  return 1;
+}
+
+uint8_t compile_operator(emitter_t *e, operator_t op, uint8_t left,
+                         uint8_t right) {
+  uint32_t slow[2];
+  int checks = 0;
+  if (op != OP_MOD) {
+    if (left != T_NUMBER) {
+      emit_cmp_type(e, R13, -32, T_NUMBER);
+      slow[checks++] = emit_jump(e, CC_NE);
+    }
+    if (right != T_NUMBER) {
+      emit_cmp_type(e, R13, -16, T_NUMBER);
+      slow[checks++] = emit_jump(e, CC_NE);
+    }
+    // movsd xmm0, [r13 - 24]
+    emit_mem(e, 0xf2, 0, 0x0f10, XMM0, R13, -24);
+    switch (op) {
+    case OP_PLUS:
+    case OP_MINUS:
+    case OP_STAR:
+    case OP_SLASH: {
+      // addsd/subsd/mulsd/divsd xmm0, [r13 - 8]; movsd [r13 - 24], xmm0
+      uint16_t opcode = op == OP_PLUS    ? 0x0f58
+                        : op == OP_MINUS ? 0x0f5c
+                        : op == OP_STAR  ? 0x0f59
+                                         : 0x0f5e;
+      emit_mem(e, 0xf2, 0, opcode, XMM0, R13, -8);
+      emit_mem(e, 0xf2, 0, 0x0f11, XMM0, R13, -24);
+      break;
+    }
+    default: {
+      // movsd xmm1, [r13 - 8]; ucomisd with the operands in the order
+      // giving the right result when one of them is a NaN
+      emit_mem(e, 0xf2, 0, 0x0f10, XMM1, R13, -8);
+      int swap = op == OP_LESS || op == OP_LESS_EQUAL;
+      emit_byte(e, 0x66);
+      emit_byte(e, 0x0f);
+      emit_byte(e, 0x2e);
+      emit_byte(e, swap ? 0xc8 : 0xc1);
+      uint8_t cc = op == OP_EQUAL       ? CC_E
+                   : op == OP_NOT_EQUAL ? CC_NE
+                   : op == OP_LESS || op == OP_GREATER ? CC_A
+                                                       : CC_AE;
+      // setcc al, then and/or with the parity flag for the equalities
+      emit_byte(e, 0x0f);
+      emit_byte(e, 0x90 | cc);
+      emit_byte(e, 0xc0);
+      if (op == OP_EQUAL || op == OP_NOT_EQUAL) {
+        emit_byte(e, 0x0f);
+        emit_byte(e, 0x90 | (op == OP_EQUAL ? CC_NP : CC_P));
+        emit_byte(e, 0xc1);
+        emit_byte(e, op == OP_EQUAL ? 0x20 : 0x08);
+        emit_byte(e, 0xc8);
+      }
+      // movzx eax, al; mov [r13 - 24], rax; mov qword [r13 - 32], boolean
+      emit_byte(e, 0x0f);
+      emit_byte(e, 0xb6);
+      emit_byte(e, 0xc0);
+      emit_mem(e, 0, 1, 0x89, RAX, R13, -24);
+      emit_mem(e, 0, 1, 0xc7, 0, R13, -32);
+      emit_u32(e, T_BOOLEAN);
+      break;
+    }
+    }
+  }
+  if (op == OP_MOD || checks) {
+    uint32_t done = op == OP_MOD ? 0 : emit_jump(e, CC_ALWAYS);
+    for (int k = 0; k < checks; k++)
+      patch_jump(e, slow[k]);
+    emit_helper(e, (uintptr_t)native_binary, op, 0);
+    if (op != OP_MOD)
+      patch_jump(e, done);
+  }
+  emit_pop(e);
+  switch (op) {
+  case OP_PLUS:
+    return left == T_NUMBER && right == T_NUMBER ? T_NUMBER : JIT_ANY;
+  case OP_MINUS:
+  case OP_STAR:
+  case OP_SLASH:
+  case OP_MOD:
+    return T_NUMBER;
+  default:
+    return T_BOOLEAN;
+  }
+}
+
+void compile_boolean_check(emitter_t *e, uint64_t message) {
+  emit_cmp_type(e, R13, -16, T_BOOLEAN);
+  uint32_t ok = emit_jump(e, CC_E);
+  emit_helper(e, (uintptr_t)native_fail, message, 0);
+  patch_jump(e, ok);
+  return;
+}
+
+void emit_byte(emitter_t *e, uint8_t byte) {
+  e->code = mem_reserve(e->code, &e->capacity, e->count + 1, sizeof(uint8_t));
+  e->code[e->count++] = byte;
+  return;
+}
+
+void emit_u32(emitter_t *e, uint32_t v) {
+  for (int k = 0; k < 4; k++)
+    emit_byte(e, v >> (8 * k));
+  return;
+}
+
+void emit_u64(emitter_t *e, uint64_t v) {
+  for (int k = 0; k < 8; k++)
+    emit_byte(e, v >> (8 * k));
+  return;
+}
+
+void emit_rex(emitter_t *e, int w, int reg, int base) {
+  uint8_t rex = 0x40 | w << 3 | (reg >> 3 & 1) << 2 | (base >> 3 & 1);
+  if (rex != 0x40)
+    emit_byte(e, rex);
+  return;
+}
+
+void emit_mem(emitter_t *e, uint8_t prefix, int w, uint16_t opcode, int reg,
+              int base, int32_t disp) {
+  if (prefix)
+    emit_byte(e, prefix);
+  emit_rex(e, w, reg, base);
+  if (opcode > 0xff)
+    emit_byte(e, opcode >> 8);
+  emit_byte(e, opcode & 0xff);
+  // rbp and r13 have no form without a displacement, rsp and r12 need a SIB
+  int small = disp >= -128 && disp <= 127;
+  emit_byte(e, (small ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7));
+  if ((base & 7) == 4)
+    emit_byte(e, 0x24);
+  if (small)
+    emit_byte(e, (uint8_t)disp);
+  else
+    emit_u32(e, (uint32_t)disp);
+  return;
+}
+
+void emit_mov_imm(emitter_t *e, int reg, uint64_t imm) {
+  emit_rex(e, 1, 0, reg);
+  emit_byte(e, 0xb8 | (reg & 7));
+  emit_u64(e, imm);
+  return;
+}
+
+void emit_mov_reg(emitter_t *e, int dst, int src) {
+  emit_rex(e, 1, src, dst);
+  emit_byte(e, 0x89);
+  emit_byte(e, 0xc0 | (src & 7) << 3 | (dst & 7));
+  return;
+}
+
+void emit_add_imm(emitter_t *e, int reg, int32_t imm) {
+  emit_rex(e, 1, 0, reg);
+  emit_byte(e, 0x83);
+  emit_byte(e, 0xc0 | (reg & 7));
+  emit_byte(e, (uint8_t)imm);
+  return;
+}
+
+void emit_cmp_type(emitter_t *e, int base, int32_t disp, uint8_t type) {
+  // cmp qword [base + disp], type
+  emit_mem(e, 0, 1, 0x83, 7, base, disp);
+  emit_byte(e, type);
+  return;
+}
+
+void emit_helper(emitter_t *e, uintptr_t helper, uint64_t a, uint64_t b) {
+  emit_mov_reg(e, RDI, R12);
+  emit_mov_reg(e, RSI, R13);
+  emit_mov_imm(e, RDX, a);
+  emit_mov_imm(e, RCX, b);
+  emit_mov_imm(e, RAX, helper);
+  // call rax
+  emit_byte(e, 0xff);
+  emit_byte(e, 0xd0);
+  return;
+}
+
+uint32_t emit_jump(emitter_t *e, uint8_t cc) {
+  if (cc == CC_ALWAYS) {
+    emit_byte(e, 0xe9);
+  } else {
+    emit_byte(e, 0x0f);
+    emit_byte(e, 0x80 | cc);
+  }
+  uint32_t at = e->count;
+  emit_u32(e, 0);
+  return at;
+}
+
+void patch_jump(emitter_t *e, uint32_t at) {
+  uint32_t rel = e->count - (at + 4);
+  memcpy(e->code + at, &rel, sizeof(uint32_t));
+  return;
+}
+
+void push(emitter_t *e, int n) {
+  e->depth += n;
+  if (e->depth > e->max_depth)
+    e->max_depth = e->depth;
+  return;
+}
+
+void emit_push_constant(emitter_t *e, uint8_t type, uint64_t payload) {
+  // mov rax, payload; mov [r13 + 8], rax; mov qword [r13], type
+  emit_mov_imm(e, RAX, payload);
+  emit_mem(e, 0, 1, 0x89, RAX, R13, 8);
+  emit_mem(e, 0, 1, 0xc7, 0, R13, 0);
+  emit_u32(e, type);
+  emit_add_imm(e, R13, sizeof(jit_value_t));
+  push(e, 1);
+  return;
+}
+
+void emit_pop(emitter_t *e) {
+  emit_add_imm(e, R13, -(int32_t)sizeof(jit_value_t));
+  push(e, -1);
+  return;
+}
+
+void emit_epilogue(emitter_t *e, uint32_t status) {
+  // mov eax, status; pop r13; pop r12; pop rbx; ret
+  emit_byte(e, 0xb8);
+  emit_u32(e, status);
+  emit_byte(e, 0x41);
+  emit_byte(e, 0x5d);
+  emit_byte(e, 0x41);
+  emit_byte(e, 0x5c);
+  emit_byte(e, 0x5b);
+  emit_byte(e, 0xc3);
+  return;
+}
@@ -0,0 +1,157 @@
+#ifndef JIT_H
+#define JIT_H
+#include "garbage.h"
+#include "interpreter.h"
+#include "list.h"
+#include "syntax.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define JIT_THRESHOLD 10
+#define JIT_MAX_DEOPTS 16
+
+/**
+ * A value as seen by the native code, numbers and booleans are unboxed
+ * @param type the literal type of the value
+ * @param as the payload, boxed holds any other value (unused for nil)
+ */
+typedef struct {
+  uint64_t type;
+  union {
+    double number;
+    int64_t boolean;
+    value_t boxed;
+  } as;
+} jit_value_t;
+
+typedef struct jit jit_t;
+
+/**
+ * The native code of a function
+ * @param jit a pointer to the JIT
+ * @param base a pointer to the arguments, in formals order, the result is
+ * written over the first one
+ * @return 0 on success, 1 if a type guard failed before any side effect
+ */
+typedef int (*jit_code_t)(jit_t *, jit_value_t *);
+
+/**
+ * A call made by native code
+ * @param identifier the called function name (owned)
+ * @param symbol the symbol of the called function name
+ * @param forwarded 1 if the first argument comes from a |>
+ * @param names the number of formals symbols of the JIT already checked
+ * @param shadowed 1 if a formal of a compiled function has the same name
+ */
+typedef struct {
+  char *identifier;
+  uint32_t symbol;
+  int forwarded;
+  uint32_t names;
+  int shadowed;
+} jit_site_t;
+
+/**
+ * A function compiled to native code, code is NULL if the body cannot be
+ * compiled
+ * @param code the entry point
+ * @param size the size of the native code in bytes
+ * @param arity the number of formals
+ * @param slots the values used by a call, arguments included
+ * @param deopts the number of calls whose guards failed
+ * @param sites the calls made by the body
+ */
+typedef struct {
+  jit_code_t code;
+  size_t size;
+  uint32_t arity;
+  uint32_t slots;
+  uint32_t deopts;
+  l_list_t sites;
+} jit_function_t;
+
+/**
+ * A call running native code
+ * @param closure a pointer to the called closure
+ * @param base a pointer to its arguments
+ */
+typedef struct {
+  closure_t *closure;
+  jit_value_t *base;
+} jit_frame_t;
+
+/**
+ * A baseline JIT compiling the hot functions of the tree walker to x86-64,
+ * every call is counted and a closure is compiled once it reaches the
+ * threshold, specialized on the types of the arguments seen then
+ * @param interpreter a pointer to the interpreter running the program
+ * @param threshold the number of calls making a function hot
+ * @param stack the values of the native calls (mapped on demand)
+ * @param top the first free value when native code calls the interpreter
+ * @param limit the end of the stack
+ * @param frames the active native calls
+ * @param segment the first frame whose formals are not in the environment
+ * @param chunk the executable memory being filled
+ * @param chunks the executable memory mapped so far
+ * @param functions the compiled functions (owned)
+ * @param names the formals symbols of the compiled functions
+ * @param perf_map the /tmp/perf-<pid>.map naming the native code for perf,
+ * created by the first compilation
+ */
+struct jit {
+  interpreter_t *interpreter;
+  uint32_t threshold;
+  jit_value_t *stack;
+  jit_value_t *top;
+  jit_value_t *limit;
+  jit_frame_t *frames;
+  uint32_t frames_count;
+  uint32_t frames_capacity;
+  uint32_t segment;
+  uint8_t *chunk;
+  size_t chunk_used;
+  size_t chunk_size;
+  l_list_t chunks;
+  l_list_t functions;
+  uint32_t *names;
+  uint32_t names_count;
+  uint32_t names_capacity;
+  FILE *perf_map;
+  uint32_t compiled;
+  uint32_t rejected;
+  uint32_t deopts;
+  size_t code_size;
+  uint64_t native_calls;
+};
+
+/**
+ * Initialize the given JIT
+ * @param jit a pointer to the JIT to initialize
+ * @param interpreter a pointer to the interpreter whose calls are counted
+ * @param threshold the number of calls after which a function is compiled
+ * @return 1 on success, 0 if native code cannot be run on this platform
+ * @note On success the JIT is attached to the interpreter, whose calls are
+ * counted from then on
+ */
+int jit_init(jit_t *, interpreter_t *, uint32_t);
+
+/**
+ * Count a call of the given closure and run it natively if it is hot
+ * @param jit a pointer to the JIT
+ * @param closure a pointer to the called closure
+ * @param values the evaluated actuals, in the order of the closure formals
+ * @param count the number of actuals
+ * @param result a pointer where the value returned is stored
+ * @return 1 if the call ran natively, 0 if it must be interpreted (the
+ * closure is not compiled or a type guard failed)
+ */
+int jit_call(jit_t *, closure_t *, value_t *, uint32_t, value_t *);
+
+/**
+ * Destroy the given JIT, unmapping the native code
+ * @param jit a pointer to the JIT to destroy
+ */
+void jit_destroy(jit_t *);
+
+#endif // !JIT_H
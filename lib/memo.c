@@ -0,0 +1,164 @@
+#include "memo.h"
+#include "memory.h"
+#include <string.h>
+
+/**
+ * Hash a call
+ * @param function the key of the called function
+ * @param actuals the actuals of the call
+ * @param count the number of actuals
+ * @return the index of the bucket of the call
+ */
+static uint32_t bucket(memo_t *, const void *, const value_t *, uint32_t);
+/**
+ * Remove an entry from the list ordered by use
+ * @param m a pointer to the table
+ * @param k the index of the entry
+ */
+static void unlink_entry(memo_t *, uint32_t);
+/**
+ * Make an entry the most recently used one
+ * @param m a pointer to the table
+ * @param k the index of the entry, not in the list ordered by use
+ */
+static void push_newest(memo_t *, uint32_t);
+/**
+ * Free the least recently used entry, removing it from its bucket
+ * @param m a pointer to the table
+ * @return the index of the entry
+ */
+static uint32_t evict(memo_t *);
+
+void memo_init(memo_t *m, uint32_t capacity) {
+  memset(m, 0, sizeof(memo_t));
+  m->capacity = capacity;
+  m->newest = MEMO_NONE;
+  m->oldest = MEMO_NONE;
+  return;
+}
+
+int memo_lookup(memo_t *m, const void *function, const value_t *actuals,
+                uint32_t count, value_t *result) {
+  if (m->buckets_count == 0) {
+    m->misses++;
+    return 0;
+  }
+  uint32_t k = m->buckets[bucket(m, function, actuals, count)];
+  for (; k != MEMO_NONE; k = m->entries[k].next) {
+    memo_entry_t *e = &m->entries[k];
+    if (e->function != function || e->count != count ||
+        memcmp(e->actuals, actuals, count * sizeof(value_t)) != 0)
+      continue;
+    if (k != m->newest) {
+      unlink_entry(m, k);
+      push_newest(m, k);
+    }
+    m->hits++;
+    *result = e->result;
+    return 1;
+  }
+  m->misses++;
+  return 0;
+}
+
+void memo_store(memo_t *m, const void *function, const value_t *actuals,
+                uint32_t count, value_t result) {
+  if (m->buckets_count == 0) {
+    // Twice as many buckets as entries keep the chains short
+    m->buckets_count = 1;
+    while (m->buckets_count < 2 * m->capacity)
+      m->buckets_count *= 2;
+    m->buckets = mem_calloc(m->buckets_count, sizeof(uint32_t));
+    memset(m->buckets, 0xff, m->buckets_count * sizeof(uint32_t));
+  }
+  uint32_t k;
+  if (m->count < m->capacity) {
+    m->entries = mem_reserve(m->entries, &m->allocated, m->count + 1,
+                             sizeof(memo_entry_t));
+    k = m->count++;
+  } else
+    k = evict(m);
+  memo_entry_t *e = &m->entries[k];
+  e->function = function;
+  memcpy(e->actuals, actuals, count * sizeof(value_t));
+  e->count = count;
+  e->result = result;
+  uint32_t b = bucket(m, function, actuals, count);
+  e->next = m->buckets[b];
+  m->buckets[b] = k;
+  push_newest(m, k);
+  return;
+}
+
+int memo_sample(uint32_t *lookups, uint32_t *hits, int hit) {
+  *hits += hit;
+  if (++*lookups < MEMO_WINDOW)
+    return 1;
+  int worth = *hits >= MEMO_MIN_HITS;
+  *lookups = 0;
+  *hits = 0;
+  return worth;
+}
+
+int memo_accepts(const value_t *actuals, uint32_t count) {
+  if (count > MEMO_MAX_ARITY)
+    return 0;
+  for (uint32_t k = 0; k < count; k++)
+    if (value_is_object(actuals[k]))
+      return 0;
+  return 1;
+}
+
+void memo_destroy(memo_t *m) {
+  mem_free(m->entries);
+  mem_free(m->buckets);
+  memset(m, 0, sizeof(memo_t));
+  return;
+}
+
+uint32_t bucket(memo_t *m, const void *function, const value_t *actuals,
+                uint32_t count) {
+  uint64_t h = (uint64_t)(uintptr_t)function * 0x9e3779b97f4a7c15u;
+  for (uint32_t k = 0; k < count; k++)
+    h = (h ^ actuals[k]) * 0x100000001b3u;
+  h ^= h >> 32;
+  return (uint32_t)h & (m->buckets_count - 1);
+}
+
+void unlink_entry(memo_t *m, uint32_t k) {
+  memo_entry_t *e = &m->entries[k];
+  if (e->newer != MEMO_NONE)
+    m->entries[e->newer].older = e->older;
+  else
+    m->newest = e->older;
+  if (e->older != MEMO_NONE)
+    m->entries[e->older].newer = e->newer;
+  else
+    m->oldest = e->newer;
+  return;
+}
+
+void push_newest(memo_t *m, uint32_t k) {
+  memo_entry_t *e = &m->entries[k];
+  e->newer = MEMO_NONE;
+  e->older = m->newest;
+  if (m->newest != MEMO_NONE)
+    m->entries[m->newest].newer = k;
+  else
+    m->oldest = k;
+  m->newest = k;
+  return;
+}
+
+uint32_t evict(memo_t *m) {
+  uint32_t k = m->oldest;
+  memo_entry_t *e = &m->entries[k];
+  unlink_entry(m, k);
+  uint32_t *link =
+      &m->buckets[bucket(m, e->function, e->actuals, e->count)];
+  while (*link != k)
+    link = &m->entries[*link].next;
+  *link = e->next;
+  m->evictions++;
+  return k;
+}
@@ -0,0 +1,127 @@
+#ifndef MEMO_H
+#define MEMO_H
+#include "value.h"
+#include <stdint.h>
+
+// The default number of results remembered
+#define MEMO_SIZE 4096
+// The largest number of results remembered that can be configured
+#define MEMO_MAX_SIZE (1 << 24)
+// The calls with more actuals are never memoized
+#define MEMO_MAX_ARITY 4
+// The lookups of a closure after which its hits are counted
+#define MEMO_WINDOW 256
+// The hits in a window below which a closure stops being memoized
+#define MEMO_MIN_HITS 16
+// The index of no entry
+#define MEMO_NONE UINT32_MAX
+
+/**
+ * A remembered call
+ * @param function the key of the called function (its body, shared by every
+ * closure of the function)
+ * @param actuals the actuals of the call, in the order of the closure formals
+ * @param count the number of actuals
+ * @param result the value returned
+ * @param next the next entry of the same bucket
+ * @param newer the entry used right after this one, MEMO_NONE if none
+ * @param older the entry used right before this one, MEMO_NONE if none
+ */
+typedef struct {
+  const void *function;
+  value_t actuals[MEMO_MAX_ARITY];
+  uint32_t count;
+  value_t result;
+  uint32_t next;
+  uint32_t newer;
+  uint32_t older;
+} memo_entry_t;
+
+/**
+ * A bounded table of the results of the calls of pure functions, indexed by
+ * a hash of the function and of its actuals: once full, the least recently
+ * used entry is evicted. Only values that are not on the GC heap (numbers,
+ * booleans and nil) are remembered, so the table is never a root of the GC
+ * @param entries the entries, allocated on demand up to the capacity
+ * @param count the number of entries in use
+ * @param allocated the number of entries allocated
+ * @param capacity the maximum number of entries
+ * @param buckets the first entry of every bucket, a power of two of them
+ * @param buckets_count the number of buckets, 0 until the first store
+ * @param newest the most recently used entry, MEMO_NONE if none
+ * @param oldest the least recently used entry, MEMO_NONE if none
+ * @param hits the lookups that found a result
+ * @param misses the lookups that found none
+ * @param evictions the entries replaced by a newer one
+ */
+typedef struct {
+  memo_entry_t *entries;
+  uint32_t count;
+  uint32_t allocated;
+  uint32_t capacity;
+  uint32_t *buckets;
+  uint32_t buckets_count;
+  uint32_t newest;
+  uint32_t oldest;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} memo_t;
+
+/**
+ * Initialize the given table, nothing is allocated before the first store
+ * @param m a pointer to the table to initialize
+ * @param capacity the maximum number of results remembered, at least 1
+ */
+void memo_init(memo_t *, uint32_t);
+
+/**
+ * Look the result of a call up, a result found becomes the most recently used
+ * @param m a pointer to the table
+ * @param function the key of the called function
+ * @param actuals the actuals of the call
+ * @param count the number of actuals, at most MEMO_MAX_ARITY
+ * @param result a pointer where the result is stored
+ * @return 1 if the result was found, 0 otherwise
+ */
+int memo_lookup(memo_t *, const void *, const value_t *, uint32_t, value_t *);
+
+/**
+ * Remember the result of a call, evicting the least recently used one if the
+ * table is full
+ * @param m a pointer to the table
+ * @param function the key of the called function
+ * @param actuals the actuals of the call
+ * @param count the number of actuals, at most MEMO_MAX_ARITY
+ * @param result the value returned
+ */
+void memo_store(memo_t *, const void *, const value_t *, uint32_t, value_t);
+
+/**
+ * Count a lookup of the calls of a closure, at the end of every window of
+ * MEMO_WINDOW lookups the closure is memoized further only if the table held
+ * at least MEMO_MIN_HITS of its results: storing the results of calls that do
+ * not repeat costs more than running them
+ * @param lookups a pointer to the lookups of the closure in the window
+ * @param hits a pointer to the hits of the closure in the window
+ * @param hit 1 if the lookup found the result
+ * @return 0 if the closure is not worth memoizing anymore, 1 otherwise
+ */
+int memo_sample(uint32_t *, uint32_t *, int);
+
+/**
+ * Check if the actuals of a call can be a key of the table
+ * @param actuals the actuals of the call
+ * @param count the number of actuals
+ * @return 1 if they are at most MEMO_MAX_ARITY values not on the GC heap, 0
+ * otherwise
+ */
+int memo_accepts(const value_t *, uint32_t);
+
+/**
+ * Destroy the given table
+ * @param m a pointer to the table to destroy
+ */
+void memo_destroy(memo_t *);
+
+#endif // !MEMO_H
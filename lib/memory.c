@@ -1,8 +1,14 @@
 #include "memory.h"
 #include <stdio.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 
+// Updated by the pipeline threads too, hence atomic
+static _Atomic size_t allocations = 0;
+static _Atomic size_t frees = 0;
+
 void *mem_calloc(size_t nmemb, size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
   void *p = calloc(nmemb, size);
   if (p == NULL) {
     perror("calloc");
@@ -11,10 +17,40 @@ void *mem_calloc(size_t nmemb, size_t size) {
   return p;
 }
 
+void *mem_realloc(void *p, size_t size) {
+  atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+  void *new = realloc(p, size);
+  if (new == NULL) {
+    perror("realloc");
+    exit(EXIT_FAILURE);
+  }
+  return new;
+}
+
+void *mem_reserve(void *data, uint32_t *capacity, uint32_t needed,
+                  size_t size) {
+  if (needed <= *capacity)
+    return data;
+  uint32_t new_capacity = *capacity ? *capacity : MEM_INITIAL_CAPACITY;
+  while (new_capacity < needed)
+    new_capacity *= 2;
+  *capacity = new_capacity;
+  return mem_realloc(data, new_capacity * size);
+}
+
 void mem_free(void *p) {
   if (p == NULL)
     return;
+  atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
   free(p);
   p = NULL;
   return;
 }
+
+mem_stats_t mem_stats(void) {
+  mem_stats_t stats = {
+      .allocations = atomic_load_explicit(&allocations, memory_order_relaxed),
+      .frees = atomic_load_explicit(&frees, memory_order_relaxed),
+  };
+  return stats;
+}
@@ -1,8 +1,34 @@
 #ifndef MEMORY_H
 #define MEMORY_H
+#include <stdint.h>
 #include <stdlib.h>
 
+// The capacity of an array grown by mem_reserve for the first time
+#define MEM_INITIAL_CAPACITY 256
+
+/**
+ * The number of calls made to the system allocator so far
+ * @param allocations the number of calloc and realloc calls
+ * @param frees the number of free calls
+ */
+typedef struct {
+  size_t allocations;
+  size_t frees;
+} mem_stats_t;
+
 void *mem_calloc(size_t, size_t);
+void *mem_realloc(void *, size_t);
+/**
+ * Make sure an array can hold at least the given number of elements, its
+ * capacity is doubled until it does
+ * @param data the array
+ * @param capacity a pointer to the current capacity of the array
+ * @param needed the number of elements needed
+ * @param size the size of a single element
+ * @return the (possibly moved) array
+ */
+void *mem_reserve(void *, uint32_t *, uint32_t, size_t);
 void mem_free(void *);
+mem_stats_t mem_stats(void);
 
 #endif // !MEMORY_HMEMORY_H
@@ -0,0 +1,375 @@
+#include "optimizer.h"
+#include "arena.h"
+#include "list.h"
+#include "syntax.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * Optimize an expression, it is rewritten in place
+ * @param o a pointer to the optimizer
+ * @param e a pointer to the expression
+ */
+static void optimize_exp(optimizer_t *, exp_t *);
+/**
+ * Fold a unary expression whose operand is a literal, or drop a double
+ * negation whose operand has the type the operator checks
+ * @param o a pointer to the optimizer
+ * @param e a pointer to the expression wrapping the unary one
+ * @param u a pointer to the unary expression
+ */
+static void optimize_unary(optimizer_t *, exp_t *, exp_unary_t *);
+/**
+ * Fold a binary expression whose operands are literals, or drop an identity
+ * operation whose other operand is known to be a number
+ * @param o a pointer to the optimizer
+ * @param e a pointer to the expression wrapping the binary one
+ * @param b a pointer to the binary expression
+ */
+static void optimize_binary(optimizer_t *, exp_t *, exp_binary_t *);
+/**
+ * Compute an operator (but the short circuit and forwarding ones) applied to
+ * two literals
+ * @param o a pointer to the optimizer
+ * @param op the operator
+ * @param l a pointer to the left side literal
+ * @param r a pointer to the right side literal
+ * @param result a pointer where the value is stored
+ * @return 1 if the value was computed, 0 if the operator raises an error on
+ * these operands
+ */
+static int compute(optimizer_t *, operator_t, exp_literal_t *,
+                   exp_literal_t *, exp_literal_t *);
+/**
+ * Replace an expression by a literal
+ * @param o a pointer to the optimizer
+ * @param e a pointer to the expression to replace
+ * @param l the literal
+ */
+static void fold(optimizer_t *, exp_t *, exp_literal_t);
+/**
+ * Get the literal an expression is made of
+ * @param e a pointer to the expression
+ * @return a pointer to the literal, NULL if the expression is not a literal
+ */
+static exp_literal_t *literal(exp_t *);
+/**
+ * Check if an expression is a given number literal (the sign of a zero
+ * matters)
+ * @param e a pointer to the expression
+ * @param n the number
+ * @return 1 if the expression is that number literal, 0 otherwise
+ */
+static int is_constant(exp_t *, double);
+/**
+ * Check if the value of an expression is a number whenever it raises no error
+ * @param e a pointer to the expression
+ * @return 1 if the value is a number, 0 if unknown
+ */
+static int is_number(exp_t *);
+/**
+ * Check if the value of an expression is a boolean whenever it raises no
+ * error
+ * @param e a pointer to the expression
+ * @return 1 if the value is a boolean, 0 if unknown
+ */
+static int is_boolean(exp_t *);
+
+void optimizer_init(optimizer_t *o, arena_t *arena) {
+  memset(o, 0, sizeof(optimizer_t));
+  o->arena = arena;
+  return;
+}
+
+void optimizer_optimize(optimizer_t *o, l_list_t statements) {
+  for (l_list_t current = statements; current; current = current->next)
+    optimizer_optimize_statement(o, current->data);
+  return;
+}
+
+void optimizer_optimize_statement(optimizer_t *o, stmt_t *s) {
+  switch (s->type) {
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    optimize_exp(o, c->condition);
+    optimizer_optimize_statement(o, c->then_branch);
+    if (c->else_branch)
+      optimizer_optimize_statement(o, c->else_branch);
+    exp_literal_t *l = literal(c->condition);
+    // Any other literal raises an error when it is tested
+    if (l == NULL || l->type != T_BOOLEAN)
+      break;
+    stmt_t *branch = l->value.boolean ? c->then_branch : c->else_branch;
+    // A condition without a branch to run evaluates to nil, as an empty
+    // block does
+    if (branch)
+      *s = *branch;
+    else
+      *s = (stmt_t){.stmt = stmt_block_init(o->arena, NULL),
+                    .type = STMT_BLOCK,
+                    .line = s->line};
+    o->pruned++;
+    break;
+  }
+  case STMT_FUN:
+    optimizer_optimize_statement(o,
+                                 ((stmt_function_t *)stmt_unwrap(s))->body);
+    break;
+  case STMT_PRINT:
+  case STMT_EXPR:
+  case STMT_RETURN:
+    // stmt_expr_t and stmt_print_t share the same layout
+    optimize_exp(o, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_BLOCK:
+    optimizer_optimize(o, ((stmt_block_t *)stmt_unwrap(s))->statements);
+    break;
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT:
+    optimize_exp(o, ((stmt_declaration_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_LAZY: {
+    // A body parsed lazily is optimized when it is parsed
+    stmt_lazy_t *lazy = stmt_unwrap(s);
+    if (lazy->body)
+      optimizer_optimize_statement(o, lazy->body);
+    break;
+  }
+  default:
+    break;
+  }
+  return;
+}
+
+void optimize_exp(optimizer_t *o, exp_t *e) {
+  switch (e->type) {
+  case EXP_GROUPING: {
+    // The tree already encodes the precedence the grouping forced
+    exp_t *child = ((exp_grouping_t *)exp_unwrap(e))->exp;
+    optimize_exp(o, child);
+    *e = *child;
+    break;
+  }
+  case EXP_UNARY:
+    optimize_unary(o, e, exp_unwrap(e));
+    break;
+  case EXP_BINARY:
+    optimize_binary(o, e, exp_unwrap(e));
+    break;
+  case EXP_CALL:
+    for (l_list_t actual = ((exp_call_t *)exp_unwrap(e))->actuals; actual;
+         actual = actual->next)
+      optimize_exp(o, actual->data);
+    break;
+  default:
+    break;
+  }
+  return;
+}
+
+void optimize_unary(optimizer_t *o, exp_t *e, exp_unary_t *u) {
+  optimize_exp(o, u->right);
+  exp_literal_t *r = literal(u->right);
+  if (u->op == OP_MINUS && r && r->type == T_NUMBER) {
+    fold(o, e,
+         (exp_literal_t){.value.number = -r->value.number, .type = T_NUMBER});
+    return;
+  }
+  if (u->op == OP_NOT && r && r->type == T_BOOLEAN) {
+    fold(o, e,
+         (exp_literal_t){.value.boolean = !r->value.boolean,
+                         .type = T_BOOLEAN});
+    return;
+  }
+  // The inner operator keeps checking the type of the operand
+  if (u->right->type != EXP_UNARY)
+    return;
+  exp_unary_t *inner = exp_unwrap(u->right);
+  if (inner->op != u->op || (u->op == OP_MINUS ? !is_number(inner->right)
+                                               : !is_boolean(inner->right)))
+    return;
+  *e = *inner->right;
+  o->simplified++;
+  return;
+}
+
+void optimize_binary(optimizer_t *o, exp_t *e, exp_binary_t *b) {
+  optimize_exp(o, b->left);
+  if (b->op == OP_FORWARD) {
+    // Anything but a call on the right side raises an error
+    if (b->right->type == EXP_CALL)
+      optimize_exp(o, b->right);
+    return;
+  }
+  optimize_exp(o, b->right);
+  exp_literal_t *l = literal(b->left);
+  exp_literal_t *r = literal(b->right);
+  if (b->op == OP_AND || b->op == OP_OR) {
+    if (l == NULL || l->type != T_BOOLEAN)
+      return;
+    if (l->value.boolean == (b->op == OP_OR)) {
+      // A short circuit, the right side is never evaluated
+      *e = *b->left;
+      o->folded++;
+    } else if (is_boolean(b->right)) {
+      *e = *b->right;
+      o->simplified++;
+    }
+    return;
+  }
+  exp_literal_t result;
+  if (l && r && compute(o, b->op, l, r, &result)) {
+    fold(o, e, result);
+    return;
+  }
+  // x + 0 is not an identity, -0 + 0 is 0
+  exp_t *operand = NULL;
+  if ((b->op == OP_STAR || b->op == OP_SLASH) && is_constant(b->right, 1))
+    operand = b->left;
+  else if (b->op == OP_STAR && is_constant(b->left, 1))
+    operand = b->right;
+  else if (b->op == OP_MINUS && is_constant(b->right, 0))
+    operand = b->left;
+  if (operand == NULL || !is_number(operand))
+    return;
+  *e = *operand;
+  o->simplified++;
+  return;
+}
+
+int compute(optimizer_t *o, operator_t op, exp_literal_t *l, exp_literal_t *r,
+            exp_literal_t *result) {
+  // Every operator raises an error on operands of different types
+  if (l->type != r->type)
+    return 0;
+  int equal;
+  switch (l->type) {
+  case T_NUMBER: {
+    double a = l->value.number, b = r->value.number;
+    result->type = T_NUMBER;
+    switch (op) {
+    case OP_PLUS:
+      result->value.number = a + b;
+      return 1;
+    case OP_MINUS:
+      result->value.number = a - b;
+      return 1;
+    case OP_STAR:
+      result->value.number = a * b;
+      return 1;
+    case OP_SLASH:
+      result->value.number = a / b;
+      return 1;
+    case OP_MOD:
+      result->value.number = fmod(a, b);
+      return 1;
+    default:
+      break;
+    }
+    result->type = T_BOOLEAN;
+    switch (op) {
+    case OP_LESS:
+      result->value.boolean = a < b;
+      return 1;
+    case OP_LESS_EQUAL:
+      result->value.boolean = a <= b;
+      return 1;
+    case OP_GREATER:
+      result->value.boolean = a > b;
+      return 1;
+    case OP_GREATER_EQUAL:
+      result->value.boolean = a >= b;
+      return 1;
+    default:
+      equal = a == b;
+      break;
+    }
+    break;
+  }
+  case T_STRING:
+    if (op == OP_PLUS) {
+      size_t left = strlen(l->value.string), right = strlen(r->value.string);
+      char *chars = arena_alloc(o->arena, left + right + 1);
+      memcpy(chars, l->value.string, left);
+      memcpy(chars + left, r->value.string, right + 1);
+      result->type = T_STRING;
+      result->value.string = chars;
+      return 1;
+    }
+    equal = strcmp(l->value.string, r->value.string) == 0;
+    break;
+  case T_BOOLEAN:
+    equal = l->value.boolean == r->value.boolean;
+    break;
+  case T_NIL:
+    equal = 1;
+    break;
+  default:
+    return 0;
+  }
+  // Only the equality operators are left to the types other than numbers
+  if (op != OP_EQUAL && op != OP_NOT_EQUAL)
+    return 0;
+  result->type = T_BOOLEAN;
+  result->value.boolean = equal == (op == OP_EQUAL);
+  return 1;
+}
+
+void fold(optimizer_t *o, exp_t *e, exp_literal_t l) {
+  e->type = EXP_LITERAL;
+  e->exp = exp_literal_init(o->arena, l.type, l.value);
+  o->folded++;
+  return;
+}
+
+exp_literal_t *literal(exp_t *e) {
+  return e->type == EXP_LITERAL ? exp_unwrap(e) : NULL;
+}
+
+int is_constant(exp_t *e, double n) {
+  exp_literal_t *l = literal(e);
+  return l && l->type == T_NUMBER && l->value.number == n &&
+         signbit(l->value.number) == signbit(n);
+}
+
+int is_number(exp_t *e) {
+  switch (e->type) {
+  case EXP_LITERAL:
+    return ((exp_literal_t *)exp_unwrap(e))->type == T_NUMBER;
+  case EXP_UNARY:
+    return ((exp_unary_t *)exp_unwrap(e))->op == OP_MINUS;
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    switch (b->op) {
+    case OP_MINUS:
+    case OP_STAR:
+    case OP_SLASH:
+    case OP_MOD:
+      return 1;
+    case OP_PLUS:
+      // Strings are concatenated too
+      return is_number(b->left) || is_number(b->right);
+    default:
+      return 0;
+    }
+  }
+  default:
+    return 0;
+  }
+}
+
+int is_boolean(exp_t *e) {
+  switch (e->type) {
+  case EXP_LITERAL:
+    return ((exp_literal_t *)exp_unwrap(e))->type == T_BOOLEAN;
+  case EXP_UNARY:
+    return ((exp_unary_t *)exp_unwrap(e))->op == OP_NOT;
+  case EXP_BINARY: {
+    operator_t op = ((exp_binary_t *)exp_unwrap(e))->op;
+    return op != OP_PLUS && op != OP_MINUS && op != OP_STAR &&
+           op != OP_SLASH && op != OP_MOD && op != OP_FORWARD;
+  }
+  default:
+    return 0;
+  }
+}
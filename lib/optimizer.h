@@ -0,0 +1,47 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include "arena.h"
+#include "list.h"
+#include "syntax.h"
+#include <stdint.h>
+
+/**
+ * The pass run between the resolver and the engines rewriting the AST in
+ * place: it folds the operators applied to literals, drops the groupings,
+ * removes the identity operations and the branches of the conditions known
+ * before running. An operation that would raise an error is left as it is,
+ * so the error is still raised when (and if) it runs
+ * @param arena the arena holding the folded strings, it must outlive the AST
+ * @param folded the operators replaced by their value
+ * @param simplified the identity operations replaced by their operand
+ * @param pruned the conditions replaced by one of their branches
+ */
+typedef struct {
+  arena_t *arena;
+  uint32_t folded;
+  uint32_t simplified;
+  uint32_t pruned;
+} optimizer_t;
+
+/**
+ * Initialize the given optimizer
+ * @param o a pointer to the optimizer to initialize
+ * @param arena a pointer to the arena holding the folded strings
+ */
+void optimizer_init(optimizer_t *, arena_t *);
+
+/**
+ * Optimize the given statements, and the function bodies already parsed
+ * @param o a pointer to the optimizer
+ * @param statements a list of statements
+ */
+void optimizer_optimize(optimizer_t *, l_list_t);
+
+/**
+ * Optimize a single statement, it is rewritten in place
+ * @param o a pointer to the optimizer
+ * @param s a pointer to the statement
+ */
+void optimizer_optimize_statement(optimizer_t *, stmt_t *);
+
+#endif // !OPTIMIZER_H
@@ -1,4 +1,5 @@
 #include "parser.h"
+#include "arena.h"
 #include "errors.h"
 #include "list.h"
 #include "memory.h"
@@ -6,9 +7,76 @@
 #include "token.h"
 #include <setjmp.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 
+#define PARSER_CHUNKS_PER_JOB 4
+#define PARSER_PARALLEL_MIN_TOKENS (1 << 16)
+
+/**
+ * The binding power of the binary operators, from the loosest to the tightest
+ */
+typedef enum {
+  PREC_NONE,
+  PREC_FORWARD,
+  PREC_EQUALITY,
+  PREC_BOOLEAN,
+  PREC_COMPARISON,
+  PREC_TERM,
+  PREC_FACTOR,
+} precedence_t;
+
+/**
+ * The precedence of every token used as a binary operator, PREC_NONE for the
+ * tokens that end an expression
+ */
+static const unsigned char binary_precedence[END + 1] = {
+    [PIPE_GREATER] = PREC_FORWARD,
+    [BANG_EQUAL] = PREC_EQUALITY,
+    [EQUAL_EQUAL] = PREC_EQUALITY,
+    [AND] = PREC_BOOLEAN,
+    [OR] = PREC_BOOLEAN,
+    [GREATER] = PREC_COMPARISON,
+    [GREATER_EQUAL] = PREC_COMPARISON,
+    [LESS] = PREC_COMPARISON,
+    [LESS_EQUAL] = PREC_COMPARISON,
+    [MINUS] = PREC_TERM,
+    [PLUS] = PREC_TERM,
+    [SLASH] = PREC_FACTOR,
+    [STAR] = PREC_FACTOR,
+    [MOD] = PREC_FACTOR,
+};
+
+/**
+ * A slice of the source parsed by a worker of parser_parse_parallel
+ * @param parser the parser owning a copy of the chunk tokens
+ * @param arena the arena owning the chunk statements
+ * @param statements the parsed top level statements
+ * @param diagnostics the errors reported while parsing the chunk
+ * @param diagnostics_size the length of diagnostics
+ */
+typedef struct {
+  parser_t parser;
+  arena_t arena;
+  l_list_t statements;
+  char *diagnostics;
+  size_t diagnostics_size;
+} parse_chunk_t;
+
+/**
+ * The chunks shared by the workers of parser_parse_parallel
+ * @param chunks the chunks to parse
+ * @param count the number of chunks
+ * @param next the index of the next chunk to parse
+ */
+typedef struct {
+  parse_chunk_t *chunks;
+  int count;
+  _Atomic int next;
+} parse_pool_t;
+
 /**
  * Parse an expression
  * @param p a pointer to the parser
@@ -16,6 +84,28 @@
  * @note This is the facade for the real expression parsing functions
  */
 static exp_t *expression(parser_t *);
+/**
+ * Parse an expression by precedence climbing
+ * @param p a pointer to the parser
+ * @param min_precedence the loosest binary operator allowed at this level
+ * @return a pointer to the parsed expression
+ * @note Every binary operator is left associative, the trees are the same
+ * built by the recursive descent functions below
+ */
+static exp_t *pratt(parser_t *, precedence_t);
+/**
+ * Parse an unary, call or primary expression
+ * @param p a pointer to the parser
+ * @return a pointer to the parsed expression
+ */
+static exp_t *prefix(parser_t *);
+/**
+ * Parse the actuals of a call, the parser must be after the '('
+ * @param p a pointer to the parser
+ * @param t the identifier of the called function
+ * @return a pointer to the parsed expression
+ */
+static exp_t *call_actuals(parser_t *, token_t);
 /**
  * Parse a forwarding expression
  * @param p a pointer to the parser
@@ -85,7 +175,7 @@ static void synchronize(parser_t *);
  */
 __attribute__((noreturn)) static void throw_error_formatted(parser_t *, char *,
                                                             va_list);
-static void throw_error(parser_t *, char *);
+__attribute__((noreturn)) static void throw_error(parser_t *, char *, ...);
 
 /**
  * Check if the current token match one of the given tokens
@@ -128,6 +218,14 @@ static token_t *peek(parser_t *);
  * @return a pointer to the next token in the list or NULL
  */
 static token_t *peek_next(parser_t *);
+/**
+ * Get the token at the given position, receiving it from the input channel if
+ * it's not available yet
+ * @param p a pointer to the parser
+ * @param index the position of the token
+ * @return a pointer to the token or NULL
+ */
+static token_t *token_at(parser_t *, int);
 /**
  * Move to the next token in the list
  * @param p a pointer to the parser
@@ -160,6 +258,13 @@ consume(parser_t *, token_type_t, char *, ...);
  * @note This is the facade for the real statements parsing functions
  */
 static stmt_t *statement(parser_t *);
+/**
+ * Parse a statement without catching the errors
+ * @param p a pointer to the parser
+ * @return a pointer to the parsed statement
+ * @note Auxiliary function used inside the statement function
+ */
+static stmt_t *dispatch_statement(parser_t *);
 /**
  * Parse an expression statement
  * @pararm p a pointer to the parser
@@ -202,29 +307,178 @@ static stmt_t *stmt_assignment(parser_t *);
  * @return a pointer to the parsed statement
  */
 static stmt_t *stmt_function_declaration(parser_t *);
+/**
+ * Skip a function body between braces, only the braces are matched
+ * @param p a pointer to the parser, the current token must be '{'
+ * @return a pointer to a STMT_LAZY statement, NULL if the braces are not
+ * balanced (the body must then be parsed to report the error)
+ */
+static stmt_t *skip_body(parser_t *);
 /**
  * Parse a return statement
  * @pararm p a pointer to the parser
  * @return a pointer to the parsed statement
  */
 static stmt_t *stmt_return(parser_t *);
+/**
+ * Find where the tokens can be split in independent top level statements
+ * @param tokens the tokens to split
+ * @param target the maximum number of chunks
+ * @param starts the index of the first token of every chunk, followed by the
+ * index of the END token
+ * @return the number of chunks found
+ * @note A chunk starts with a fun or let at the outermost nesting level right
+ * after a ';' or a '}', where only a new statement can begin
+ */
+static int split_chunks(token_vector_t, int, int *);
+/**
+ * Prepare a chunk parser for the tokens in [start, end)
+ * @param chunk a pointer to the chunk to initialize
+ * @param p a pointer to the parser owning all the tokens
+ * @param start the index of the first token of the chunk
+ * @param end the index of the first token after the chunk
+ */
+static void chunk_init(parse_chunk_t *, parser_t *, int, int);
+/**
+ * Parse chunks until the pool is empty
+ * @param args a pointer to the parse_pool_t
+ * @return NULL
+ */
+static void *parse_worker(void *);
+/**
+ * Copy the lexeme of the given token inside the parser arena
+ * @param p a pointer to the parser
+ * @param t the token
+ * @return a pointer to the NULL terminated lexeme
+ */
+static char *lexeme(parser_t *, token_t);
+/**
+ * Copy the literal of a STRING token (without quotes) inside the parser arena
+ * @param p a pointer to the parser
+ * @param t the token
+ * @return a pointer to the NULL terminated literal
+ */
+static char *string_literal(parser_t *, token_t);
 
-void parser_init(parser_t *parser, l_list_t tokens) {
+void parser_init(parser_t *parser, token_vector_t tokens, const char *source,
+                 arena_t *arena) {
   memset(parser, 0, sizeof(*parser));
   parser->current = 0;
   parser->tokens = tokens;
+  parser->source = source;
+  parser->arena = arena;
+  parser->input = NULL;
+  parser->output = NULL;
+  return;
+}
+
+void parser_init_streaming(parser_t *parser, const char *source,
+                           arena_t *arena, channel_t *input,
+                           channel_t *output) {
+  token_vector_t tokens;
+  tokens_init(&tokens);
+  parser_init(parser, tokens, source, arena);
+  parser->input = input;
+  parser->output = output;
   return;
 }
 
 l_list_t parser_parse(parser_t *parser) {
   l_list_t statements = NULL;
   while (!is_at_end(parser)) {
-    list_add(&statements, statement(parser));
+    stmt_t *s = statement(parser);
+    if (parser->output == NULL)
+      arena_list_add(parser->arena, &statements, s);
+    else if (!parser_had_errors(*parser))
+      channel_send(parser->output, &s);
   }
+  if (parser->output)
+    channel_close(parser->output);
   list_reverse_in_place(&statements);
   return statements;
 }
 
+l_list_t parser_parse_parallel(parser_t *parser, int jobs) {
+  if (jobs < 2 || parser->input || parser->output || parser->lazy ||
+      parser->tokens.count < PARSER_PARALLEL_MIN_TOKENS)
+    return parser_parse(parser);
+  int *starts = mem_calloc(jobs * PARSER_CHUNKS_PER_JOB + 1, sizeof(int));
+  int count =
+      split_chunks(parser->tokens, jobs * PARSER_CHUNKS_PER_JOB, starts);
+  if (count < 2) {
+    mem_free(starts);
+    return parser_parse(parser);
+  }
+  parse_pool_t pool;
+  pool.chunks = mem_calloc(count, sizeof(parse_chunk_t));
+  pool.count = count;
+  atomic_init(&pool.next, 0);
+  for (int k = 0; k < count; k++)
+    chunk_init(&pool.chunks[k], parser, starts[k], starts[k + 1]);
+  mem_free(starts);
+  // The calling thread is a worker too
+  pthread_t *workers = mem_calloc(jobs - 1, sizeof(pthread_t));
+  for (int j = 0; j < jobs - 1; j++)
+    pthread_create(&workers[j], NULL, parse_worker, &pool);
+  parse_worker(&pool);
+  for (int j = 0; j < jobs - 1; j++)
+    pthread_join(workers[j], NULL);
+  mem_free(workers);
+  // A chunk ending in the middle of a statement means that the sequential
+  // parser would have recovered across the split point, so its errors (and
+  // statements) would differ
+  int consistent = 1;
+  for (int k = 0; k < count - 1; k++)
+    if (pool.chunks[k].parser.unexpected_end)
+      consistent = 0;
+  l_list_t statements = NULL;
+  l_list_t *tail = &statements;
+  for (int k = 0; k < count; k++) {
+    parse_chunk_t *chunk = &pool.chunks[k];
+    if (consistent) {
+      fwrite(chunk->diagnostics, 1, chunk->diagnostics_size, stderr);
+      for (int level = 0; level < LOG_LEVELS; level++)
+        parser->errors[level] += chunk->parser.errors[level];
+      arena_adopt(parser->arena, &chunk->arena);
+      *tail = chunk->statements;
+      while (*tail)
+        tail = &(*tail)->next;
+    }
+    arena_destroy(&chunk->arena);
+    mem_free(chunk->diagnostics);
+    parser_destroy(chunk->parser);
+  }
+  mem_free(pool.chunks);
+  if (!consistent)
+    return parser_parse(parser);
+  parser->current = parser->tokens.count - 1;
+  return statements;
+}
+
+stmt_t *parser_parse_lazy(stmt_lazy_t *l) {
+  if (l->body)
+    return l->body;
+  parser_t *p = l->parser;
+  int errors = p->errors[ERROR];
+  p->current = l->start;
+  stmt_t *body = statement(p);
+  if (p->errors[ERROR] == errors)
+    l->body = body;
+  return l->body;
+}
+
+void parser_parse_lazy_all(parser_t *p) {
+  // The bodies nested in a parsed body are added in front of the list
+  l_list_t checked = NULL;
+  while (p->lazy_bodies != checked) {
+    l_list_t head = p->lazy_bodies;
+    for (l_list_t current = head; current != checked; current = current->next)
+      parser_parse_lazy(current->data);
+    checked = head;
+  }
+  return;
+}
+
 void parser_errors_report(parser_t parser) {
   dprintf(2, "%s[PARSER]\t%sErrors: %d\t%sWarnings: %d%s\n", ANSI_COLOR_MAGENTA,
           ANSI_COLOR_RED, parser.errors[ERROR], ANSI_COLOR_YELLOW,
@@ -235,18 +489,55 @@ void parser_errors_report(parser_t parser) {
 int parser_had_errors(parser_t p) { return p.errors[ERROR] > 0; }
 
 void parser_destroy(parser_t parser) {
-  list_free(parser.tokens, token_free);
+  tokens_destroy(&parser.tokens);
   return;
 }
 
-exp_t *expression(parser_t *p) { return forwarding(p); }
+exp_t *expression(parser_t *p) {
+  return p->descent ? forwarding(p) : pratt(p, PREC_FORWARD);
+}
+
+exp_t *pratt(parser_t *p, precedence_t min_precedence) {
+  exp_t *expr = prefix(p);
+  for (;;) {
+    token_t *t = peek(p);
+    precedence_t precedence = binary_precedence[t->type];
+    if (precedence == PREC_NONE || precedence < min_precedence)
+      return expr;
+    operator_t op = token_to_operator(*t);
+    advance(p);
+    exp_t *right = pratt(p, precedence + 1);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
+  }
+}
+
+exp_t *prefix(parser_t *p) {
+  token_t t = *peek(p);
+  switch (t.type) {
+  case BANG:
+  case MINUS: {
+    advance(p);
+    exp_t *right = prefix(p);
+    exp_unary_t *e = exp_unary_init(p->arena, token_to_operator(t), right);
+    return exp_init(p->arena, EXP_UNARY, e);
+  }
+  case IDENTIFIER:
+    if (peek_next(p)->type != LEFT_PAREN)
+      return primary(p);
+    p->current += 2;
+    return call_actuals(p, t);
+  default:
+    return primary(p);
+  }
+}
 
 exp_t *forwarding(parser_t *p) {
   exp_t *expr = equality(p);
   while (match(p, 1, PIPE_GREATER)) {
     exp_t *right = equality(p);
-    exp_binary_t *e = exp_binary_init(expr, OP_FORWARD, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, OP_FORWARD, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
@@ -255,13 +546,10 @@ exp_t *equality(parser_t *p) {
   exp_t *expr = NULL;
   expr = boolean_algebra(p);
   while (match(p, 2, BANG_EQUAL, EQUAL_EQUAL)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = boolean_algebra(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_binary_t *e = exp_binary_init(expr, op, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
@@ -269,13 +557,10 @@ exp_t *equality(parser_t *p) {
 exp_t *boolean_algebra(parser_t *p) {
   exp_t *expr = comparison(p);
   while (match(p, 2, AND, OR)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = comparison(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_binary_t *e = exp_binary_init(expr, op, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
@@ -284,13 +569,10 @@ exp_t *comparison(parser_t *p) {
   exp_t *expr = NULL;
   expr = term(p);
   while (match(p, 4, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = term(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_binary_t *e = exp_binary_init(expr, op, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
@@ -299,13 +581,10 @@ exp_t *term(parser_t *p) {
   exp_t *expr = NULL;
   expr = factor(p);
   while (match(p, 2, MINUS, PLUS)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = factor(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_binary_t *e = exp_binary_init(expr, op, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
@@ -314,26 +593,20 @@ exp_t *factor(parser_t *p) {
   exp_t *expr = NULL;
   expr = unary(p);
   while (match(p, 3, SLASH, STAR, MOD)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = unary(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_binary_t *e = exp_binary_init(expr, op, right);
-    expr = exp_init(EXP_BINARY, e);
+    exp_binary_t *e = exp_binary_init(p->arena, expr, op, right);
+    expr = exp_init(p->arena, EXP_BINARY, e);
   }
   return expr;
 }
 
 exp_t *unary(parser_t *p) {
   if (match(p, 2, BANG, MINUS)) {
-    token_t *prev = peek_previous(p);
+    operator_t op = token_to_operator(*peek_previous(p));
     exp_t *right = unary(p);
-    operator_t op = OP_ERROR;
-    if (prev)
-      op = token_to_operator(*prev);
-    exp_unary_t *e = exp_unary_init(op, right);
-    return exp_init(EXP_UNARY, e);
+    exp_unary_t *e = exp_unary_init(p->arena, op, right);
+    return exp_init(p->arena, EXP_UNARY, e);
   }
   return call(p);
 }
@@ -341,58 +614,67 @@ exp_t *unary(parser_t *p) {
 exp_t *call(parser_t *p) {
   if (!match(p, 1, IDENTIFIER))
     return primary(p);
-  char *ide = peek_previous(p)->literal;
-  if (match(p, 1, LEFT_PAREN)) {
-    l_list_t actuals = NULL;
-    while (!check(p, RIGHT_PAREN) && !is_at_end(p)) {
-      exp_t *actual = expression(p);
-      list_add(&actuals, actual);
-      if (check(p, RIGHT_PAREN))
-        break;
-      consume(p, COMMA, "Missing ',' between actuals\n");
-    }
-    consume(p, RIGHT_PAREN, "Missing ')' after actuals\n");
-    exp_call_t *e = exp_call_init(ide, actuals);
-    return exp_init(EXP_CALL, e);
-  }
+  token_t t = *peek_previous(p);
+  if (match(p, 1, LEFT_PAREN))
+    return call_actuals(p, t);
   back(p);
   return primary(p);
 }
 
-exp_t *primary(parser_t *p) {
-  if (match(p, 1, FALSE)) {
-    int *value = mem_calloc(1, sizeof(int));
-    *value = 0;
-    exp_literal_t *e = exp_literal_init(T_BOOLEAN, value);
-    return exp_init(EXP_LITERAL, e);
+exp_t *call_actuals(parser_t *p, token_t t) {
+  l_list_t actuals = NULL;
+  while (!check(p, RIGHT_PAREN) && !is_at_end(p)) {
+    exp_t *actual = expression(p);
+    arena_list_add(p->arena, &actuals, actual);
+    if (check(p, RIGHT_PAREN))
+      break;
+    consume(p, COMMA, "Missing ',' between actuals\n");
   }
-  if (match(p, 1, TRUE)) {
-    int *value = mem_calloc(1, sizeof(int));
-    *value = 1;
-    exp_literal_t *e = exp_literal_init(T_BOOLEAN, value);
-    return exp_init(EXP_LITERAL, e);
+  consume(p, RIGHT_PAREN, "Missing ')' after actuals\n");
+  exp_call_t *e = exp_call_init(p->arena, lexeme(p, t), actuals);
+  return exp_init(p->arena, EXP_CALL, e);
+}
+
+exp_t *primary(parser_t *p) {
+  token_t t = *peek(p);
+  literal_value_t value;
+  literal_type_t type;
+  switch (t.type) {
+  case FALSE:
+  case TRUE:
+    type = T_BOOLEAN;
+    value.boolean = t.type == TRUE;
+    break;
+  case NIL:
+    type = T_NIL;
+    value.string = NULL;
+    break;
+  case NUMBER:
+    type = T_NUMBER;
+    value.number = token_number(p->source, t);
+    break;
+  case STRING:
+    type = T_STRING;
+    value.string = string_literal(p, t);
+    break;
+  case IDENTIFIER: {
+    advance(p);
+    exp_identifier_t *e = exp_identifier_init(p->arena, lexeme(p, t));
+    return exp_init(p->arena, EXP_IDENTIFIER, e);
   }
-  if (match(p, 1, NIL))
-    return exp_init(EXP_LITERAL, exp_literal_init(T_NIL, NULL));
-  if (match(p, 1, NUMBER))
-    return exp_init(EXP_LITERAL,
-                    exp_literal_init(T_NUMBER, peek_previous(p)->literal));
-  if (match(p, 1, STRING))
-    return exp_init(EXP_LITERAL,
-                    exp_literal_init(T_STRING, peek_previous(p)->literal));
-  if (match(p, 1, IDENTIFIER))
-    return exp_init(EXP_IDENTIFIER,
-                    exp_identifier_init((char *)peek_previous(p)->literal));
-  if (match(p, 1, LEFT_PAREN)) {
+  case LEFT_PAREN: {
+    advance(p);
     exp_t *expr = expression(p);
-    if (consume(p, RIGHT_PAREN, "Expected ')' after expression.\n") == NULL)
-      return exp_init(EXP_PANIC_MODE, NULL);
-    exp_grouping_t *e = exp_grouping_init(expr);
-    return exp_init(EXP_GROUPING, e);
+    consume(p, RIGHT_PAREN, "Expected ')' after expression.\n");
+    exp_grouping_t *e = exp_grouping_init(p->arena, expr);
+    return exp_init(p->arena, EXP_GROUPING, e);
   }
-
-  throw_error(p, "Expected expression.\n");
-  return exp_init(EXP_PANIC_MODE, NULL);
+  default:
+    throw_error(p, "Expected expression.\n");
+  }
+  advance(p);
+  exp_literal_t *e = exp_literal_init(p->arena, type, value);
+  return exp_init(p->arena, EXP_LITERAL, e);
 }
 
 void synchronize(parser_t *p) {
@@ -449,16 +731,26 @@ token_t *back(parser_t *p) {
   return old;
 }
 
-token_t *peek(parser_t *p) { return tokens_get(p->tokens, p->current); }
-
-token_t *peek_previous(parser_t *p) {
-  return tokens_get(p->tokens, (p->current) - 1);
+token_t *token_at(parser_t *p, int index) {
+  while (p->input && index >= p->tokens.count) {
+    token_t tok;
+    if (!channel_receive(p->input, &tok))
+      break;
+    tokens_push(&p->tokens, tok);
+  }
+  return tokens_get(&p->tokens, index);
 }
 
-token_t *peek_next(parser_t *p) {
-  return tokens_get(p->tokens, p->current + 1);
+token_t *peek(parser_t *p) {
+  if (p->current < p->tokens.count)
+    return &p->tokens.data[p->current];
+  return token_at(p, p->current);
 }
 
+token_t *peek_previous(parser_t *p) { return token_at(p, p->current - 1); }
+
+token_t *peek_next(parser_t *p) { return token_at(p, p->current + 1); }
+
 token_t *consume(parser_t *p, token_type_t type, char *fmt, ...) {
   if (check(p, type))
     return advance(p);
@@ -472,19 +764,23 @@ token_t *consume(parser_t *p, token_type_t type, char *fmt, ...) {
 void throw_error_formatted(parser_t *p, char *msg, va_list args) {
   p->errors[ERROR]++;
   token_t t = *peek(p);
-  if (t.type == END)
-    err_log(ERROR, "[Line: %d] at end: ", t.line);
-  else
-    err_log(ERROR, "[Line: %d] at '%s': ", t.line, t.lexeme);
-  vdprintf(2, msg, args);
+  FILE *out = p->diagnostics ? p->diagnostics : stderr;
+  if (t.type == END) {
+    p->unexpected_end = 1;
+    err_log_file(out, ERROR, "[Line: %d] at end: ", t.line);
+  } else
+    err_log_file(out, ERROR, "[Line: %d] at '%.*s': ", t.line, t.length,
+                 p->source + t.start);
+  vfprintf(out, msg, args);
   // This will jump to the statement function and notify that an error as
   // occurred
   longjmp(p->checkpoint, 1);
 }
 
-void throw_error(parser_t *p, char *msg) {
-  throw_error_formatted(p, msg, NULL);
-  return;
+void throw_error(parser_t *p, char *msg, ...) {
+  va_list args;
+  va_start(args, msg);
+  throw_error_formatted(p, msg, args);
 }
 
 int is_at_end(parser_t *p) { return peek(p)->type == END; }
@@ -494,12 +790,20 @@ stmt_t *statement(parser_t *p) {
   // if an expression throw an error then a synchronize procedure is called
   // and the parser will continue to parse other statements in order to give an
   // accurate error reports
-  int jmp = setjmp(p->checkpoint);
-  if (jmp) {
+  // The enclosing checkpoint is restored on the way out, otherwise a later
+  // error would jump inside the frame of an already returned statement
+  jmp_buf enclosing;
+  memcpy(enclosing, p->checkpoint, sizeof(jmp_buf));
+  stmt_t *s = NULL;
+  if (setjmp(p->checkpoint))
     synchronize(p);
-    // TODO: check if id correct return NULL instead of a panic statement
-    return NULL;
-  }
+  else
+    s = dispatch_statement(p);
+  memcpy(p->checkpoint, enclosing, sizeof(jmp_buf));
+  return s;
+}
+
+stmt_t *dispatch_statement(parser_t *p) {
   if (match(p, 1, VAR))
     return stmt_declaration(p);
   if (match(p, 1, FUN))
@@ -519,83 +823,168 @@ stmt_t *statement(parser_t *p) {
 
 stmt_t *stmt_expr(parser_t *p) {
   exp_t *exp = expression(p);
-  token_t *t = consume(p, SEMICOLON, "Expected ';' after expression\n");
-  stmt_expr_t *s = stmt_expr_init(exp);
-  return stmt_init(STMT_EXPR, s, t->line);
+  token_t t = *consume(p, SEMICOLON, "Expected ';' after expression\n");
+  stmt_expr_t *s = stmt_expr_init(p->arena, exp);
+  return stmt_init(p->arena, STMT_EXPR, s, t.line);
 }
 
 stmt_t *stmt_print(parser_t *p) {
   exp_t *value = expression(p);
-  token_t *t = consume(p, SEMICOLON, "Expected ';' after value\n");
-  stmt_print_t *s = stmt_print_init(value);
-  return stmt_init(STMT_PRINT, s, t->line);
+  token_t t = *consume(p, SEMICOLON, "Expected ';' after value\n");
+  stmt_print_t *s = stmt_print_init(p->arena, value);
+  return stmt_init(p->arena, STMT_PRINT, s, t.line);
 }
 
 stmt_t *stmt_condition(parser_t *p) {
-  token_t *t = consume(p, LEFT_PAREN, "Expected '(' after if\n");
+  consume(p, LEFT_PAREN, "Expected '(' after if\n");
   exp_t *cond = expression(p);
-  t = consume(p, RIGHT_PAREN, "Expected ')' after condition");
+  token_t t = *consume(p, RIGHT_PAREN, "Expected ')' after condition");
   stmt_t *then_branch = statement(p);
   stmt_t *else_branch = NULL;
   if (match(p, 1, ELSE))
     else_branch = statement(p);
-  stmt_conditional_t *s = stmt_conditional_init(cond, then_branch, else_branch);
-  return stmt_init(STMT_IF, s, t->line);
+  stmt_conditional_t *s =
+      stmt_conditional_init(p->arena, cond, then_branch, else_branch);
+  return stmt_init(p->arena, STMT_IF, s, t.line);
 }
 
 stmt_t *stmt_block(parser_t *p) {
   l_list_t statements = NULL;
   while (!check(p, RIGHT_BRACE) && !is_at_end(p)) {
-    list_add(&statements, statement(p));
+    arena_list_add(p->arena, &statements, statement(p));
   }
-  token_t *t = consume(p, RIGHT_BRACE, "Missing '}' after opening a block\n");
+  token_t t = *consume(p, RIGHT_BRACE, "Missing '}' after opening a block\n");
   list_reverse_in_place(&statements);
-  stmt_block_t *s = stmt_block_init(statements);
-  return stmt_init(STMT_BLOCK, s, t->line);
+  stmt_block_t *s = stmt_block_init(p->arena, statements);
+  return stmt_init(p->arena, STMT_BLOCK, s, t.line);
 }
 
 stmt_t *stmt_declaration(parser_t *p) {
-  token_t *t =
-      consume(p, IDENTIFIER, "Missing identifier after a declaration\n");
+  token_t t =
+      *consume(p, IDENTIFIER, "Missing identifier after a declaration\n");
   consume(p, EQUAL, "Missing '=' after declaration\n");
   exp_t *e = expression(p);
   consume(p, SEMICOLON, "Expected ';' after value\n");
-  stmt_declaration_t *s = stmt_declaration_init(t->literal, e);
-  return stmt_init(STMT_DECLARATION, s, t->line);
+  stmt_declaration_t *s = stmt_declaration_init(p->arena, lexeme(p, t), e);
+  return stmt_init(p->arena, STMT_DECLARATION, s, t.line);
 }
 
 stmt_t *stmt_assignment(parser_t *p) {
-  char *ide = advance(p)->literal;
-  token_t *t =
-      consume(p, EQUAL,
-              "Missing '=' between identifier and expression in assignment\n");
+  token_t ide = *advance(p);
+  token_t t =
+      *consume(p, EQUAL,
+               "Missing '=' between identifier and expression in assignment\n");
   exp_t *e = expression(p);
   consume(p, SEMICOLON, "Missing ';' after assignment\n");
-  stmt_assignment_t *s = stmt_assignment_init(ide, e);
-  return stmt_init(STMT_ASSIGNMENT, s, t->line);
+  stmt_assignment_t *s = stmt_assignment_init(p->arena, lexeme(p, ide), e);
+  return stmt_init(p->arena, STMT_ASSIGNMENT, s, t.line);
 }
 
 stmt_t *stmt_function_declaration(parser_t *p) {
-  token_t *t = consume(p, IDENTIFIER, "Functions must have a name\n");
+  token_t t = *consume(p, IDENTIFIER, "Functions must have a name\n");
   l_list_t formals = NULL;
   consume(p, LEFT_PAREN, "Missing '(' after function name\n");
   while (!check(p, RIGHT_PAREN) && !is_at_end(p)) {
     if (match(p, 1, IDENTIFIER)) {
-      list_add(&formals, strdup(peek_previous(p)->literal));
+      arena_list_add(p->arena, &formals, lexeme(p, *peek_previous(p)));
     }
     if (check(p, RIGHT_PAREN))
       break;
     consume(p, COMMA, "Missing ',' between formals\n");
   }
   consume(p, RIGHT_PAREN, "Missing ')' after formals\n");
-  stmt_t *body = statement(p);
-  stmt_function_t *s = stmt_function_init(t->literal, formals, body);
-  return stmt_init(STMT_FUN, s, t->line);
+  stmt_t *body = NULL;
+  if (p->lazy && p->input == NULL && check(p, LEFT_BRACE))
+    body = skip_body(p);
+  if (body == NULL)
+    body = statement(p);
+  stmt_function_t *s =
+      stmt_function_init(p->arena, lexeme(p, t), formals, body);
+  return stmt_init(p->arena, STMT_FUN, s, t.line);
 }
 
 stmt_t *stmt_return(parser_t *p) {
   exp_t *exp = expression(p);
-  stmt_expr_t *s = stmt_expr_init(exp);
-  token_t *t = consume(p, SEMICOLON, "Missing ';' after return\n");
-  return stmt_init(STMT_RETURN, s, t->line);
+  stmt_expr_t *s = stmt_expr_init(p->arena, exp);
+  token_t t = *consume(p, SEMICOLON, "Missing ';' after return\n");
+  return stmt_init(p->arena, STMT_RETURN, s, t.line);
+}
+
+stmt_t *skip_body(parser_t *p) {
+  int depth = 0;
+  for (int k = p->current; k < p->tokens.count; k++) {
+    token_type_t type = p->tokens.data[k].type;
+    if (type == LEFT_BRACE) {
+      depth++;
+    } else if (type == RIGHT_BRACE && --depth == 0) {
+      stmt_lazy_t *l = stmt_lazy_init(p->arena, p, p->current);
+      arena_list_add(p->arena, &p->lazy_bodies, l);
+      int line = peek(p)->line;
+      p->current = k + 1;
+      return stmt_init(p->arena, STMT_LAZY, l, line);
+    }
+  }
+  return NULL;
+}
+
+char *lexeme(parser_t *p, token_t t) {
+  return arena_strndup(p->arena, p->source + t.start, t.length);
+}
+
+char *string_literal(parser_t *p, token_t t) {
+  // Skip the opening and closing '"'
+  return arena_strndup(p->arena, p->source + t.start + 1, t.length - 2);
+}
+
+int split_chunks(token_vector_t tokens, int target, int *starts) {
+  int size = tokens.count / target;
+  int count = 0;
+  int depth = 0;
+  starts[count++] = 0;
+  for (int i = 1; i < tokens.count - 1 && count < target; i++) {
+    token_type_t previous = tokens.data[i - 1].type;
+    if (previous == LEFT_BRACE || previous == LEFT_PAREN)
+      depth++;
+    else if (previous == RIGHT_BRACE || previous == RIGHT_PAREN)
+      depth--;
+    token_type_t type = tokens.data[i].type;
+    if (depth == 0 && i - starts[count - 1] >= size &&
+        (type == FUN || type == VAR) &&
+        (previous == SEMICOLON || previous == RIGHT_BRACE))
+      starts[count++] = i;
+  }
+  starts[count] = tokens.count - 1;
+  return count;
+}
+
+void chunk_init(parse_chunk_t *chunk, parser_t *p, int start, int end) {
+  token_vector_t tokens;
+  tokens.count = end - start + 1;
+  tokens.capacity = tokens.count;
+  tokens.data = mem_calloc(tokens.capacity, sizeof(token_t));
+  memcpy(tokens.data, p->tokens.data + start, (end - start) * sizeof(token_t));
+  // The first token of the next chunk becomes the END of this one
+  tokens.data[end - start] = p->tokens.data[end];
+  tokens.data[end - start].type = END;
+  arena_init(&chunk->arena);
+  parser_init(&chunk->parser, tokens, p->source, &chunk->arena);
+  chunk->parser.descent = p->descent;
+  chunk->statements = NULL;
+  chunk->diagnostics = NULL;
+  chunk->diagnostics_size = 0;
+  chunk->parser.diagnostics =
+      open_memstream(&chunk->diagnostics, &chunk->diagnostics_size);
+  return;
+}
+
+void *parse_worker(void *args) {
+  parse_pool_t *pool = args;
+  int k;
+  while ((k = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+    parse_chunk_t *chunk = &pool->chunks[k];
+    chunk->statements = parser_parse(&chunk->parser);
+    fclose(chunk->parser.diagnostics);
+    chunk->parser.diagnostics = NULL;
+  }
+  return NULL;
 }
@@ -1,23 +1,85 @@
 #ifndef PARSER_H
 #define PARSER_H
+#include "arena.h"
 #include "errors.h"
 #include "list.h"
 #include "syntax.h"
+#include "thread.h"
+#include "token.h"
 #include <setjmp.h>
+#include <stdio.h>
 
+/**
+ * @param source the source code the tokens belong to
+ * @param tokens the tokens received so far
+ * @param arena the arena owning every node of the produced AST
+ * @param input when not NULL the tokens are received lazily from this channel
+ * @param output when not NULL the top level statements are sent on this
+ * channel (as soon as they are parsed) instead of being returned
+ * @param diagnostics when not NULL the errors are written here instead of
+ * stderr
+ * @param unexpected_end 1 if an error was raised at the END token
+ * @param descent 1 to parse the expressions by recursive descent (one
+ * function per precedence level) instead of the Pratt parser, both build the
+ * same trees
+ * @param lazy 1 to skip the bodies between braces of the functions, they are
+ * parsed on their first call (see parser_parse_lazy)
+ * @param lazy_bodies the stmt_lazy_t of the skipped bodies
+ */
 typedef struct {
-  l_list_t tokens;
+  const char *source;
+  token_vector_t tokens;
+  arena_t *arena;
+  channel_t *input;
+  channel_t *output;
   int current;
   int errors[LOG_LEVELS];
+  FILE *diagnostics;
+  int unexpected_end;
+  int descent;
+  int lazy;
+  l_list_t lazy_bodies;
   jmp_buf checkpoint;
 } parser_t;
 
-void parser_init(parser_t *, l_list_t tokens);
+void parser_init(parser_t *, token_vector_t tokens, const char *source,
+                 arena_t *arena);
+
+void parser_init_streaming(parser_t *, const char *source, arena_t *arena,
+                           channel_t *input, channel_t *output);
 
 void parser_destroy(parser_t);
 
 l_list_t parser_parse(parser_t *);
 
+/**
+ * Parse the tokens splitting them at top level statements boundaries, the
+ * chunks are parsed concurrently and their statements joined in source order
+ * @param p a pointer to the parser
+ * @param jobs the number of threads to use
+ * @return the list of top level statements
+ * @note The errors are reported exactly as parser_parse would do, small
+ * sources and streaming parsers are parsed sequentially
+ */
+l_list_t parser_parse_parallel(parser_t *, int jobs);
+
+/**
+ * Parse a function body skipped by a lazy parser
+ * @param l a pointer to the skipped body
+ * @return a pointer to the body, NULL if it has syntax errors (they are
+ * reported as usual)
+ * @note The parser and its tokens must be alive, the body is parsed only the
+ * first time
+ */
+stmt_t *parser_parse_lazy(stmt_lazy_t *);
+
+/**
+ * Parse every function body skipped so far, the nested ones too
+ * @param p a pointer to the lazy parser
+ * @note Used to report the syntax errors of the functions never called
+ */
+void parser_parse_lazy_all(parser_t *);
+
 void parser_errors_report(parser_t);
 
 int parser_had_errors(parser_t);
@@ -0,0 +1,238 @@
+#include "purity.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <string.h>
+
+/**
+ * Count the bindings of a statement and collect its function declarations,
+ * the nested ones included
+ * @param p a pointer to the analysis
+ * @param s a pointer to the statement
+ * @param top 1 if the statement is a top level one
+ */
+static void collect(purity_t *, stmt_t *, int);
+/**
+ * Check if a function is pure, assuming the functions still marked pure are
+ * @param p a pointer to the analysis
+ * @param fun a pointer to the function declaration
+ * @return 1 if the function is pure, 0 otherwise
+ */
+static int check_function(purity_t *, stmt_function_t *);
+/**
+ * Check if a statement of a function body is pure, the bindings it makes are
+ * added to the scope
+ * @param p a pointer to the analysis
+ * @param s a pointer to the statement
+ * @return 1 if the statement is pure, 0 otherwise
+ */
+static int check_stmt(purity_t *, stmt_t *);
+/**
+ * Check if an expression of a function body is pure
+ * @param p a pointer to the analysis
+ * @param e a pointer to the expression
+ * @return 1 if the expression is pure, 0 otherwise
+ */
+static int check_exp(purity_t *, exp_t *);
+/**
+ * Add a symbol to the scope
+ * @param p a pointer to the analysis
+ * @param symbol the symbol
+ */
+static void bind(purity_t *, uint32_t);
+/**
+ * Remove the symbols added to the scope after a given point
+ * @param p a pointer to the analysis
+ * @param count the number of symbols the scope keeps
+ */
+static void unbind(purity_t *, uint32_t);
+
+void purity_init(purity_t *p, uint32_t symbols_count) {
+  memset(p, 0, sizeof(purity_t));
+  p->symbols_count = symbols_count;
+  p->bindings = mem_calloc(symbols_count, sizeof(uint32_t));
+  p->top_level = mem_calloc(symbols_count, sizeof(stmt_function_t *));
+  p->bound = mem_calloc(symbols_count, sizeof(uint32_t));
+  return;
+}
+
+void purity_analyze(purity_t *p, l_list_t statements) {
+  for (l_list_t current = statements; current; current = current->next)
+    collect(p, current->data, 1);
+  // The largest set of functions that call only functions of the set: every
+  // function is assumed pure until a check fails, which may fail its callers
+  for (uint32_t k = 0; k < p->functions_count; k++)
+    p->functions[k]->pure = 1;
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (uint32_t k = 0; k < p->functions_count; k++) {
+      stmt_function_t *fun = p->functions[k];
+      if (fun->pure && !check_function(p, fun)) {
+        fun->pure = 0;
+        changed = 1;
+      }
+    }
+  }
+  for (uint32_t k = 0; k < p->functions_count; k++)
+    p->pure += p->functions[k]->pure;
+  return;
+}
+
+void purity_destroy(purity_t *p) {
+  mem_free(p->bindings);
+  mem_free(p->top_level);
+  mem_free(p->functions);
+  mem_free(p->scope);
+  mem_free(p->bound);
+  return;
+}
+
+void collect(purity_t *p, stmt_t *s, int top) {
+  switch (s->type) {
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    p->bindings[fun->symbol]++;
+    if (top)
+      p->top_level[fun->symbol] = fun;
+    for (uint32_t k = 0; k < fun->arity; k++)
+      p->bindings[fun->symbols[k]]++;
+    p->functions = mem_reserve(p->functions, &p->functions_capacity,
+                               p->functions_count + 1,
+                               sizeof(stmt_function_t *));
+    p->functions[p->functions_count++] = fun;
+    collect(p, fun->body, 0);
+    break;
+  }
+  case STMT_DECLARATION:
+  case STMT_ASSIGNMENT:
+    p->bindings[((stmt_declaration_t *)stmt_unwrap(s))->symbol]++;
+    break;
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    collect(p, c->then_branch, 0);
+    if (c->else_branch)
+      collect(p, c->else_branch, 0);
+    break;
+  }
+  case STMT_BLOCK:
+    for (l_list_t current = ((stmt_block_t *)stmt_unwrap(s))->statements;
+         current; current = current->next)
+      collect(p, current->data, 0);
+    break;
+  case STMT_LAZY: {
+    stmt_lazy_t *lazy = stmt_unwrap(s);
+    if (lazy->body)
+      collect(p, lazy->body, 0);
+    break;
+  }
+  default:
+    break;
+  }
+  return;
+}
+
+int check_function(purity_t *p, stmt_function_t *fun) {
+  stmt_t *body = fun->body;
+  if (body->type == STMT_LAZY)
+    body = ((stmt_lazy_t *)stmt_unwrap(body))->body;
+  // A body with syntax errors is reported when called
+  if (body == NULL)
+    return 0;
+  for (uint32_t k = 0; k < fun->arity; k++)
+    bind(p, fun->symbols[k]);
+  int pure = check_stmt(p, body);
+  unbind(p, 0);
+  return pure;
+}
+
+int check_stmt(purity_t *p, stmt_t *s) {
+  uint32_t scope = p->scope_count;
+  int pure = 1;
+  switch (s->type) {
+  case STMT_PRINT:
+    return 0;
+  case STMT_EXPR:
+  case STMT_RETURN:
+    return check_exp(p, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+  case STMT_DECLARATION: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    if (!check_exp(p, d->exp))
+      return 0;
+    bind(p, d->symbol);
+    return 1;
+  }
+  case STMT_ASSIGNMENT: {
+    // Assigning a name the function did not bind changes a binding of a
+    // caller
+    stmt_assignment_t *a = stmt_unwrap(s);
+    return p->bound[a->symbol] && check_exp(p, a->exp);
+  }
+  case STMT_FUN:
+    // The body runs only when the closure is called, and a call to a name
+    // bound by the function is never pure
+    bind(p, ((stmt_function_t *)stmt_unwrap(s))->symbol);
+    return 1;
+  case STMT_IF: {
+    // A binding made by a branch may not exist after the condition
+    stmt_conditional_t *c = stmt_unwrap(s);
+    pure = check_exp(p, c->condition) && check_stmt(p, c->then_branch);
+    unbind(p, scope);
+    if (pure && c->else_branch)
+      pure = check_stmt(p, c->else_branch);
+    break;
+  }
+  case STMT_BLOCK:
+    for (l_list_t current = ((stmt_block_t *)stmt_unwrap(s))->statements;
+         current && pure; current = current->next)
+      pure = check_stmt(p, current->data);
+    break;
+  default:
+    return 0;
+  }
+  unbind(p, scope);
+  return pure;
+}
+
+int check_exp(purity_t *p, exp_t *e) {
+  switch (e->type) {
+  case EXP_LITERAL:
+    return 1;
+  case EXP_IDENTIFIER:
+    // A name the function did not bind is read from a caller
+    return p->bound[((exp_identifier_t *)exp_unwrap(e))->symbol] != 0;
+  case EXP_GROUPING:
+    return check_exp(p, ((exp_grouping_t *)exp_unwrap(e))->exp);
+  case EXP_UNARY:
+    return check_exp(p, ((exp_unary_t *)exp_unwrap(e))->right);
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    return check_exp(p, b->left) && check_exp(p, b->right);
+  }
+  case EXP_CALL: {
+    exp_call_t *call = exp_unwrap(e);
+    for (l_list_t actual = call->actuals; actual; actual = actual->next)
+      if (!check_exp(p, actual->data))
+        return 0;
+    stmt_function_t *callee = p->top_level[call->symbol];
+    return !p->bound[call->symbol] && p->bindings[call->symbol] == 1 &&
+           callee && callee->pure;
+  }
+  default:
+    return 0;
+  }
+}
+
+void bind(purity_t *p, uint32_t symbol) {
+  p->scope = mem_reserve(p->scope, &p->scope_capacity, p->scope_count + 1,
+                         sizeof(uint32_t));
+  p->scope[p->scope_count++] = symbol;
+  p->bound[symbol]++;
+  return;
+}
+
+void unbind(purity_t *p, uint32_t count) {
+  while (p->scope_count > count)
+    p->bound[p->scope[--p->scope_count]]--;
+  return;
+}
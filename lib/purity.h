@@ -0,0 +1,60 @@
+#ifndef PURITY_H
+#define PURITY_H
+#include "list.h"
+#include "syntax.h"
+#include <stdint.h>
+
+/**
+ * The analysis run after the optimizer marking the pure functions, whose
+ * result depends only on their actuals so that their calls can be memoized.
+ * The identifiers are dynamically scoped, so a pure function prints nothing,
+ * reads and assigns only its formals and the bindings it made itself, and
+ * calls only pure functions whose name is bound by a top level fun and by
+ * nothing else in the whole program (any binding of the name is then a
+ * closure of that function)
+ * @param bindings the number of lets, funs, formals and assignments binding
+ * every symbol
+ * @param top_level the top level function binding every symbol, NULL if none
+ * @param symbols_count the number of symbols
+ * @param functions the function declarations of the program
+ * @param functions_count the number of function declarations
+ * @param scope the symbols bound in the body being checked, in binding order
+ * @param bound the number of times every symbol appears in the scope
+ * @param pure the number of functions proven pure
+ */
+typedef struct {
+  uint32_t *bindings;
+  stmt_function_t **top_level;
+  uint32_t symbols_count;
+  stmt_function_t **functions;
+  uint32_t functions_count;
+  uint32_t functions_capacity;
+  uint32_t *scope;
+  uint32_t scope_count;
+  uint32_t scope_capacity;
+  uint32_t *bound;
+  uint32_t pure;
+} purity_t;
+
+/**
+ * Initialize the given analysis
+ * @param p a pointer to the analysis to initialize
+ * @param symbols_count the number of symbols assigned by the resolver
+ */
+void purity_init(purity_t *, uint32_t);
+
+/**
+ * Mark the pure functions of a whole program, every function body must be
+ * parsed and resolved
+ * @param p a pointer to the analysis
+ * @param statements the top level statements of the program
+ */
+void purity_analyze(purity_t *, l_list_t);
+
+/**
+ * Destroy the given analysis, the marks stay in the functions
+ * @param p a pointer to the analysis to destroy
+ */
+void purity_destroy(purity_t *);
+
+#endif // !PURITY_H
@@ -0,0 +1,340 @@
+#include "resolver.h"
+#include "errors.h"
+#include "flat.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <string.h>
+
+#define RESOLVER_INITIAL_CAPACITY 256
+
+/**
+ * Hash a name
+ * @param name the name
+ * @return the FNV-1a hash of the name
+ */
+static uint32_t hash(const char *);
+/**
+ * Get the symbol of a name bound by a let, a fun or a formal
+ * @param r a pointer to the resolver
+ * @param name the name
+ * @return the symbol
+ */
+static uint32_t declare(resolver_t *, const char *);
+/**
+ * Get the symbol of a name read by an expression
+ * @param r a pointer to the resolver
+ * @param name the name
+ * @return the symbol
+ */
+static uint32_t use(resolver_t *, const char *);
+/**
+ * Resolve an expression
+ * @param r a pointer to the resolver
+ * @param e a pointer to the expression
+ */
+static void resolve_exp(resolver_t *, exp_t *);
+/**
+ * Resolve a function declaration, its body is skipped if not parsed yet
+ * @param r a pointer to the resolver
+ * @param fun a pointer to the function declaration
+ */
+static void resolve_function(resolver_t *, stmt_function_t *);
+/**
+ * Map a name of the flat AST to its symbol
+ * @param r a pointer to the resolver
+ * @param f a pointer to the flat AST
+ * @param offset the offset of the name
+ */
+static void resolve_name(resolver_t *, flat_ast_t *, uint32_t);
+/**
+ * Mark the calls in tail position of a statement of a function body: the
+ * returned ones and, if the statement ends the body, the last one evaluated
+ * @param s a pointer to the statement
+ * @param last 1 if the value of the statement is the result of the body
+ */
+static void mark_tail(stmt_t *, int);
+/**
+ * Mark the call whose result is the value of an expression, if any
+ * @param e a pointer to the expression
+ */
+static void mark_tail_exp(exp_t *);
+
+void resolver_init(resolver_t *r) {
+  memset(r, 0, sizeof(resolver_t));
+  return;
+}
+
+void resolver_resolve(resolver_t *r, l_list_t statements) {
+  for (l_list_t current = statements; current; current = current->next)
+    resolver_resolve_statement(r, current->data);
+  return;
+}
+
+void resolver_resolve_statement(resolver_t *r, stmt_t *s) {
+  r->line = s->line;
+  switch (s->type) {
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    resolve_exp(r, c->condition);
+    resolver_resolve_statement(r, c->then_branch);
+    if (c->else_branch)
+      resolver_resolve_statement(r, c->else_branch);
+    break;
+  }
+  case STMT_FUN:
+    resolve_function(r, stmt_unwrap(s));
+    break;
+  case STMT_PRINT:
+  case STMT_EXPR:
+  case STMT_RETURN:
+    // stmt_expr_t and stmt_print_t share the same layout
+    resolve_exp(r, ((stmt_expr_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_BLOCK:
+    resolver_resolve(r, ((stmt_block_t *)stmt_unwrap(s))->statements);
+    break;
+  case STMT_DECLARATION: {
+    stmt_declaration_t *d = stmt_unwrap(s);
+    resolve_exp(r, d->exp);
+    d->symbol = declare(r, d->identifier);
+    break;
+  }
+  case STMT_ASSIGNMENT: {
+    // Assigning an identifier never bound does nothing, it is not an error
+    stmt_assignment_t *a = stmt_unwrap(s);
+    resolve_exp(r, a->exp);
+    a->symbol = resolver_symbol(r, a->identifier);
+    break;
+  }
+  case STMT_LAZY: {
+    stmt_lazy_t *lazy = stmt_unwrap(s);
+    if (lazy->body)
+      resolver_resolve_statement(r, lazy->body);
+    break;
+  }
+  default:
+    break;
+  }
+  return;
+}
+
+void resolver_resolve_body(resolver_t *r, stmt_t *body) {
+  resolver_resolve_statement(r, body);
+  mark_tail(body, 1);
+  return;
+}
+
+void resolver_resolve_flat(resolver_t *r, flat_ast_t *f) {
+  r->flat = mem_reserve(r->flat, &r->flat_capacity, f->chars_count,
+                        sizeof(uint32_t));
+  for (; r->flat_nodes < f->nodes_count; r->flat_nodes++) {
+    flat_node_t *n = &f->nodes[r->flat_nodes];
+    switch (n->kind) {
+    case FLAT_IDENTIFIER:
+      resolve_name(r, f, n->as.name);
+      break;
+    case FLAT_CALL:
+      resolve_name(r, f, n->as.call.name);
+      break;
+    case FLAT_DECLARATION:
+    case FLAT_ASSIGNMENT:
+      resolve_name(r, f, n->as.binding.name);
+      break;
+    case FLAT_FUN: {
+      resolve_name(r, f, n->as.function.name);
+      flat_index_t *formals = &f->lists[n->as.function.formals];
+      for (uint32_t k = 1; k <= formals[0]; k++)
+        resolve_name(r, f, formals[k]);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return;
+}
+
+int resolver_check(resolver_t *r) {
+  int errors = 0;
+  for (uint32_t k = 0; k < r->names_count; k++)
+    if (r->used[k] && !r->declared[k]) {
+      err_log(ERROR, "[Line: %d] The identifier '%s' was not declared\n",
+              r->used[k], r->names[k]);
+      errors++;
+    }
+  return errors;
+}
+
+uint32_t resolver_symbol(resolver_t *r, const char *name) {
+  // Kept at most half full
+  if (2 * (r->names_count + 1) > r->buckets_capacity) {
+    uint32_t capacity = r->buckets_capacity ? 2 * r->buckets_capacity
+                                            : RESOLVER_INITIAL_CAPACITY;
+    uint32_t *buckets = mem_calloc(capacity, sizeof(uint32_t));
+    for (uint32_t k = 0; k < r->names_count; k++) {
+      uint32_t h = hash(r->names[k]) & (capacity - 1);
+      while (buckets[h])
+        h = (h + 1) & (capacity - 1);
+      buckets[h] = k + 1;
+    }
+    mem_free(r->buckets);
+    r->buckets = buckets;
+    r->buckets_capacity = capacity;
+  }
+  // Buckets hold the symbol plus one, zero is an empty bucket
+  uint32_t h = hash(name) & (r->buckets_capacity - 1);
+  while (r->buckets[h]) {
+    if (strcmp(r->names[r->buckets[h] - 1], name) == 0)
+      return r->buckets[h] - 1;
+    h = (h + 1) & (r->buckets_capacity - 1);
+  }
+  uint32_t capacity = r->names_capacity;
+  r->names = mem_reserve(r->names, &r->names_capacity, r->names_count + 1,
+                         sizeof(char *));
+  if (capacity != r->names_capacity) {
+    r->declared = mem_realloc(r->declared, r->names_capacity);
+    r->used = mem_realloc(r->used, r->names_capacity * sizeof(int));
+  }
+  r->names[r->names_count] = strdup(name);
+  r->declared[r->names_count] = 0;
+  r->used[r->names_count] = 0;
+  r->buckets[h] = r->names_count + 1;
+  return r->names_count++;
+}
+
+void resolver_destroy(resolver_t *r) {
+  for (uint32_t k = 0; k < r->names_count; k++)
+    mem_free(r->names[k]);
+  mem_free(r->names);
+  mem_free(r->buckets);
+  mem_free(r->declared);
+  mem_free(r->used);
+  mem_free(r->flat);
+  memset(r, 0, sizeof(resolver_t));
+  return;
+}
+
+uint32_t declare(resolver_t *r, const char *name) {
+  uint32_t symbol = resolver_symbol(r, name);
+  r->declared[symbol] = 1;
+  return symbol;
+}
+
+uint32_t use(resolver_t *r, const char *name) {
+  uint32_t symbol = resolver_symbol(r, name);
+  if (r->used[symbol] == 0)
+    r->used[symbol] = r->line;
+  return symbol;
+}
+
+void resolve_exp(resolver_t *r, exp_t *e) {
+  switch (e->type) {
+  case EXP_UNARY:
+    resolve_exp(r, ((exp_unary_t *)exp_unwrap(e))->right);
+    break;
+  case EXP_BINARY: {
+    exp_binary_t *b = exp_unwrap(e);
+    resolve_exp(r, b->left);
+    resolve_exp(r, b->right);
+    break;
+  }
+  case EXP_GROUPING:
+    resolve_exp(r, ((exp_grouping_t *)exp_unwrap(e))->exp);
+    break;
+  case EXP_IDENTIFIER: {
+    exp_identifier_t *identifier = exp_unwrap(e);
+    identifier->symbol = use(r, identifier->identifier);
+    break;
+  }
+  case EXP_CALL: {
+    exp_call_t *call = exp_unwrap(e);
+    for (l_list_t actual = call->actuals; actual; actual = actual->next)
+      resolve_exp(r, actual->data);
+    call->symbol = use(r, call->identifier);
+    break;
+  }
+  default:
+    break;
+  }
+  return;
+}
+
+void resolve_function(resolver_t *r, stmt_function_t *fun) {
+  fun->symbol = declare(r, fun->identifier);
+  uint32_t k = 0;
+  for (l_list_t formal = fun->formals; formal; formal = formal->next)
+    fun->symbols[k++] = declare(r, formal->data);
+  int line = r->line;
+  resolver_resolve_body(r, fun->body);
+  r->line = line;
+  return;
+}
+
+void resolve_name(resolver_t *r, flat_ast_t *f, uint32_t offset) {
+  r->flat[offset] = resolver_symbol(r, f->chars + offset);
+  return;
+}
+
+void mark_tail(stmt_t *s, int last) {
+  switch (s->type) {
+  case STMT_RETURN:
+    mark_tail_exp(((stmt_expr_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_EXPR:
+    if (last)
+      mark_tail_exp(((stmt_expr_t *)stmt_unwrap(s))->exp);
+    break;
+  case STMT_IF: {
+    stmt_conditional_t *c = stmt_unwrap(s);
+    mark_tail(c->then_branch, last);
+    if (c->else_branch)
+      mark_tail(c->else_branch, last);
+    break;
+  }
+  case STMT_BLOCK:
+    for (l_list_t current = ((stmt_block_t *)stmt_unwrap(s))->statements;
+         current; current = current->next)
+      mark_tail(current->data, last && current->next == NULL);
+    break;
+  case STMT_LAZY: {
+    // A body parsed lazily is marked when it is resolved
+    stmt_lazy_t *lazy = stmt_unwrap(s);
+    if (lazy->body)
+      mark_tail(lazy->body, last);
+    break;
+  }
+  default:
+    // The body of a nested function is marked with its declaration
+    break;
+  }
+  return;
+}
+
+void mark_tail_exp(exp_t *e) {
+  switch (e->type) {
+  case EXP_GROUPING:
+    mark_tail_exp(((exp_grouping_t *)exp_unwrap(e))->exp);
+    break;
+  case EXP_BINARY: {
+    // The right side of a forwarding is the call receiving the left one
+    exp_binary_t *b = exp_unwrap(e);
+    if (b->op == OP_FORWARD)
+      mark_tail_exp(b->right);
+    break;
+  }
+  case EXP_CALL:
+    ((exp_call_t *)exp_unwrap(e))->tail = 1;
+    break;
+  default:
+    break;
+  }
+  return;
+}
+
+uint32_t hash(const char *name) {
+  uint32_t h = 2166136261u;
+  for (; *name; name++)
+    h = (h ^ (unsigned char)*name) * 16777619u;
+  return h;
+}
@@ -0,0 +1,92 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+#include "flat.h"
+#include "list.h"
+#include "syntax.h"
+#include <stdint.h>
+
+/**
+ * The pass run between the parser and the engines assigning every identifier
+ * a symbol, the index of its slot in the environment. The identifiers are
+ * dynamically scoped, so a symbol names every binding of an identifier and
+ * the engines never compare names while running
+ * @param names the name of every symbol (owned)
+ * @param buckets an open addressing index of the names
+ * @param declared 1 for the symbols bound somewhere (let, fun or formal)
+ * @param used the line of the first read of every symbol, 0 if none
+ * @param flat the symbol of every name of the flat AST, by offset
+ * @param flat_nodes the number of nodes of the flat AST already resolved
+ * @param line the line of the statement being resolved
+ */
+typedef struct {
+  char **names;
+  uint32_t names_count;
+  uint32_t names_capacity;
+  uint32_t *buckets;
+  uint32_t buckets_capacity;
+  uint8_t *declared;
+  int *used;
+  uint32_t *flat;
+  uint32_t flat_capacity;
+  uint32_t flat_nodes;
+  int line;
+} resolver_t;
+
+/**
+ * Initialize the given resolver
+ * @param r a pointer to the resolver to initialize
+ */
+void resolver_init(resolver_t *);
+
+/**
+ * Resolve the given statements, and the function bodies already parsed
+ * @param r a pointer to the resolver
+ * @param statements a list of statements
+ */
+void resolver_resolve(resolver_t *, l_list_t);
+
+/**
+ * Resolve a single statement
+ * @param r a pointer to the resolver
+ * @param s a pointer to the statement
+ */
+void resolver_resolve_statement(resolver_t *, stmt_t *);
+
+/**
+ * Resolve a function body, marking its calls in tail position
+ * @param r a pointer to the resolver
+ * @param body a pointer to the body
+ */
+void resolver_resolve_body(resolver_t *, stmt_t *);
+
+/**
+ * Resolve the names of the nodes appended to a flat AST since the last call,
+ * the flat AST itself is left untouched (it can be mapped read-only)
+ * @param r a pointer to the resolver
+ * @param f a pointer to the flat AST
+ */
+void resolver_resolve_flat(resolver_t *, flat_ast_t *);
+
+/**
+ * Report the identifiers read but bound nowhere in the resolved program
+ * @param r a pointer to the resolver
+ * @return the number of errors
+ * @note Meaningful only once the whole program has been resolved
+ */
+int resolver_check(resolver_t *);
+
+/**
+ * Get the symbol of a name, assigning a new one if needed
+ * @param r a pointer to the resolver
+ * @param name the name
+ * @return the symbol
+ */
+uint32_t resolver_symbol(resolver_t *, const char *);
+
+/**
+ * Destroy the given resolver
+ * @param r a pointer to the resolver to destroy
+ */
+void resolver_destroy(resolver_t *);
+
+#endif // !RESOLVER_H
@@ -0,0 +1,167 @@
+#include "runtime.h"
+#include "errors.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LT_TRAIL_INITIAL 256
+// Room for LT_STACK_SIZE nested calls of the emitted C functions
+#define LT_THREAD_STACK (1024UL * 1024 * 1024)
+
+/**
+ * Run the program of the runtime thread
+ * @param args unused
+ * @return NULL
+ */
+static void *lt_thread(void *);
+
+lt_value_t *lt_values = NULL;
+lt_binding_t *lt_trail = NULL;
+uint32_t lt_trail_count = 0;
+uint32_t lt_trail_capacity = 0;
+uint32_t lt_depth = 0;
+
+// The strings built by the program, released on exit
+static char **strings = NULL;
+static uint32_t strings_count = 0;
+static uint32_t strings_capacity = 0;
+// The top level statements run by the runtime thread
+static void (*lt_program)(void) = NULL;
+
+void lt_init(uint32_t symbols) {
+  lt_values = malloc((symbols ? symbols : 1) * sizeof(lt_value_t));
+  if (lt_values == NULL)
+    lt_error("Out of memory\n");
+  for (uint32_t s = 0; s < symbols; s++) {
+    lt_values[s].type = LT_UNBOUND;
+    lt_values[s].as.number = 0;
+  }
+  lt_trail_capacity = LT_TRAIL_INITIAL;
+  lt_trail = malloc(lt_trail_capacity * sizeof(lt_binding_t));
+  if (lt_trail == NULL)
+    lt_error("Out of memory\n");
+  return;
+}
+
+void lt_destroy(void) {
+  for (uint32_t s = 0; s < strings_count; s++)
+    free(strings[s]);
+  free(strings);
+  strings = NULL;
+  strings_count = strings_capacity = 0;
+  free(lt_trail);
+  lt_trail = NULL;
+  lt_trail_count = lt_trail_capacity = 0;
+  free(lt_values);
+  lt_values = NULL;
+  return;
+}
+
+int lt_run(uint32_t symbols, void (*program)(void)) {
+  lt_init(symbols);
+  lt_program = program;
+  // The calls of the program are C calls, a thread gets a stack as deep as
+  // the one of the interpreter
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, LT_THREAD_STACK);
+  pthread_t thread;
+  if (pthread_create(&thread, &attr, lt_thread, NULL) != 0)
+    lt_thread(NULL);
+  else
+    pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+  lt_destroy();
+  return EXIT_SUCCESS;
+}
+
+void *lt_thread(void *args) {
+  lt_program();
+  return NULL;
+}
+
+void lt_error(const char *msg, ...) {
+  va_list ap;
+  va_start(ap, msg);
+  err_log_v(ERROR, msg, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+void lt_call_error(lt_value_t v, const char *name) {
+  if (v.type == LT_UNBOUND)
+    lt_error("The identifier '%s' was not declared\n", name);
+  lt_error("The identifier '%s' is not a function name\n", name);
+}
+
+void lt_print(lt_value_t v) {
+  switch (v.type) {
+  case LT_NUMBER:
+    if (fmod(v.as.number, 1) == 0)
+      printf("%.0f\n", v.as.number);
+    else
+      printf("%.2f\n", v.as.number);
+    break;
+  case LT_STRING:
+    printf("%s\n", v.as.string);
+    break;
+  case LT_NIL:
+    printf("nil\n");
+    break;
+  case LT_BOOLEAN:
+    printf("%s\n", v.as.boolean ? "true" : "false");
+    break;
+  case LT_CLOSURE:
+    printf("fun%s\n", v.as.function->name);
+    break;
+  }
+  fflush(stdout);
+  return;
+}
+
+lt_value_t lt_add_slow(lt_value_t left, lt_value_t right) {
+  if (left.type != LT_STRING || right.type != LT_STRING)
+    lt_error("Type Error:\t Operands must be two numbers or two strings\n");
+  size_t l = strlen(left.as.string);
+  size_t r = strlen(right.as.string);
+  char *s = malloc(l + r + 1);
+  if (s == NULL)
+    lt_error("Out of memory\n");
+  memcpy(s, left.as.string, l);
+  memcpy(s + l, right.as.string, r);
+  s[l + r] = '\0';
+  if (strings_count == strings_capacity) {
+    strings_capacity = strings_capacity ? strings_capacity * 2 : 64;
+    strings = realloc(strings, strings_capacity * sizeof(char *));
+    if (strings == NULL)
+      lt_error("Out of memory\n");
+  }
+  strings[strings_count++] = s;
+  return lt_string(s);
+}
+
+int lt_equal_slow(lt_value_t l, lt_value_t r) {
+  if (l.type != r.type)
+    lt_error("Type Error:\tComparison between 2 different type!\n");
+  switch (l.type) {
+  case LT_NUMBER:
+    return l.as.number == r.as.number;
+  case LT_NIL:
+    return 1;
+  case LT_BOOLEAN:
+    return l.as.boolean == r.as.boolean;
+  case LT_STRING:
+    return strcmp(l.as.string, r.as.string) == 0;
+  default:
+    lt_error("Type Error:\t Functions cannot be compared\n");
+  }
+}
+
+void lt_trail_grow(void) {
+  lt_trail_capacity *= 2;
+  lt_trail = realloc(lt_trail, lt_trail_capacity * sizeof(lt_binding_t));
+  if (lt_trail == NULL)
+    lt_error("Out of memory\n");
+  return;
+}
@@ -0,0 +1,312 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The runtime of the C programs emitted by lotus --emit-c. The identifiers
+ * are resolved by shallow binding as in the bytecode VM: every symbol has a
+ * slot holding its current value and the shadowed values are kept in a trail.
+ * The operations on numbers are inlined, everything else lives in runtime.c.
+ */
+
+#define LT_STACK_SIZE 100000
+
+typedef enum {
+  LT_STRING,
+  LT_NUMBER,
+  LT_BOOLEAN,
+  LT_NIL,
+  LT_CLOSURE,
+  LT_UNBOUND,
+} lt_type_t;
+
+struct lt_function;
+
+/**
+ * A value of a compiled program
+ * @param type the type of the value (a lt_type_t), not a char type so that
+ * storing it does not alias every other global of the runtime
+ * @param as the payload, strings are owned by the runtime or static
+ */
+typedef struct {
+  uint32_t type;
+  union {
+    double number;
+    int boolean;
+    const char *string;
+    const struct lt_function *function;
+  } as;
+} lt_value_t;
+
+/**
+ * A compiled function, the callee checks the number of arguments
+ * @param name the function name
+ * @param code the C function running the body
+ */
+typedef struct lt_function {
+  const char *name;
+  lt_value_t (*code)(lt_value_t *, uint32_t);
+} lt_function_t;
+
+/**
+ * A binding shadowed by a newer one
+ * @param symbol the symbol bound
+ * @param old the value bound before
+ */
+typedef struct {
+  uint32_t symbol;
+  lt_value_t old;
+} lt_binding_t;
+
+extern lt_value_t *lt_values;
+extern lt_binding_t *lt_trail;
+extern uint32_t lt_trail_count;
+extern uint32_t lt_trail_capacity;
+extern uint32_t lt_depth;
+
+/**
+ * Initialize the runtime
+ * @param symbols the number of symbols of the program
+ */
+void lt_init(uint32_t);
+
+/**
+ * Release the memory of the runtime
+ */
+void lt_destroy(void);
+
+/**
+ * Run a compiled program on a thread with a stack deep enough for it
+ * @param symbols the number of symbols of the program
+ * @param program the top level statements of the program
+ * @return the exit status of the program
+ */
+int lt_run(uint32_t, void (*)(void));
+
+/**
+ * Stop the program showing a formatted error message, as the interpreter
+ * @param msg the message to be printed
+ */
+__attribute__((noreturn)) __attribute__((format(printf, 1, 2))) void
+lt_error(const char *, ...);
+
+/**
+ * Pretty print a value, as the interpreter
+ * @param v the value to print
+ */
+void lt_print(lt_value_t);
+
+/**
+ * Add two values that are not both numbers
+ * @param left the left operand
+ * @param right the right operand
+ * @return the concatenation of two strings
+ */
+lt_value_t lt_add_slow(lt_value_t, lt_value_t);
+
+/**
+ * Compare two values that are not both numbers
+ * @param left the left operand
+ * @param right the right operand
+ * @return 1 if the values are equal, 0 otherwise
+ */
+int lt_equal_slow(lt_value_t, lt_value_t);
+
+/**
+ * Grow the trail
+ */
+void lt_trail_grow(void);
+
+/**
+ * Report a call of something that is not a function
+ * @param name the called identifier
+ */
+__attribute__((noreturn)) void lt_call_error(lt_value_t, const char *);
+
+static inline lt_value_t lt_number(double n) {
+  lt_value_t v;
+  v.type = LT_NUMBER;
+  v.as.number = n;
+  return v;
+}
+
+static inline lt_value_t lt_boolean(int b) {
+  lt_value_t v;
+  v.type = LT_BOOLEAN;
+  v.as.boolean = b;
+  return v;
+}
+
+static inline lt_value_t lt_nil(void) {
+  lt_value_t v;
+  v.type = LT_NIL;
+  v.as.number = 0;
+  return v;
+}
+
+static inline lt_value_t lt_string(const char *s) {
+  lt_value_t v;
+  v.type = LT_STRING;
+  v.as.string = s;
+  return v;
+}
+
+static inline lt_value_t lt_closure(const lt_function_t *f) {
+  lt_value_t v;
+  v.type = LT_CLOSURE;
+  v.as.function = f;
+  return v;
+}
+
+static inline lt_value_t lt_get(uint32_t symbol, const char *name) {
+  if (__builtin_expect(lt_values[symbol].type == LT_UNBOUND, 0))
+    lt_error("The identifier '%s' was not declared\n", name);
+  return lt_values[symbol];
+}
+
+static inline void lt_set(uint32_t symbol, lt_value_t v) {
+  // Assigning an undeclared identifier does nothing
+  if (lt_values[symbol].type != LT_UNBOUND) {
+    lt_values[symbol].type = v.type;
+    lt_values[symbol].as = v.as;
+  }
+  return;
+}
+
+static inline void lt_bind(uint32_t symbol, lt_value_t v) {
+  if (__builtin_expect(lt_trail_count == lt_trail_capacity, 0))
+    lt_trail_grow();
+  // Copied field by field: a value just written as two fields (the arguments
+  // of a call) read back as a single 16 bytes load stalls the store buffer
+  lt_binding_t *b = &lt_trail[lt_trail_count++];
+  b->symbol = symbol;
+  b->old.type = lt_values[symbol].type;
+  b->old.as = lt_values[symbol].as;
+  lt_values[symbol].type = v.type;
+  lt_values[symbol].as = v.as;
+  return;
+}
+
+static inline uint32_t lt_mark(void) { return lt_trail_count; }
+
+static inline void lt_restore(uint32_t mark) {
+  while (lt_trail_count > mark) {
+    lt_binding_t *b = &lt_trail[--lt_trail_count];
+    lt_values[b->symbol].type = b->old.type;
+    lt_values[b->symbol].as = b->old.as;
+  }
+  return;
+}
+
+static inline lt_value_t lt_call(uint32_t symbol, const char *name,
+                                 lt_value_t *args, uint32_t count) {
+  lt_value_t f = lt_values[symbol];
+  if (__builtin_expect(f.type != LT_CLOSURE, 0))
+    lt_call_error(f, name);
+  return f.as.function->code(args, count);
+}
+
+static inline uint32_t lt_enter(uint32_t count, uint32_t arity) {
+  if (__builtin_expect(count != arity, 0))
+    lt_error("actuals number and formals number are not the same");
+  if (__builtin_expect(lt_depth >= LT_STACK_SIZE, 0))
+    lt_error("Stack overflow\n");
+  lt_depth++;
+  return lt_trail_count;
+}
+
+static inline void lt_leave(uint32_t mark) {
+  lt_restore(mark);
+  lt_depth--;
+  return;
+}
+
+static inline int lt_truthy(lt_value_t v) {
+  if (__builtin_expect(v.type != LT_BOOLEAN, 0))
+    lt_error("Type Error:\tImplicit casting is not permitted!\n");
+  return v.as.boolean;
+}
+
+static inline void lt_check_boolean(lt_value_t v) {
+  if (__builtin_expect(v.type != LT_BOOLEAN, 0))
+    lt_error("Type Error:\t Operands must be booleans\n");
+  return;
+}
+
+static inline lt_value_t lt_not(lt_value_t v) {
+  return lt_boolean(!lt_truthy(v));
+}
+
+static inline lt_value_t lt_negate(lt_value_t v) {
+  if (__builtin_expect(v.type != LT_NUMBER, 0))
+    lt_error("Type Error:\t Operand must be a number\n");
+  return lt_number(-v.as.number);
+}
+
+static inline void lt_check_numbers(lt_value_t l, lt_value_t r) {
+  if (__builtin_expect(l.type != LT_NUMBER || r.type != LT_NUMBER, 0))
+    lt_error("Type Error:\t Operands must be numbers\n");
+  return;
+}
+
+static inline lt_value_t lt_add(lt_value_t l, lt_value_t r) {
+  if (__builtin_expect(l.type == LT_NUMBER && r.type == LT_NUMBER, 1))
+    return lt_number(l.as.number + r.as.number);
+  return lt_add_slow(l, r);
+}
+
+static inline lt_value_t lt_subtract(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_number(l.as.number - r.as.number);
+}
+
+static inline lt_value_t lt_multiply(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_number(l.as.number * r.as.number);
+}
+
+static inline lt_value_t lt_divide(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_number(l.as.number / r.as.number);
+}
+
+static inline lt_value_t lt_mod(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_number(fmod(l.as.number, r.as.number));
+}
+
+static inline lt_value_t lt_greater(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_boolean(l.as.number > r.as.number);
+}
+
+static inline lt_value_t lt_greater_equal(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_boolean(l.as.number >= r.as.number);
+}
+
+static inline lt_value_t lt_less(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_boolean(l.as.number < r.as.number);
+}
+
+static inline lt_value_t lt_less_equal(lt_value_t l, lt_value_t r) {
+  lt_check_numbers(l, r);
+  return lt_boolean(l.as.number <= r.as.number);
+}
+
+static inline lt_value_t lt_equal(lt_value_t l, lt_value_t r) {
+  if (__builtin_expect(l.type == LT_NUMBER && r.type == LT_NUMBER, 1))
+    return lt_boolean(l.as.number == r.as.number);
+  return lt_boolean(lt_equal_slow(l, r));
+}
+
+static inline lt_value_t lt_not_equal(lt_value_t l, lt_value_t r) {
+  if (__builtin_expect(l.type == LT_NUMBER && r.type == LT_NUMBER, 1))
+    return lt_boolean(!(l.as.number == r.as.number));
+  return lt_boolean(!lt_equal_slow(l, r));
+}
+
+#endif // !RUNTIME_H
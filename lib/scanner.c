@@ -1,15 +1,140 @@
 #include "scanner.h"
 #include "errors.h"
 #include "keywords.h"
-#include "list.h"
 #include "memory.h"
 #include "token.h"
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#define READ_CHUNK_SIZE 4096
+
+// Vectorized fast paths, the widest instruction set enabled at compile time is
+// used (e.g. make OPT_FLAGS="-O2 -mavx2"), otherwise only the scalar loops
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_WIDTH 32
+#define SIMD_FULL_MASK 0xFFFFFFFFu
+typedef __m256i simd_t;
+#define simd_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define simd_set1(c) _mm256_set1_epi8(c)
+#define simd_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define simd_or(a, b) _mm256_or_si256(a, b)
+#define simd_sub(a, b) _mm256_sub_epi8(a, b)
+#define simd_min(a, b) _mm256_min_epu8(a, b)
+#define simd_mask(a) ((uint32_t)_mm256_movemask_epi8(a))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 16
+#define SIMD_FULL_MASK 0xFFFFu
+typedef __m128i simd_t;
+#define simd_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define simd_set1(c) _mm_set1_epi8(c)
+#define simd_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define simd_or(a, b) _mm_or_si128(a, b)
+#define simd_sub(a, b) _mm_sub_epi8(a, b)
+#define simd_min(a, b) _mm_min_epu8(a, b)
+#define simd_mask(a) ((uint32_t)_mm_movemask_epi8(a))
+#endif
+
+// Character classes
+#define CC_SPACE 0x01   // ' ', '\t', '\r'
+#define CC_NEWLINE 0x02 // '\n'
+#define CC_DIGIT 0x04   // [0-9]
+#define CC_ALPHA 0x08   // [a-zA-Z_]
+
+#define S CC_SPACE
+#define N CC_NEWLINE
+#define D CC_DIGIT
+#define A CC_ALPHA
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, N, 0, 0, S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0,
+    // Non ASCII bytes have no class
+};
+#undef S
+#undef N
+#undef D
+#undef A
+
+// Tokens made by a single character that can't start a longer token
+static const token_type_t single_char_tokens[256] = {
+    [K_LEFT_PAREN] = LEFT_PAREN,
+    [K_RIGHT_PAREN] = RIGHT_PAREN,
+    [K_LEFT_BRACE] = LEFT_BRACE,
+    [K_RIGHT_BRACE] = RIGHT_BRACE,
+    [K_LEFT_SQUARE_BRACKET] = LEFT_SQUARE_BRACKET,
+    [K_RIGHT_SQUARE_BRACKET] = RIGHT_SQUARE_BRACKET,
+    [K_COMMA] = COMMA,
+    [K_DOT] = DOT,
+    [K_PLUS] = PLUS,
+    [K_STAR] = STAR,
+    [K_MOD] = MOD,
+    [K_SEMICOLON] = SEMICOLON,
+    [K_COLON] = COLON,
+};
+
+// Perfect hash of the keywords, computed on the first character and the
+// length: no two keywords share the same slot
+#define KEYWORD_HASH(c, len) (((unsigned char)(c) + 6 * (len)) & 31)
+
+static const struct {
+  const char *text;
+  int length;
+  token_type_t type;
+} keywords[32] = {
+    [0] = {K_NIL, 3, NIL},        [4] = {K_FALSE, 5, FALSE},
+    [11] = {K_MATCH, 5, MATCH},   [12] = {K_TRUE, 4, TRUE},
+    [14] = {K_PRINT, 5, PRINT},   [15] = {K_WITH, 4, WITH},
+    [19] = {K_AND, 3, AND},       [21] = {K_IF, 2, IF},
+    [22] = {K_RETURN, 6, RETURN}, [24] = {K_FUN, 3, FUN},
+    [27] = {K_OR, 2, OR},         [29] = {K_ELSE, 4, ELSE},
+    [30] = {K_VAR, 3, VAR},
+};
+
+/**
+ * Load the source file, mapping it in memory when possible
+ * @param scanner a pointer to the scanner
+ * @return 1 on success, 0 otherwise
+ */
+static int load_source(scanner_t *);
+/**
+ * Read the whole content of a non mappable file (pipes, empty files, ...)
+ * @param scanner a pointer to the scanner
+ * @param fd the file descriptor to read
+ * @return 1 on success, 0 otherwise
+ */
+static int read_source(scanner_t *, int);
+/**
+ * Skip whitespaces and newlines keeping track of the line number
+ * @param s a pointer to the scanner
+ */
+static void skip_whitespaces(scanner_t *);
+/**
+ * Advance the scanner up to the given character (not consumed) or the end
+ * @param s a pointer to the scanner
+ * @param c the character to look for
+ * @param count_lines 1 if newlines must be counted while skipping
+ */
+static void skip_until(scanner_t *, char, int);
+/**
+ * Advance the scanner up to the first non alphanumeric character
+ * @param s a pointer to the scanner
+ */
+static void skip_alphanumerics(scanner_t *);
 static void scan_token(scanner_t *, char);
-static void add_token(scanner_t *, token_type_t, char *);
+static void add_token(scanner_t *, token_type_t);
 static char advance(scanner_t *);
 static char peek(scanner_t *);
 static char peek_next(scanner_t *);
@@ -21,7 +146,7 @@ static int is_at_end(scanner_t *);
 static int is_alpha(char);
 static int is_digit(char);
 static int is_alphanumeric(char);
-static int keyword_get(char *);
+static int keyword_get(const char *, int);
 
 void scanner_init(scanner_t *scanner, const char *file_name) {
   memset(scanner, 0, sizeof(*scanner));
@@ -29,17 +154,29 @@ void scanner_init(scanner_t *scanner, const char *file_name) {
   scanner->start = 0;
   scanner->length = 0;
   scanner->line_number = 1;
-  scanner->tokens = NULL;
+  tokens_init(&scanner->tokens);
+  scanner->output = NULL;
   scanner->source = NULL;
+  scanner->mapped = 0;
   scanner->filename = file_name;
   for (int i = 0; i < LOG_LEVELS; i++)
     scanner->errors[i] = 0;
   return;
 }
 
+void scanner_init_streaming(scanner_t *scanner, const char *file_name,
+                            channel_t *output) {
+  scanner_init(scanner, file_name);
+  scanner->output = output;
+  return;
+}
+
 void scanner_destroy(scanner_t scanner) {
-  mem_free(scanner.source);
-  list_free(scanner.tokens, token_free);
+  if (scanner.mapped)
+    munmap((void *)scanner.source, scanner.length);
+  else
+    mem_free((void *)scanner.source);
+  tokens_destroy(&scanner.tokens);
   return;
 }
 
@@ -52,126 +189,132 @@ void scanner_errors_report(scanner_t scanner) {
 
 int scanner_had_error(scanner_t scanner) { return scanner.errors[ERROR]; }
 
-void scanner_scan_tokens(scanner_t *scanner) {
-  FILE *f = fopen(scanner->filename, "r");
-  if (f == NULL) {
+void scanner_load_source(scanner_t *scanner) {
+  if (!load_source(scanner)) {
     scanner->errors[ERROR]++;
-    err_log(ERROR, "File '%s' is not a valid file\n", scanner->source);
-    exit(EXIT_FAILURE);
-  }
-  fseek(f, 0, SEEK_END);
-  scanner->length = ftell(f);
-  fseek(f, 0, SEEK_SET);
-  scanner->source = malloc(sizeof(char) * scanner->length);
-  if (scanner->source == NULL) {
-    perror("malloc");
+    err_log(ERROR, "File '%s' is not a valid file\n", scanner->filename);
     exit(EXIT_FAILURE);
   }
-  fread(scanner->source, 1, scanner->length, f);
-  fclose(f);
-  while (!is_at_end(scanner)) {
+  return;
+}
+
+void scanner_scan_tokens(scanner_t *scanner) {
+  if (scanner->source == NULL)
+    scanner_load_source(scanner);
+  for (;;) {
+    skip_whitespaces(scanner);
+    if (is_at_end(scanner))
+      break;
     scanner->start = scanner->current;
     char c = advance(scanner);
     scan_token(scanner, c);
   }
-  token_t *eof = mem_calloc(1, sizeof(token_t));
-  eof->type = END;
-  eof->lexeme = "";
-  eof->literal = NULL;
-  eof->line = scanner->line_number;
-  list_add(&scanner->tokens, eof);
-  token_print(*eof);
+  token_t eof;
+  eof.type = END;
+  eof.start = scanner->length;
+  eof.length = 0;
+  eof.line = scanner->line_number;
+  if (scanner->output) {
+    channel_send(scanner->output, &eof);
+    channel_close(scanner->output);
+  } else
+    tokens_push(&scanner->tokens, eof);
+  token_print(scanner->source, eof);
+}
+
+int load_source(scanner_t *scanner) {
+  int fd = open(scanner->filename, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) == -1 || S_ISDIR(st.st_mode)) {
+    close(fd);
+    return 0;
+  }
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *source = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (source != MAP_FAILED) {
+      madvise(source, st.st_size, MADV_SEQUENTIAL);
+      scanner->source = source;
+      scanner->length = st.st_size;
+      scanner->mapped = 1;
+      close(fd);
+      return 1;
+    }
+  }
+  int ok = read_source(scanner, fd);
+  close(fd);
+  return ok;
+}
+
+int read_source(scanner_t *scanner, int fd) {
+  char *source = NULL;
+  int capacity = 0;
+  int length = 0;
+  for (;;) {
+    if (capacity - length < READ_CHUNK_SIZE) {
+      capacity = capacity ? capacity * 2 : READ_CHUNK_SIZE;
+      source = mem_realloc(source, capacity);
+    }
+    ssize_t n = read(fd, source + length, capacity - length);
+    if (n == -1) {
+      mem_free(source);
+      return 0;
+    }
+    if (n == 0)
+      break;
+    length += n;
+  }
+  scanner->source = source;
+  scanner->length = length;
+  scanner->mapped = 0;
+  return 1;
 }
 
 void scan_token(scanner_t *scanner, char c) {
+  token_type_t single = single_char_tokens[(unsigned char)c];
+  if (single) {
+    add_token(scanner, single);
+    return;
+  }
   switch (c) {
-  case K_LEFT_PAREN:
-    add_token(scanner, LEFT_PAREN, NULL);
-    break;
-  case K_RIGHT_PAREN:
-    add_token(scanner, RIGHT_PAREN, NULL);
-    break;
-  case K_LEFT_BRACE:
-    add_token(scanner, LEFT_BRACE, NULL);
-    break;
-  case K_RIGHT_BRACE:
-    add_token(scanner, RIGHT_BRACE, NULL);
-    break;
-  case K_LEFT_SQUARE_BRACKET:
-    add_token(scanner, LEFT_SQUARE_BRACKET, NULL);
-    break;
-  case K_RIGHT_SQUARE_BRACKET:
-    add_token(scanner, RIGHT_SQUARE_BRACKET, NULL);
-    break;
-  case K_COMMA:
-    add_token(scanner, COMMA, NULL);
-    break;
-  case K_DOT:
-    add_token(scanner, DOT, NULL);
-    break;
   case K_MINUS:
-    add_token(scanner, match(scanner, K_GREATER) ? SINGLE_ARROW : MINUS, NULL);
-    break;
-  case K_PLUS:
-    add_token(scanner, PLUS, NULL);
-    break;
-  case K_STAR:
-    add_token(scanner, STAR, NULL);
-    break;
-  case K_MOD:
-    add_token(scanner, MOD, NULL);
+    add_token(scanner, match(scanner, K_GREATER) ? SINGLE_ARROW : MINUS);
     break;
   case K_PIPE:
-    add_token(scanner, match(scanner, K_GREATER) ? PIPE_GREATER : PIPE, NULL);
-    break;
-  case K_SEMICOLON:
-    add_token(scanner, SEMICOLON, NULL);
-    break;
-  case K_COLON:
-    add_token(scanner, COLON, NULL);
+    add_token(scanner, match(scanner, K_GREATER) ? PIPE_GREATER : PIPE);
     break;
   case K_BANG:
-    add_token(scanner, match(scanner, K_EQUAL) ? BANG_EQUAL : BANG, NULL);
+    add_token(scanner, match(scanner, K_EQUAL) ? BANG_EQUAL : BANG);
     break;
   case K_EQUAL:
-    add_token(scanner,
-              match(scanner, K_EQUAL)     ? EQUAL_EQUAL
-              : match(scanner, K_GREATER) ? DOUBLE_ARROW
-                                          : EQUAL,
-              NULL);
+    add_token(scanner, match(scanner, K_EQUAL)     ? EQUAL_EQUAL
+                       : match(scanner, K_GREATER) ? DOUBLE_ARROW
+                                                   : EQUAL);
     break;
   case K_LOWER:
-    add_token(scanner, match(scanner, K_EQUAL) ? LESS_EQUAL : LESS, NULL);
+    add_token(scanner, match(scanner, K_EQUAL) ? LESS_EQUAL : LESS);
     break;
   case K_GREATER:
-    add_token(scanner, match(scanner, K_EQUAL) ? GREATER_EQUAL : GREATER, NULL);
+    add_token(scanner, match(scanner, K_EQUAL) ? GREATER_EQUAL : GREATER);
     break;
   case K_SLASH:
     if (match(scanner, K_SLASH)) {
       // Ignore the comment until the \n
-      while (peek(scanner) != '\n' && !is_at_end(scanner))
-        advance(scanner);
+      skip_until(scanner, '\n', 0);
     } else {
-      add_token(scanner, SLASH, NULL);
+      add_token(scanner, SLASH);
     }
     break;
   case K_DOUBLE_QUOTE:
     string(scanner);
     break;
-  case ' ':
-  case '\t':
-  case '\r':
-    // Ignore whitespaces
-    break;
-  case '\n':
-    scanner->line_number++;
-    break;
   default:
     if (is_digit(c))
       number(scanner);
     // TODO: Keep a watch on this condition (is_alphanumeric should be negated)
     else if (c == K_WILDCARD && is_alphanumeric(peek_next(scanner)))
-      add_token(scanner, WILDCARD, NULL);
+      add_token(scanner, WILDCARD);
     else if (is_alpha(c))
       identifier(scanner);
     else {
@@ -186,13 +329,99 @@ void scan_token(scanner_t *scanner, char c) {
 
 int is_at_end(scanner_t *s) { return s->current >= s->length; }
 
-int is_digit(char c) { return c >= '0' && c <= '9'; }
+int is_digit(char c) { return char_class[(unsigned char)c] & CC_DIGIT; }
+
+int is_alpha(char c) { return char_class[(unsigned char)c] & CC_ALPHA; }
+
+int is_alphanumeric(char c) {
+  return char_class[(unsigned char)c] & (CC_ALPHA | CC_DIGIT);
+}
+
+void skip_whitespaces(scanner_t *s) {
+#ifdef SIMD_WIDTH
+  while (s->current + SIMD_WIDTH <= s->length) {
+    simd_t v = simd_load(s->source + s->current);
+    simd_t newlines = simd_eq(v, simd_set1('\n'));
+    simd_t spaces = simd_or(simd_or(simd_eq(v, simd_set1(' ')), newlines),
+                            simd_or(simd_eq(v, simd_set1('\t')),
+                                    simd_eq(v, simd_set1('\r'))));
+    uint32_t stop = ~simd_mask(spaces) & SIMD_FULL_MASK;
+    uint32_t lines = simd_mask(newlines);
+    if (stop == 0) {
+      s->line_number += __builtin_popcount(lines);
+      s->current += SIMD_WIDTH;
+      continue;
+    }
+    int n = __builtin_ctz(stop);
+    s->line_number += __builtin_popcount(lines & ((1u << n) - 1));
+    s->current += n;
+    return;
+  }
+#endif
+  while (!is_at_end(s)) {
+    unsigned char cc = char_class[(unsigned char)s->source[s->current]];
+    if (!(cc & (CC_SPACE | CC_NEWLINE)))
+      return;
+    if (cc & CC_NEWLINE)
+      s->line_number++;
+    s->current++;
+  }
+  return;
+}
 
-int is_alpha(char c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+void skip_until(scanner_t *s, char c, int count_lines) {
+#ifdef SIMD_WIDTH
+  simd_t target = simd_set1(c);
+  simd_t newline = simd_set1('\n');
+  while (s->current + SIMD_WIDTH <= s->length) {
+    simd_t v = simd_load(s->source + s->current);
+    uint32_t stop = simd_mask(simd_eq(v, target));
+    uint32_t lines = count_lines ? simd_mask(simd_eq(v, newline)) : 0;
+    if (stop == 0) {
+      s->line_number += __builtin_popcount(lines);
+      s->current += SIMD_WIDTH;
+      continue;
+    }
+    int n = __builtin_ctz(stop);
+    s->line_number += __builtin_popcount(lines & ((1u << n) - 1));
+    s->current += n;
+    return;
+  }
+#endif
+  while (!is_at_end(s) && s->source[s->current] != c) {
+    if (count_lines && s->source[s->current] == '\n')
+      s->line_number++;
+    s->current++;
+  }
+  return;
 }
 
-int is_alphanumeric(char c) { return is_alpha(c) || is_digit(c); }
+void skip_alphanumerics(scanner_t *s) {
+#ifdef SIMD_WIDTH
+  while (s->current + SIMD_WIDTH <= s->length) {
+    simd_t v = simd_load(s->source + s->current);
+    // Unsigned range check: (v - lo) <= (hi - lo)
+    simd_t lower = simd_sub(v, simd_set1('a'));
+    simd_t upper = simd_sub(v, simd_set1('A'));
+    simd_t digit = simd_sub(v, simd_set1('0'));
+    simd_t alnum = simd_or(
+        simd_or(simd_eq(simd_min(lower, simd_set1(25)), lower),
+                simd_eq(simd_min(upper, simd_set1(25)), upper)),
+        simd_or(simd_eq(simd_min(digit, simd_set1(9)), digit),
+                simd_eq(v, simd_set1(K_WILDCARD))));
+    uint32_t stop = ~simd_mask(alnum) & SIMD_FULL_MASK;
+    if (stop == 0) {
+      s->current += SIMD_WIDTH;
+      continue;
+    }
+    s->current += __builtin_ctz(stop);
+    return;
+  }
+#endif
+  while (!is_at_end(s) && is_alphanumeric(s->source[s->current]))
+    s->current++;
+  return;
+}
 
 int match(scanner_t *s, char expected) {
   if (is_at_end(s))
@@ -220,11 +449,7 @@ char peek_next(scanner_t *s) {
 void string(scanner_t *s) {
   int line_start = s->line_number;
   // NOTE: special char escape should occur here
-  while (peek(s) != K_DOUBLE_QUOTE && !is_at_end(s)) {
-    if (peek(s) == '\n')
-      s->line_number++;
-    advance(s);
-  }
+  skip_until(s, K_DOUBLE_QUOTE, 1);
 
   if (is_at_end(s)) {
     s->errors[ERROR]++;
@@ -233,8 +458,7 @@ void string(scanner_t *s) {
   }
   // advance in order to consume '"' character
   advance(s);
-  int len = s->current - s->start;
-  add_token(s, STRING, strndup(s->source + s->start + 1, len - 2));
+  add_token(s, STRING);
 }
 
 void number(scanner_t *s) {
@@ -251,56 +475,31 @@ void number(scanner_t *s) {
     err_log(ERROR, "Line %d: Wrong format for number\n", s->line_number);
     return;
   }
-  int len = s->current - s->start;
-  add_token(s, NUMBER, strndup(s->source + s->start, len));
+  add_token(s, NUMBER);
 }
 
 void identifier(scanner_t *s) {
-  while (is_alphanumeric(peek(s)))
-    advance(s);
+  skip_alphanumerics(s);
   int len = s->current - s->start;
-  char *text = strndup(s->source + s->start, len);
-  add_token(s, keyword_get(text), text);
+  add_token(s, keyword_get(s->source + s->start, len));
 }
 
-void add_token(scanner_t *s, token_type_t t, char *literal) {
-  int len = s->current - s->start;
-  token_t *tok = mem_calloc(1, sizeof(token_t));
-  tok->lexeme = strndup(s->source + s->start, len);
-  tok->literal = literal;
-  tok->type = t;
-  tok->line = s->line_number;
-  list_add(&s->tokens, tok);
-  token_print(*tok);
+void add_token(scanner_t *s, token_type_t t) {
+  token_t tok;
+  tok.start = s->start;
+  tok.length = s->current - s->start;
+  tok.type = t;
+  tok.line = s->line_number;
+  if (s->output)
+    channel_send(s->output, &tok);
+  else
+    tokens_push(&s->tokens, tok);
+  token_print(s->source, tok);
 }
 
-int keyword_get(char *text) {
-  if (strcmp(text, K_AND) == 0)
-    return AND;
-  if (strcmp(text, K_ELSE) == 0)
-    return ELSE;
-  if (strcmp(text, K_FALSE) == 0)
-    return FALSE;
-  if (strcmp(text, K_FUN) == 0)
-    return FUN;
-  if (strcmp(text, K_IF) == 0)
-    return IF;
-  if (strcmp(text, K_NIL) == 0)
-    return NIL;
-  if (strcmp(text, K_OR) == 0)
-    return OR;
-  if (strcmp(text, K_PRINT) == 0)
-    return PRINT;
-  if (strcmp(text, K_RETURN) == 0)
-    return RETURN;
-  if (strcmp(text, K_TRUE) == 0)
-    return TRUE;
-  if (strcmp(text, K_VAR) == 0)
-    return VAR;
-  if (strcmp(text, K_MATCH) == 0)
-    return MATCH;
-  if (strcmp(text, K_WITH) == 0)
-    return WITH;
-
+int keyword_get(const char *text, int len) {
+  int h = KEYWORD_HASH(text[0], len);
+  if (keywords[h].length == len && memcmp(text, keywords[h].text, len) == 0)
+    return keywords[h].type;
   return IDENTIFIER;
 }
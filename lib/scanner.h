@@ -1,14 +1,18 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 #include "errors.h"
-#include "list.h"
+#include "thread.h"
 #include "token.h"
 
 /**
  * @brief A scanner_t "object"
  * @param const char *filename: The path of the source file to scan
- * @param char* source: The source code inside the filename
- * @param List tokens: The tokens obtained from the lexical analysis
+ * @param const char* source: The source code inside the filename (read only
+ * mapping of the file when possible)
+ * @param int mapped: 1 if the source is a memory mapping of the file
+ * @param token_vector_t tokens: The tokens obtained from the lexical analysis
+ * @param channel_t *output: When not NULL the tokens are sent on this channel
+ * instead of being stored in tokens
  * @param int start: The starting index of the current token
  * @param int current: The current position of the scanner
  * @param int length: The length (bytes) of the source code
@@ -16,8 +20,10 @@
  */
 typedef struct {
   const char *filename;
-  char *source;
-  l_list_t tokens;
+  const char *source;
+  int mapped;
+  token_vector_t tokens;
+  channel_t *output;
   int line_number;
   int start;
   int current;
@@ -32,9 +38,27 @@ typedef struct {
  */
 void scanner_init(scanner_t *, const char *);
 
+/**
+ * @brief Initialize the given scanner in streaming mode
+ * @param scanner_t *scanner: The scanner to initialize
+ * @param const char* fil_name: The path of the source file
+ * @param channel_t *output: The channel where the tokens will be sent, it is
+ * closed after the END token
+ */
+void scanner_init_streaming(scanner_t *, const char *, channel_t *);
+
+/**
+ * @brief Load the source file of the given scanner
+ * @param scanner_t *scanner: The scanner
+ * @note Called by scanner_scan_tokens if the source is not loaded yet, the
+ * process exits if the file can't be read
+ */
+void scanner_load_source(scanner_t *);
+
 /**
  * @brief Destroy the given scanner
  * @param scanner_t scanner: The scanner to destroy
+ * @note Tokens are slices of the source, so the scanner must outlive them
  */
 void scanner_destroy(scanner_t);
 
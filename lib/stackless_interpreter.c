@@ -0,0 +1,418 @@
+#include "stackless_interpreter.h"
+#include "environment.h"
+#include "garbage.h"
+#include "interpreter.h"
+#include "list.h"
+#include "memory.h"
+#include "syntax.h"
+#include <string.h>
+
+/**
+ * The work left to do by a continuation, every expression and statement
+ * evaluated leaves exactly one value on top of the GC temporaries
+ */
+typedef enum {
+  CONT_EVAL_EXP,     // push the value of an expression
+  CONT_EVAL_STMT,    // push the value of a statement
+  CONT_EVAL_ACTUALS, // push the values of the remaining actuals of a call
+  CONT_UNARY,        // replace the operand with the result
+  CONT_BINARY,       // replace the two operands with the result
+  CONT_LOGIC,        // check the left side of an and/or, maybe evaluate the
+                     // right one
+  CONT_BOOLEAN,      // check the right side of an and/or
+  CONT_CALL,         // bind the frame of a call and run the callee body
+  CONT_FORWARD,      // as CONT_CALL, the forwarded value is the first one
+  CONT_LEAVE,        // end a call, its result replaces the callee
+  CONT_PRINT,        // print the value, replacing it with nil
+  CONT_IF,           // run a branch according to the condition
+  CONT_BLOCK,        // drop the previous value and run the next statement
+  CONT_DECLARATION,  // bind the value
+  CONT_ASSIGNMENT,   // assign the value
+  CONT_RETURN,       // unwind to the enclosing call
+} cont_kind_t;
+
+/**
+ * @param kind the work left to do
+ * @param node the expression, statement or list it works on
+ * @param env_size the size of the environment to restore (blocks and calls)
+ * @param base the index of the first temporary of the call frame (calls),
+ * the callee closure is held there while its body runs
+ */
+typedef struct {
+  cont_kind_t kind;
+  int env_size;
+  uint32_t base;
+  void *node;
+} continuation_t;
+
+/**
+ * The heap stack of continuations, it replaces the C stack of the recursive
+ * evaluators
+ */
+typedef struct {
+  continuation_t *items;
+  uint32_t count;
+  uint32_t capacity;
+} continuations_t;
+
+/**
+ * Push a continuation
+ * @param k a pointer to the continuations
+ * @param kind the work left to do
+ * @param node the expression, statement or list it works on
+ * @param env_size the size of the environment to restore, if any
+ * @param base the index of the first temporary of the call frame, if any
+ */
+static void push(continuations_t *, cont_kind_t, void *, int, uint32_t);
+/**
+ * Run a top level statement until its continuations are exhausted
+ * @param i a pointer to the interpreter
+ * @param k a pointer to the (empty) continuations
+ * @param s a pointer to the statement
+ */
+static void run(interpreter_t *, continuations_t *, stmt_t *);
+/**
+ * Start the evaluation of an expression, its leaves are evaluated at once,
+ * the other ones push their continuations
+ * @param i a pointer to the interpreter
+ * @param k a pointer to the continuations
+ * @param e a pointer to the expression
+ */
+static void eval_exp(interpreter_t *, continuations_t *, exp_t *);
+/**
+ * Start the evaluation of a statement
+ * @param i a pointer to the interpreter
+ * @param k a pointer to the continuations
+ * @param s a pointer to the statement
+ */
+static void eval_stmt(interpreter_t *, continuations_t *, stmt_t *);
+/**
+ * Call a closure with the frame of actuals on top of the temporaries, a call
+ * in tail position replaces the continuations of its caller
+ * @param i a pointer to the interpreter
+ * @param k a pointer to the continuations
+ * @param c a pointer to the CONT_CALL or CONT_FORWARD continuation
+ */
+static void call(interpreter_t *, continuations_t *, continuation_t *);
+/**
+ * Drop the continuations up to the CONT_LEAVE of the enclosing call
+ * @param k a pointer to the continuations
+ * @return a pointer to the CONT_LEAVE continuation
+ */
+static continuation_t *unwind(continuations_t *);
+
+void stackless_interpreter_eval(interpreter_t *interpreter,
+                                l_list_t statements) {
+  continuations_t k;
+  memset(&k, 0, sizeof(continuations_t));
+  for (l_list_t current = statements; current; current = current->next)
+    run(interpreter, &k, current->data);
+  mem_free(k.items);
+  return;
+}
+
+void stackless_interpreter_eval_statement(interpreter_t *interpreter,
+                                          stmt_t *statement) {
+  continuations_t k;
+  memset(&k, 0, sizeof(continuations_t));
+  run(interpreter, &k, statement);
+  mem_free(k.items);
+  return;
+}
+
+void run(interpreter_t *i, continuations_t *k, stmt_t *s) {
+  garbage_collector_t *gc = i->garbage_collector;
+  push(k, CONT_EVAL_STMT, s, 0, 0);
+  while (k->count) {
+    continuation_t c = k->items[--k->count];
+    value_t *top = gc->temporaries + gc->temporaries_count - 1;
+    switch (c.kind) {
+    case CONT_EVAL_EXP:
+      eval_exp(i, k, c.node);
+      break;
+    case CONT_EVAL_STMT:
+      eval_stmt(i, k, c.node);
+      break;
+    case CONT_EVAL_ACTUALS: {
+      l_list_t actual = c.node;
+      if (actual->next)
+        push(k, CONT_EVAL_ACTUALS, actual->next, 0, 0);
+      push(k, CONT_EVAL_EXP, actual->data, 0, 0);
+      break;
+    }
+    case CONT_UNARY:
+      *top = interpreter_unary_site(i, c.node, *top);
+      break;
+    case CONT_BINARY: {
+      // The operands stay held while a concatenation allocates
+      value_t result = interpreter_binary_site(i, c.node, top[-1], *top);
+      gc_release(gc, 2);
+      gc_hold(gc, result);
+      break;
+    }
+    case CONT_LOGIC: {
+      // The left side is the result of a short circuit, the right one the
+      // result otherwise
+      exp_binary_t *b = c.node;
+      if (!value_is_boolean(*top))
+        interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+      if (value_as_boolean(*top) == (b->op == OP_OR))
+        break;
+      gc_release(gc, 1);
+      push(k, CONT_BOOLEAN, NULL, 0, 0);
+      push(k, CONT_EVAL_EXP, b->right, 0, 0);
+      break;
+    }
+    case CONT_BOOLEAN:
+      if (!value_is_boolean(*top))
+        interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+      break;
+    case CONT_CALL:
+    case CONT_FORWARD:
+      call(i, k, &c);
+      break;
+    case CONT_LEAVE:
+      i->depth--;
+      env_restore(i->environment, c.env_size);
+      gc->temporaries[c.base] = *top;
+      gc->temporaries_count = c.base + 1;
+      break;
+    case CONT_PRINT:
+      interpreter_print(*top);
+      *top = VALUE_NIL;
+      break;
+    case CONT_IF: {
+      stmt_conditional_t *conditional = c.node;
+      int truthy = interpreter_is_truthy(i, *top);
+      gc_release(gc, 1);
+      if (truthy)
+        push(k, CONT_EVAL_STMT, conditional->then_branch, 0, 0);
+      else if (conditional->else_branch)
+        push(k, CONT_EVAL_STMT, conditional->else_branch, 0, 0);
+      else
+        gc_hold(gc, VALUE_NIL);
+      break;
+    }
+    case CONT_BLOCK: {
+      l_list_t current = c.node;
+      if (current == NULL) {
+        env_restore(i->environment, c.env_size);
+        break;
+      }
+      gc_release(gc, 1);
+      push(k, CONT_BLOCK, current->next, c.env_size, 0);
+      push(k, CONT_EVAL_STMT, current->data, 0, 0);
+      break;
+    }
+    case CONT_DECLARATION:
+      env_bind(i->environment, ((stmt_declaration_t *)c.node)->symbol, *top);
+      break;
+    case CONT_ASSIGNMENT:
+      env_set(i->environment, ((stmt_assignment_t *)c.node)->symbol, *top);
+      break;
+    case CONT_RETURN: {
+      // The enclosing statements are dropped, the value is the body result
+      continuation_t *leave = unwind(k);
+      gc->temporaries[leave->base + 1] = *top;
+      gc->temporaries_count = leave->base + 2;
+      break;
+    }
+    }
+  }
+  // The value of a top level statement is discarded
+  gc_release(gc, 1);
+  return;
+}
+
+void eval_exp(interpreter_t *i, continuations_t *k, exp_t *e) {
+  garbage_collector_t *gc = i->garbage_collector;
+  switch (e->type) {
+  case EXP_LITERAL: {
+    exp_literal_t *literal = exp_unwrap(e);
+    switch (literal->type) {
+    case T_STRING:
+      gc_hold(gc, gc_init_string(gc, literal->value.string));
+      break;
+    case T_NUMBER:
+      gc_hold(gc, value_number(literal->value.number));
+      break;
+    case T_BOOLEAN:
+      gc_hold(gc, value_boolean(literal->value.boolean));
+      break;
+    default:
+      gc_hold(gc, VALUE_NIL);
+      break;
+    }
+    break;
+  }
+  case EXP_IDENTIFIER: {
+    exp_identifier_t *identifier = exp_unwrap(e);
+    value_t v;
+    if (!env_get(i->environment, identifier->symbol, &v))
+      interpreter_error(i, "The identifier '%s' was not declared\n",
+                        identifier->identifier);
+    gc_hold(gc, v);
+    break;
+  }
+  case EXP_GROUPING:
+    push(k, CONT_EVAL_EXP, ((exp_grouping_t *)exp_unwrap(e))->exp, 0, 0);
+    break;
+  case EXP_UNARY: {
+    exp_unary_t *unary = exp_unwrap(e);
+    push(k, CONT_UNARY, unary, 0, 0);
+    push(k, CONT_EVAL_EXP, unary->right, 0, 0);
+    break;
+  }
+  case EXP_BINARY: {
+    exp_binary_t *binary = exp_unwrap(e);
+    if (binary->op == OP_FORWARD) {
+      // The left side is evaluated first, then the actuals above it
+      if (binary->right->type != EXP_CALL)
+        interpreter_error(i, "Expected a function call after |>\n");
+      exp_call_t *c = exp_unwrap(binary->right);
+      push(k, CONT_FORWARD, c, 0, gc->temporaries_count);
+      if (c->actuals)
+        push(k, CONT_EVAL_ACTUALS, c->actuals, 0, 0);
+      push(k, CONT_EVAL_EXP, binary->left, 0, 0);
+    } else if (binary->op == OP_AND || binary->op == OP_OR) {
+      push(k, CONT_LOGIC, binary, 0, 0);
+      push(k, CONT_EVAL_EXP, binary->left, 0, 0);
+    } else {
+      push(k, CONT_BINARY, binary, 0, 0);
+      push(k, CONT_EVAL_EXP, binary->right, 0, 0);
+      push(k, CONT_EVAL_EXP, binary->left, 0, 0);
+    }
+    break;
+  }
+  case EXP_CALL: {
+    exp_call_t *c = exp_unwrap(e);
+    push(k, CONT_CALL, c, 0, gc->temporaries_count);
+    if (c->actuals)
+      push(k, CONT_EVAL_ACTUALS, c->actuals, 0, 0);
+    break;
+  }
+  default:
+    interpreter_error(i, "Unknown expression\n");
+  }
+  return;
+}
+
+void eval_stmt(interpreter_t *i, continuations_t *k, stmt_t *s) {
+  switch (s->type) {
+  case STMT_RETURN:
+    if (i->depth == 0)
+      interpreter_error(i, "return can used only inside a function\n");
+    push(k, CONT_RETURN, NULL, 0, 0);
+    push(k, CONT_EVAL_EXP, ((stmt_expr_t *)stmt_unwrap(s))->exp, 0, 0);
+    break;
+  case STMT_EXPR:
+    push(k, CONT_EVAL_EXP, ((stmt_expr_t *)stmt_unwrap(s))->exp, 0, 0);
+    break;
+  case STMT_PRINT:
+    push(k, CONT_PRINT, NULL, 0, 0);
+    push(k, CONT_EVAL_EXP, ((stmt_print_t *)stmt_unwrap(s))->exp, 0, 0);
+    break;
+  case STMT_IF: {
+    stmt_conditional_t *conditional = stmt_unwrap(s);
+    push(k, CONT_IF, conditional, 0, 0);
+    push(k, CONT_EVAL_EXP, conditional->condition, 0, 0);
+    break;
+  }
+  case STMT_BLOCK:
+    // The value of an empty block is nil
+    gc_hold(i->garbage_collector, VALUE_NIL);
+    push(k, CONT_BLOCK, ((stmt_block_t *)stmt_unwrap(s))->statements,
+         i->environment->size, 0);
+    break;
+  case STMT_DECLARATION: {
+    stmt_declaration_t *declaration = stmt_unwrap(s);
+    push(k, CONT_DECLARATION, declaration, 0, 0);
+    push(k, CONT_EVAL_EXP, declaration->exp, 0, 0);
+    break;
+  }
+  case STMT_ASSIGNMENT: {
+    stmt_assignment_t *assignment = stmt_unwrap(s);
+    push(k, CONT_ASSIGNMENT, assignment, 0, 0);
+    push(k, CONT_EVAL_EXP, assignment->exp, 0, 0);
+    break;
+  }
+  case STMT_FUN: {
+    stmt_function_t *fun = stmt_unwrap(s);
+    closure_t tmp;
+    tmp.body = fun->body;
+    tmp.formals = fun->formals;
+    tmp.symbols = fun->symbols;
+    tmp.arity = fun->arity;
+    tmp.identifier = fun->identifier;
+    tmp.code = 0;
+    tmp.compiled = NULL;
+    // Only the engines recursing on the C stack memoize the calls
+    tmp.pure = 0;
+    value_t closure = gc_init_closure(i->garbage_collector, tmp);
+    env_bind(i->environment, fun->symbol, closure);
+    gc_hold(i->garbage_collector, closure);
+    break;
+  }
+  default:
+    interpreter_error(i, "Unimplemented Error\n");
+  }
+  return;
+}
+
+void call(interpreter_t *i, continuations_t *k, continuation_t *c) {
+  garbage_collector_t *gc = i->garbage_collector;
+  exp_call_t *e = c->node;
+  value_t *values = gc->temporaries + c->base;
+  uint32_t count = gc->temporaries_count - c->base;
+  if (c->kind == CONT_FORWARD) {
+    // The forwarded value was evaluated first but it is the last actual
+    value_t forwarded = values[0];
+    memmove(values, values + 1, (count - 1) * sizeof(value_t));
+    values[count - 1] = forwarded;
+  }
+  stmt_t *body;
+  value_t v = interpreter_callee(i, e, &body);
+  closure_t *closure = value_as_closure(v);
+  int env_size = i->environment->size;
+  if (!env_bulk_bind(i->environment, closure->symbols, closure->arity, values,
+                     count))
+    interpreter_error(i, "actuals number and formals number are not the same");
+  if (e->tail && i->depth) {
+    // The callee replaces the caller: the continuations of the caller are
+    // dropped keeping its bindings, the ones shadowed are squashed as in
+    // interpreter_call
+    continuation_t *leave = unwind(k);
+    gc->temporaries[leave->base] = v;
+    gc->temporaries_count = leave->base + 1;
+    env_squash(i->environment, leave->env_size);
+    push(k, CONT_EVAL_STMT, body, 0, 0);
+    return;
+  }
+  if (i->max_depth && i->depth >= i->max_depth)
+    interpreter_error(i, "Stack overflow\n");
+  i->depth++;
+  // The frame is bound, the callee takes its place
+  gc->temporaries_count = c->base;
+  gc_hold(gc, v);
+  push(k, CONT_LEAVE, NULL, env_size, c->base);
+  push(k, CONT_EVAL_STMT, body, 0, 0);
+  return;
+}
+
+continuation_t *unwind(continuations_t *k) {
+  while (k->items[k->count - 1].kind != CONT_LEAVE)
+    k->count--;
+  return &k->items[k->count - 1];
+}
+
+void push(continuations_t *k, cont_kind_t kind, void *node, int env_size,
+          uint32_t base) {
+  k->items = mem_reserve(k->items, &k->capacity, k->count + 1,
+                         sizeof(continuation_t));
+  continuation_t *c = &k->items[k->count++];
+  c->kind = kind;
+  c->node = node;
+  c->env_size = env_size;
+  c->base = base;
+  return;
+}
@@ -0,0 +1,25 @@
+#ifndef STACKLESS_INTERPRETER_H
+#define STACKLESS_INTERPRETER_H
+#include "interpreter.h"
+#include "list.h"
+#include "syntax.h"
+
+/**
+ * Run a list of top level statements without recursing on the C stack: the
+ * pending work lives in a heap stack of continuations and the intermediate
+ * values in the temporaries of the GC, so the depth of the Lotus calls is
+ * bounded only by the memory (and by the max_depth of the interpreter, if
+ * any)
+ * @param interpreter a pointer to the interpreter to use
+ * @param statements the statements to run
+ */
+void stackless_interpreter_eval(interpreter_t *, l_list_t);
+
+/**
+ * Run a single top level statement without recursing on the C stack
+ * @param interpreter a pointer to the interpreter to use
+ * @param statement a pointer to the statement to run
+ */
+void stackless_interpreter_eval_statement(interpreter_t *, stmt_t *);
+
+#endif // !STACKLESS_INTERPRETER_H
@@ -1,7 +1,9 @@
 #ifndef SYNTAX_H
 #define SYNTAX_H
+#include "arena.h"
 #include "list.h"
 #include "token.h"
+#include <stdint.h>
 
 typedef enum {
   EXP_PANIC_MODE, // used only for the parser panic mode
@@ -33,6 +35,7 @@ typedef enum {
   STMT_DECLARATION,
   STMT_ASSIGNMENT,
   STMT_RETURN,
+  STMT_LAZY,
 } stmt_type_t;
 
 typedef enum {
@@ -61,70 +64,117 @@ typedef enum {
 /**
  * This type act as a wrapper around all the possible expression type
  * @note: proper casting is required
+ * @note: the *_init functions allocate the node inside the given arena, the
+ * identifiers, literal values and lists they receive must live there too, the
+ * whole tree is released by arena_destroy
+ * @note: a tree is never copied, once resolved it is shared by the engines and
+ * by every closure of the functions it declares
  */
 typedef struct {
   exp_type_t type;
   void *exp;
 } exp_t;
 
-exp_t *exp_init(exp_type_t, void *);
-exp_t *exp_dup(exp_t *);
-void exp_destroy(exp_t *);
-void exp_free(void *);
+exp_t *exp_init(arena_t *, exp_type_t, void *);
 void *exp_unwrap(exp_t *);
 
+/**
+ * The operand types seen by an operator site: a site starts unobserved, is
+ * specialized on the types of its first operands and turns generic for good
+ * once a guard of its variant fails
+ */
+typedef enum {
+  QUICK_NONE,
+  QUICK_NUMBERS,
+  QUICK_STRINGS,
+  QUICK_BOOLEANS,
+  QUICK_GENERIC,
+} quick_t;
+
+/**
+ * @param quick the operand type seen by the operator
+ */
 typedef struct {
   operator_t op;
   exp_t *right;
+  quick_t quick;
 } exp_unary_t;
 
-exp_unary_t *exp_unary_init(operator_t, exp_t *);
-exp_unary_t *exp_unary_dup(exp_unary_t *);
-void exp_unary_destroy(exp_unary_t *);
+exp_unary_t *exp_unary_init(arena_t *, operator_t, exp_t *);
 
+/**
+ * @param quick the operand types seen by the operator, the short circuit and
+ * forwarding operators are never specialized
+ */
 typedef struct {
   exp_t *left;
   operator_t op;
   exp_t *right;
+  quick_t quick;
 } exp_binary_t;
 
-exp_binary_t *exp_binary_init(exp_t *, operator_t, exp_t *);
-exp_binary_t *exp_binary_dup(exp_binary_t *);
-void exp_binary_destroy(exp_binary_t *);
+exp_binary_t *exp_binary_init(arena_t *, exp_t *, operator_t, exp_t *);
 
 typedef struct {
   exp_t *exp;
 } exp_grouping_t;
 
-exp_grouping_t *exp_grouping_init(exp_t *);
-exp_grouping_t *exp_grouping_dup(exp_grouping_t *);
-void exp_groping_destroy(exp_grouping_t *);
+exp_grouping_t *exp_grouping_init(arena_t *, exp_t *);
+
+typedef union {
+  double number;
+  int boolean;
+  char *string;
+} literal_value_t;
 
 typedef struct {
-  void *value;
+  literal_value_t value;
   literal_type_t type;
 } exp_literal_t;
 
-exp_literal_t *exp_literal_init(literal_type_t, void *);
-exp_literal_t *exp_literal_dup(exp_literal_t *);
-void exp_literal_destroy(exp_literal_t *);
+exp_literal_t *exp_literal_init(arena_t *, literal_type_t, literal_value_t);
 
+/**
+ * @param identifier the name
+ * @param symbol the symbol of the name, assigned by the resolver
+ */
 typedef struct {
   char *identifier;
+  uint32_t symbol;
 } exp_identifier_t;
 
-exp_identifier_t *exp_identifier_init(char *);
-exp_identifier_t *exp_identifier_dup(exp_identifier_t *);
-void exp_identifier_destroy(exp_identifier_t *);
+exp_identifier_t *exp_identifier_init(arena_t *, char *);
 
+/**
+ * The inline cache of a call site, filled by the engines walking the AST
+ * @param closure the closure last called (a value_t), 0 if none
+ * @param body the body of that closure, parsed and resolved
+ * @param cycle the GC cycle the closure was cached in, a sweep may free it
+ * and reuse its address
+ */
+typedef struct {
+  uint64_t closure;
+  void *body;
+  uint32_t cycle;
+} call_cache_t;
+
+/**
+ * @param identifier the called function name
+ * @param symbol the symbol of the name, assigned by the resolver
+ * @param tail 1 if the call is in tail position (its result is the result of
+ * the enclosing function), assigned by the resolver
+ * @param actuals the actuals, in reverse order
+ * @param cache the inline cache of the call
+ */
 typedef struct {
   char *identifier;
+  uint32_t symbol;
+  int tail;
   l_list_t actuals;
+  call_cache_t cache;
 } exp_call_t;
 
-exp_call_t *exp_call_init(char *, l_list_t);
-exp_call_t *exp_call_dup(exp_call_t *);
-void exp_call_destroy(exp_call_t *);
+exp_call_t *exp_call_init(arena_t *, char *, l_list_t);
 
 /********************************************************************
  *                          Statements                              *
@@ -136,10 +186,7 @@ typedef struct {
   int line;
 } stmt_t;
 
-stmt_t *stmt_init(stmt_type_t, void *, int);
-stmt_t *stmt_dup(stmt_t *);
-void stmt_destroy(stmt_t *);
-void stmt_free(void *);
+stmt_t *stmt_init(arena_t *, stmt_type_t, void *, int);
 void *stmt_unwrap(stmt_t *);
 
 typedef struct {
@@ -148,65 +195,113 @@ typedef struct {
   stmt_t *else_branch;
 } stmt_conditional_t;
 
-stmt_conditional_t *stmt_conditional_init(exp_t *, stmt_t *, stmt_t *);
-stmt_conditional_t *stmt_conditional_dup(stmt_conditional_t *);
-void stmt_conditional_destroy(stmt_conditional_t *);
+stmt_conditional_t *stmt_conditional_init(arena_t *, exp_t *, stmt_t *,
+                                          stmt_t *);
 
 typedef struct {
   exp_t *exp;
 } stmt_print_t;
 
-stmt_print_t *stmt_print_init(exp_t *);
-stmt_print_t *stmt_print_dup(stmt_print_t *);
-void stmt_print_destroy(stmt_print_t *);
+stmt_print_t *stmt_print_init(arena_t *, exp_t *);
 
 typedef struct {
   exp_t *exp;
 } stmt_expr_t;
 
-stmt_expr_t *stmt_expr_init(exp_t *);
-stmt_expr_t *stmt_expr_dup(stmt_expr_t *);
-void stmt_expr_destroy(stmt_expr_t *);
+stmt_expr_t *stmt_expr_init(arena_t *, exp_t *);
 
 typedef struct {
   l_list_t statements;
 } stmt_block_t;
 
-stmt_block_t *stmt_block_init(l_list_t);
-stmt_block_t *stmt_block_dup(stmt_block_t *);
-void stmt_block_destroy(stmt_block_t *);
+stmt_block_t *stmt_block_init(arena_t *, l_list_t);
 
 typedef struct {
   char *identifier;
+  uint32_t symbol;
   exp_t *exp;
 } stmt_declaration_t;
 
-stmt_declaration_t *stmt_declaration_init(char *, exp_t *);
-stmt_declaration_t *stmt_declaration_dup(stmt_declaration_t *);
-void stmt_declaration_destroy(stmt_declaration_t *);
+stmt_declaration_t *stmt_declaration_init(arena_t *, char *, exp_t *);
 
 typedef stmt_declaration_t stmt_assignment_t;
 
-stmt_assignment_t *stmt_assignment_init(char *, exp_t *);
-stmt_assignment_t *stmt_assignment_dup(stmt_assignment_t *);
-void stmt_assignment_destroy(stmt_assignment_t *);
+stmt_assignment_t *stmt_assignment_init(arena_t *, char *, exp_t *);
 
+/**
+ * @param identifier the function name
+ * @param symbol the symbol of the name, assigned by the resolver
+ * @param formals the formals names
+ * @param arity the number of formals
+ * @param symbols the symbols of the formals, in the order of the formals list
+ * @param body the function body
+ * @param pure 1 if the purity analysis proved that the result depends only on
+ * the actuals (see purity.h)
+ */
 typedef struct {
   char *identifier;
+  uint32_t symbol;
   l_list_t formals;
+  uint32_t arity;
+  uint32_t *symbols;
   stmt_t *body;
+  int pure;
 } stmt_function_t;
 
-stmt_function_t *stmt_function_init(char *, l_list_t, stmt_t *);
-stmt_function_t *stmt_function_dup(stmt_function_t *);
-void stmt_function_destroy(stmt_function_t *);
+stmt_function_t *stmt_function_init(arena_t *, char *, l_list_t, stmt_t *);
+
+/**
+ * A function body skipped by a lazy parser, it is parsed on its first call
+ * @param parser the parser (a parser_t) owning the tokens of the body
+ * @param start the index of the '{' token opening the body
+ * @param body the parsed body, NULL until it is parsed
+ * @note Every closure of the function shares the same stmt_lazy_t, so a body
+ * is parsed at most once
+ */
+typedef struct {
+  void *parser;
+  int start;
+  stmt_t *body;
+} stmt_lazy_t;
+
+stmt_lazy_t *stmt_lazy_init(arena_t *, void *, int);
 
 operator_t token_to_operator(token_t);
 
+/**
+ * @param identifier the function name
+ * @param formals the formals names
+ * @param symbols the symbols of the formals, in the order of the formals list
+ * @param arity the number of formals
+ * @param body the function body
+ * @param code the index of the function node when the body lives in a flat
+ * AST (formals, symbols and body are then NULL)
+ * @param compiled the translated body when the closure is run by the direct
+ * interpreter (body is then NULL)
+ * @param calls the number of calls counted by the JIT
+ * @param jit the native code of the body (a jit_function_t), NULL until the
+ * closure becomes hot
+ * @param pure 1 if the calls of the closure are memoized, its function being
+ * pure, until they turn out not to repeat
+ * @param lookups the lookups of the memoized calls in the current window
+ * @param hits the results of the memoized calls found in the current window
+ * @note The names, symbols and bodies are borrowed from the program (AST arena,
+ * flat AST or direct nodes), which outlives its closures: creating a closure
+ * copies nothing
+ */
 typedef struct {
   char *identifier;
   l_list_t formals;
+  uint32_t *symbols;
+  uint32_t arity;
   stmt_t *body;
+  uint32_t code;
+  void *compiled;
+  uint32_t calls;
+  void *jit;
+  int pure;
+  uint32_t lookups;
+  uint32_t hits;
 } closure_t;
 
 #endif // !SYNTAX_H
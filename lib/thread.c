@@ -1,3 +1,54 @@
 #include "thread.h"
+#include "memory.h"
+#include <sched.h>
+#include <string.h>
 
-// TODO: add thread wrappers
\ No newline at end of file
+void channel_init(channel_t *c, size_t capacity, size_t element_size) {
+  size_t size = 1;
+  while (size < capacity)
+    size <<= 1;
+  c->buffer = mem_calloc(size, element_size);
+  c->element_size = element_size;
+  c->mask = size - 1;
+  atomic_init(&c->head, 0);
+  atomic_init(&c->tail, 0);
+  atomic_init(&c->closed, 0);
+  return;
+}
+
+void channel_destroy(channel_t *c) {
+  mem_free(c->buffer);
+  c->buffer = NULL;
+  return;
+}
+
+void channel_send(channel_t *c, const void *element) {
+  size_t tail = atomic_load_explicit(&c->tail, memory_order_relaxed);
+  while (tail - atomic_load_explicit(&c->head, memory_order_acquire) > c->mask)
+    sched_yield();
+  memcpy(c->buffer + (tail & c->mask) * c->element_size, element,
+         c->element_size);
+  atomic_store_explicit(&c->tail, tail + 1, memory_order_release);
+  return;
+}
+
+int channel_receive(channel_t *c, void *element) {
+  size_t head = atomic_load_explicit(&c->head, memory_order_relaxed);
+  while (atomic_load_explicit(&c->tail, memory_order_acquire) == head) {
+    // The tail must be checked again since it could have been moved right
+    // before closing the channel
+    if (atomic_load_explicit(&c->closed, memory_order_acquire) &&
+        atomic_load_explicit(&c->tail, memory_order_acquire) == head)
+      return 0;
+    sched_yield();
+  }
+  memcpy(element, c->buffer + (head & c->mask) * c->element_size,
+         c->element_size);
+  atomic_store_explicit(&c->head, head + 1, memory_order_release);
+  return 1;
+}
+
+void channel_close(channel_t *c) {
+  atomic_store_explicit(&c->closed, 1, memory_order_release);
+  return;
+}
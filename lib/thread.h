@@ -1,8 +1,67 @@
 #ifndef THREAD_H
 #define THREAD_H
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
 
 typedef pthread_mutex_t mutex;
 typedef pthread_cond_t cond;
 
+/**
+ * A bounded lock-free single producer single consumer queue
+ * @param buffer the ring buffer
+ * @param element_size the size (bytes) of a single element
+ * @param mask the capacity of the ring minus one (the capacity is a power of 2)
+ * @param head the index of the next element to receive (consumer side)
+ * @param tail the index of the next element to send (producer side)
+ * @param closed 1 if the producer will not send other elements
+ */
+typedef struct {
+  char *buffer;
+  size_t element_size;
+  size_t mask;
+  _Atomic size_t head;
+  _Atomic size_t tail;
+  _Atomic int closed;
+} channel_t;
+
+/**
+ * Initialize the given channel
+ * @param c a pointer to the channel to initialize
+ * @param capacity the maximum number of elements in flight (rounded up to a
+ * power of 2)
+ * @param element_size the size (bytes) of a single element
+ */
+void channel_init(channel_t *, size_t, size_t);
+
+/**
+ * Destroy the given channel
+ * @param c a pointer to the channel to destroy
+ */
+void channel_destroy(channel_t *);
+
+/**
+ * Copy an element at the end of the channel
+ * @param c a pointer to the channel
+ * @param element a pointer to the element to send
+ * @note Only one thread can send, the call yields while the channel is full
+ */
+void channel_send(channel_t *, const void *);
+
+/**
+ * Copy the first element of the channel and remove it
+ * @param c a pointer to the channel
+ * @param element a pointer where the element is copied
+ * @return 1 if an element was received, 0 if the channel is closed and empty
+ * @note Only one thread can receive, the call yields while the channel is
+ * empty
+ */
+int channel_receive(channel_t *, void *);
+
+/**
+ * Notify the consumer that no more elements will be sent
+ * @param c a pointer to the channel
+ */
+void channel_close(channel_t *);
+
 #endif // !THREAD_H
@@ -1,58 +1,82 @@
 #include "token.h"
 #include "errors.h"
-#include "list.h"
 #include "memory.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define TOKENS_INITIAL_CAPACITY 256
+#define NUMBER_BUFFER_SIZE 64
+
 static char *pretty_type(token_type_t);
 
-void token_free(void *token) {
-  token_t *t = (token_t *)token;
-  if (t->type != END)
-    mem_free(t->lexeme);
-  mem_free(t->literal);
-  mem_free(token);
+void token_print(const char *source, token_t tok) {
+  err_log(INFO, "Line:  %d\t\tLexeme: %.*s\t\t\tToken Type: %s\n", tok.line,
+          tok.length, source + tok.start, pretty_type(tok.type));
   return;
 }
 
-void token_print(token_t tok) {
-  err_log(INFO, "Line:  %d\t\tLexeme: %s\t\t\tToken Type: %s\n", tok.line,
-          tok.lexeme, pretty_type(tok.type));
+char *token_lexeme(const char *source, token_t tok) {
+  return strndup(source + tok.start, tok.length);
+}
+
+char *token_string(const char *source, token_t tok) {
+  // Skip the opening and closing '"'
+  return strndup(source + tok.start + 1, tok.length - 2);
+}
+
+double token_number(const char *source, token_t tok) {
+  // The lexeme is not NULL terminated and strtod would happily consume the
+  // characters of the following token (e.g. 1e5 is NUMBER IDENTIFIER)
+  char buffer[NUMBER_BUFFER_SIZE];
+  if (tok.length < NUMBER_BUFFER_SIZE) {
+    memcpy(buffer, source + tok.start, tok.length);
+    buffer[tok.length] = '\0';
+    return atof(buffer);
+  }
+  char *text = token_lexeme(source, tok);
+  double value = atof(text);
+  mem_free(text);
+  return value;
+}
+
+void tokens_init(token_vector_t *tokens) {
+  memset(tokens, 0, sizeof(*tokens));
+  tokens->data = NULL;
+  tokens->count = 0;
+  tokens->capacity = 0;
   return;
 }
 
-void tokens_print(l_list_t tokens) {
-  l_list_t current = list_reverse(tokens);
-  while (current) {
-    token_print(*(token_t *)current->data);
-    current = current->next;
+token_t *tokens_push(token_vector_t *tokens, token_t tok) {
+  if (tokens->count == tokens->capacity) {
+    tokens->capacity = tokens->capacity ? tokens->capacity * 2
+                                        : TOKENS_INITIAL_CAPACITY;
+    tokens->data =
+        mem_realloc(tokens->data, tokens->capacity * sizeof(token_t));
   }
+  tokens->data[tokens->count] = tok;
+  return &tokens->data[tokens->count++];
+}
+
+void tokens_print(const char *source, token_vector_t tokens) {
+  for (int i = 0; i < tokens.count; i++)
+    token_print(source, tokens.data[i]);
   return;
 }
 
-token_t *tokens_get(l_list_t tokens, int index) {
-  if (index >= list_len(tokens))
+token_t *tokens_get(token_vector_t *tokens, int index) {
+  if (index < 0 || index >= tokens->count)
     return NULL;
-  l_list_t current = tokens;
-  for (int i = 0; i < index; i++) {
-    current = current->next;
-  }
-  return current->data;
+  return &tokens->data[index];
 }
 
-void tokens_dup(l_list_t source, l_list_t *dest) {
-  l_list_t head = source;
-  while (head) {
-    token_t *duped = mem_calloc(1, sizeof(token_t));
-    token_t *tok = (token_t *)head->data;
-    duped->line = tok->line;
-    duped->type = tok->type;
-    duped->lexeme = tok->type != END ? strdup(tok->lexeme) : "";
-    duped->literal = tok->literal ? strdup(tok->literal) : NULL;
-    list_add(dest, duped);
-    head = head->next;
-  }
+void tokens_destroy(token_vector_t *tokens) {
+  mem_free(tokens->data);
+  tokens->data = NULL;
+  tokens->count = 0;
+  tokens->capacity = 0;
+  return;
 }
 
 char *pretty_type(token_type_t type) {
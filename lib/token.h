@@ -1,6 +1,5 @@
 #ifndef TOKEN_H
 #define TOKEN_H
-#include "list.h"
 
 typedef enum {
   // Single-character tokens.
@@ -56,50 +55,98 @@ typedef enum {
 
 /**
  * @brief A lexical token
- * @param char *lexeme: The sequence of characters that match the pattern for a
- * token
- * @param void *literal: Numerical, logical or textual values
+ * @param int start: The offset of the first character of the lexeme in the
+ * source code
+ * @param int length: The length (bytes) of the lexeme
  * @param int line: The line number in the source code
+ * @note A token do not own any memory, the lexeme and the literal are
+ * materialized from the source only when needed
  */
 typedef struct {
   token_type_t type;
-  char *lexeme;
-  void *literal;
+  int start;
+  int length;
   int line;
 } token_t;
 
+/**
+ * @brief A growable contiguous array of tokens
+ * @param token_t *data: The tokens, in source order
+ * @param int count: The number of tokens stored
+ * @param int capacity: The number of allocated slots
+ */
+typedef struct {
+  token_t *data;
+  int count;
+  int capacity;
+} token_vector_t;
+
 /**
  * @brief Print the given token to the standard error
+ * @param const char *source: the source code the token belongs to
  * @param token_t: the token to print
  */
-void token_print(token_t);
+void token_print(const char *, token_t);
+
+/**
+ * @brief Materialize the lexeme of the given token
+ * @param const char *source: the source code the token belongs to
+ * @param token_t token: the token
+ * @return char* a new NULL terminated string (must be freed by the caller)
+ */
+char *token_lexeme(const char *, token_t);
+
+/**
+ * @brief Materialize the literal of a STRING token
+ * @param const char *source: the source code the token belongs to
+ * @param token_t token: the token
+ * @return char* a new NULL terminated string without the surrounding quotes
+ * (must be freed by the caller)
+ */
+char *token_string(const char *, token_t);
+
+/**
+ * @brief Materialize the literal of a NUMBER token
+ * @param const char *source: the source code the token belongs to
+ * @param token_t token: the token
+ * @return double the numerical value of the token
+ */
+double token_number(const char *, token_t);
+
+/**
+ * @brief Initialize an empty token vector
+ * @param token_vector_t *tokens: the vector to initialize
+ */
+void tokens_init(token_vector_t *);
 
 /**
- * @brief Print the given token list
- * @param List: the token list to print
+ * @brief Append a token at the end of the given vector
+ * @param token_vector_t *tokens: the vector
+ * @param token_t token: the token to append (copied by value)
+ * @return token_t* a pointer to the stored token
+ * @note The returned pointer is invalidated by the next push
  */
-void tokens_print(l_list_t);
+token_t *tokens_push(token_vector_t *, token_t);
 
 /**
- * @brief duplicate a given list of tokens inside another
- * @param List source: The list to duplicate
- * @param List *destination: The list* where to duplicate
+ * @brief Print the given token vector
+ * @param const char *source: the source code the tokens belong to
+ * @param token_vector_t tokens: the token vector to print
  */
-void tokens_dup(l_list_t, l_list_t *);
+void tokens_print(const char *, token_vector_t);
 
 /**
- * @brief Get the token at the given position from the given list
- * @param List tokens: the token list
+ * @brief Get the token at the given position from the given vector in O(1)
+ * @param token_vector_t *tokens: the token vector
  * @param int position: the position to retrieve
- * @return token_t* a token pointer if position < list_len(tokens) or NULL
+ * @return token_t* a token pointer if 0 <= position < tokens->count or NULL
  */
-token_t *tokens_get(l_list_t, int);
+token_t *tokens_get(token_vector_t *, int);
 
 /**
- * @brief Clear all the allocated data for a token
- * @param void* token: the token to deallocate
- * @note the token is void* because the list_free need a void* free callback
+ * @brief Free the storage of a token vector
+ * @param token_vector_t *tokens: the vector to deallocate
  */
-void token_free(void *);
+void tokens_destroy(token_vector_t *);
 
 #endif // !TOKEN_H
@@ -0,0 +1,106 @@
+#ifndef VALUE_H
+#define VALUE_H
+#include "syntax.h"
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * A value of the Lotus language, NaN-boxed in 64 bits. A number is stored as
+ * its double; every other value is a quiet NaN with the bits 50 and 51 set,
+ * which no arithmetic produces (the default NaN of x86 is 0xfff8...): nil and
+ * the booleans are tagged in the low bits, strings and closures also have the
+ * sign bit set and point to an object on the GC heap.
+ */
+typedef uint64_t value_t;
+
+#define VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+#define VALUE_SIGN ((uint64_t)0x8000000000000000)
+#define VALUE_NIL (VALUE_QNAN | 1)
+#define VALUE_FALSE (VALUE_QNAN | 2)
+#define VALUE_TRUE (VALUE_QNAN | 3)
+// Never seen by a program, it marks a symbol without a binding
+#define VALUE_UNBOUND (VALUE_QNAN | 4)
+
+/**
+ * The header of a value living on the GC heap
+ * @param type T_STRING or T_CLOSURE
+ * @param status the mark of the GC
+ * @param next the next object tracked by the GC
+ */
+typedef struct object {
+  literal_type_t type;
+  int status;
+  struct object *next;
+} object_t;
+
+/**
+ * A string on the GC heap, the characters follow the header
+ */
+typedef struct {
+  object_t object;
+  char chars[];
+} string_t;
+
+/**
+ * A closure on the GC heap
+ */
+typedef struct {
+  object_t object;
+  closure_t closure;
+} closure_object_t;
+
+static inline value_t value_number(double n) {
+  value_t v;
+  memcpy(&v, &n, sizeof(double));
+  return v;
+}
+
+static inline double value_as_number(value_t v) {
+  double n;
+  memcpy(&n, &v, sizeof(double));
+  return n;
+}
+
+static inline value_t value_boolean(int b) {
+  return b ? VALUE_TRUE : VALUE_FALSE;
+}
+
+static inline int value_as_boolean(value_t v) { return v == VALUE_TRUE; }
+
+static inline value_t value_object(object_t *o) {
+  return VALUE_SIGN | VALUE_QNAN | (uint64_t)(uintptr_t)o;
+}
+
+static inline object_t *value_as_object(value_t v) {
+  return (object_t *)(uintptr_t)(v & ~(VALUE_SIGN | VALUE_QNAN));
+}
+
+static inline int value_is_number(value_t v) {
+  return (v & VALUE_QNAN) != VALUE_QNAN;
+}
+
+static inline int value_is_boolean(value_t v) {
+  return (v | 1) == VALUE_TRUE;
+}
+
+static inline int value_is_object(value_t v) {
+  return (v & (VALUE_SIGN | VALUE_QNAN)) == (VALUE_SIGN | VALUE_QNAN);
+}
+
+static inline literal_type_t value_type(value_t v) {
+  if (value_is_number(v))
+    return T_NUMBER;
+  if (value_is_object(v))
+    return value_as_object(v)->type;
+  return v == VALUE_NIL ? T_NIL : T_BOOLEAN;
+}
+
+static inline const char *value_as_string(value_t v) {
+  return ((string_t *)value_as_object(v))->chars;
+}
+
+static inline closure_t *value_as_closure(value_t v) {
+  return &((closure_object_t *)value_as_object(v))->closure;
+}
+
+#endif // !VALUE_H
@@ -0,0 +1,480 @@
+#include "vm.h"
+#include "bytecode.h"
+#include "garbage.h"
+#include "interpreter.h"
+#include "memory.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// The dispatch jumps through a table of label addresses (a GNU extension)
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/**
+ * Read a 32 bit operand
+ * @param ip a pointer to the operand
+ * @return the operand
+ */
+static inline uint32_t operand(const uint8_t *);
+/**
+ * Shadow the current binding of a symbol
+ * @param vm a pointer to the virtual machine
+ * @param symbol the symbol to bind
+ * @param v the new value
+ */
+static inline void bind(vm_t *, uint32_t, vm_value_t);
+/**
+ * Drop the bindings made after the trail had the given length
+ * @param vm a pointer to the virtual machine
+ * @param length the length of the trail to restore
+ */
+static inline void restore(vm_t *, uint32_t);
+/**
+ * Drop the bindings made after the trail had the given length that shadow a
+ * binding made after it too, like env_squash does
+ * @param vm a pointer to the virtual machine
+ * @param length the length of the trail when the bindings began
+ */
+static void squash(vm_t *, uint32_t);
+/**
+ * Check if the two given values are equal
+ * @param vm a pointer to the virtual machine
+ * @param l the left side value
+ * @param r the right side value
+ * @return 1 if they are equal, 0 otherwise
+ */
+static int is_equal(vm_t *, vm_value_t, vm_value_t);
+/**
+ * Concatenate two strings, the result is owned by the virtual machine
+ * @param vm a pointer to the virtual machine
+ * @param l the left side string
+ * @param r the right side string
+ * @return the new string
+ */
+static const char *str_concat(vm_t *, const char *, const char *);
+/**
+ * Pretty print a value, like the tree walker does
+ * @param vm a pointer to the virtual machine
+ * @param v the value to print
+ */
+static void print(vm_t *, vm_value_t);
+
+void vm_init(vm_t *vm, bytecode_t *b, interpreter_t *interpreter) {
+  memset(vm, 0, sizeof(*vm));
+  vm->bytecode = b;
+  vm->interpreter = interpreter;
+  vm->values = NULL;
+  vm->stack = NULL;
+  vm->trail = NULL;
+  vm->scopes = NULL;
+  vm->frames = NULL;
+  vm->marks = NULL;
+  vm->strings = NULL;
+  return;
+}
+
+void vm_destroy(vm_t *vm) {
+  for (uint32_t k = 0; k < vm->strings_count; k++)
+    mem_free(vm->strings[k]);
+  mem_free(vm->values);
+  mem_free(vm->stack);
+  mem_free(vm->trail);
+  mem_free(vm->scopes);
+  mem_free(vm->frames);
+  mem_free(vm->marks);
+  mem_free(vm->strings);
+  vm_init(vm, NULL, NULL);
+  return;
+}
+
+void vm_run(vm_t *vm, uint32_t entry) {
+  static void *const dispatch[] = {
+      [BC_CONSTANT] = &&op_constant,
+      [BC_NIL] = &&op_nil,
+      [BC_TRUE] = &&op_true,
+      [BC_FALSE] = &&op_false,
+      [BC_GET] = &&op_get,
+      [BC_DEFINE] = &&op_define,
+      [BC_SET] = &&op_set,
+      [BC_POP] = &&op_pop,
+      [BC_NEGATE] = &&op_negate,
+      [BC_NOT] = &&op_not,
+      [BC_ADD] = &&op_add,
+      [BC_SUBTRACT] = &&op_subtract,
+      [BC_MULTIPLY] = &&op_multiply,
+      [BC_DIVIDE] = &&op_divide,
+      [BC_MOD] = &&op_mod,
+      [BC_GREATER] = &&op_greater,
+      [BC_GREATER_EQUAL] = &&op_greater_equal,
+      [BC_LESS] = &&op_less,
+      [BC_LESS_EQUAL] = &&op_less_equal,
+      [BC_EQUAL] = &&op_equal,
+      [BC_NOT_EQUAL] = &&op_not_equal,
+      [BC_AND] = &&op_and,
+      [BC_OR] = &&op_or,
+      [BC_BOOLEAN] = &&op_boolean,
+      [BC_JUMP] = &&op_jump,
+      [BC_JUMP_IF_FALSE] = &&op_jump_if_false,
+      [BC_PRINT] = &&op_print,
+      [BC_CLOSURE] = &&op_closure,
+      [BC_CALL] = &&op_call,
+      [BC_TAIL_CALL] = &&op_call,
+      [BC_RETURN] = &&op_return,
+      [BC_SCOPE_ENTER] = &&op_scope_enter,
+      [BC_SCOPE_EXIT] = &&op_scope_exit,
+      [BC_FAIL] = &&op_fail,
+      [BC_HALT] = &&op_halt,
+  };
+  bytecode_t *b = vm->bytecode;
+  interpreter_t *i = vm->interpreter;
+  // Symbols interned since the last run start unbound
+  if (vm->values_count < b->symbols_count) {
+    uint32_t capacity = vm->values_count;
+    vm->values =
+        mem_reserve(vm->values, &capacity, b->symbols_count,
+                    sizeof(vm_value_t));
+    vm->marks = mem_realloc(vm->marks, capacity * sizeof(uint32_t));
+    for (uint32_t k = vm->values_count; k < capacity; k++) {
+      vm->values[k].type = VM_UNBOUND;
+      vm->marks[k] = 0;
+    }
+    vm->values_count = capacity;
+  }
+  vm->stack = mem_reserve(vm->stack, &vm->stack_capacity, b->max_stack + 1,
+                          sizeof(vm_value_t));
+  const uint8_t *code = b->code;
+  const uint8_t *ip = code + entry;
+  vm_value_t *values = vm->values;
+  vm_value_t *sp = vm->stack;
+  uint32_t symbol, target;
+
+#define READ() (ip += sizeof(uint32_t), operand(ip - sizeof(uint32_t)))
+#define DISPATCH() goto *dispatch[*ip++]
+#define NUMBERS()                                                              \
+  if (sp[-2].type != T_NUMBER || sp[-1].type != T_NUMBER)                      \
+    interpreter_error(i, "Type Error:\t Operands must be numbers\n");
+#define ARITHMETIC(operator)                                                   \
+  NUMBERS();                                                                   \
+  sp[-2].as.number = sp[-2].as.number operator sp[-1].as.number;               \
+  sp--;                                                                        \
+  DISPATCH();
+#define COMPARISON(operator)                                                   \
+  NUMBERS();                                                                   \
+  sp[-2].as.boolean = sp[-2].as.number operator sp[-1].as.number;              \
+  sp[-2].type = T_BOOLEAN;                                                     \
+  sp--;                                                                        \
+  DISPATCH();
+
+  DISPATCH();
+op_constant:
+  *sp++ = b->constants[READ()];
+  DISPATCH();
+op_nil:
+  sp->type = T_NIL;
+  sp++;
+  DISPATCH();
+op_true:
+  sp->type = T_BOOLEAN;
+  sp->as.boolean = 1;
+  sp++;
+  DISPATCH();
+op_false:
+  sp->type = T_BOOLEAN;
+  sp->as.boolean = 0;
+  sp++;
+  DISPATCH();
+op_get:
+  symbol = READ();
+  if (__builtin_expect(values[symbol].type == VM_UNBOUND, 0))
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      b->symbols[symbol]);
+  *sp++ = values[symbol];
+  DISPATCH();
+op_define:
+  bind(vm, READ(), sp[-1]);
+  DISPATCH();
+op_set:
+  // Like env_set, assigning an undeclared identifier does nothing
+  symbol = READ();
+  if (values[symbol].type != VM_UNBOUND)
+    values[symbol] = sp[-1];
+  DISPATCH();
+op_pop:
+  sp--;
+  DISPATCH();
+op_negate:
+  if (sp[-1].type != T_NUMBER)
+    interpreter_error(i, "Type Error:\t Operand must be a number\n");
+  sp[-1].as.number = -sp[-1].as.number;
+  DISPATCH();
+op_not:
+  if (sp[-1].type != T_BOOLEAN)
+    interpreter_error(i, "Type Error:\tImplicit casting is not permitted!\n");
+  sp[-1].as.boolean = !sp[-1].as.boolean;
+  DISPATCH();
+op_add:
+  if (sp[-2].type == T_NUMBER && sp[-1].type == T_NUMBER)
+    sp[-2].as.number += sp[-1].as.number;
+  else if (sp[-2].type == T_STRING && sp[-1].type == T_STRING)
+    sp[-2].as.string = str_concat(vm, sp[-2].as.string, sp[-1].as.string);
+  else
+    interpreter_error(
+        i, "Type Error:\t Operands must be two numbers or two strings\n");
+  sp--;
+  DISPATCH();
+op_subtract:
+  ARITHMETIC(-);
+op_multiply:
+  ARITHMETIC(*);
+op_divide:
+  ARITHMETIC(/);
+op_mod:
+  NUMBERS();
+  sp[-2].as.number = fmod(sp[-2].as.number, sp[-1].as.number);
+  sp--;
+  DISPATCH();
+op_greater:
+  COMPARISON(>);
+op_greater_equal:
+  COMPARISON(>=);
+op_less:
+  COMPARISON(<);
+op_less_equal:
+  COMPARISON(<=);
+op_equal:
+  sp[-2].as.boolean = is_equal(vm, sp[-2], sp[-1]);
+  sp[-2].type = T_BOOLEAN;
+  sp--;
+  DISPATCH();
+op_not_equal:
+  sp[-2].as.boolean = !is_equal(vm, sp[-2], sp[-1]);
+  sp[-2].type = T_BOOLEAN;
+  sp--;
+  DISPATCH();
+op_and:
+  target = READ();
+  if (sp[-1].type != T_BOOLEAN)
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+  if (!sp[-1].as.boolean)
+    ip = code + target;
+  else
+    sp--;
+  DISPATCH();
+op_or:
+  target = READ();
+  if (sp[-1].type != T_BOOLEAN)
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+  if (sp[-1].as.boolean)
+    ip = code + target;
+  else
+    sp--;
+  DISPATCH();
+op_boolean:
+  if (sp[-1].type != T_BOOLEAN)
+    interpreter_error(i, "Type Error:\t Operands must be booleans\n");
+  DISPATCH();
+op_jump:
+  ip = code + operand(ip);
+  DISPATCH();
+op_jump_if_false:
+  target = READ();
+  sp--;
+  if (sp->type != T_BOOLEAN)
+    interpreter_error(i, "Type Error:\tImplicit casting is not permitted!\n");
+  if (!sp->as.boolean)
+    ip = code + target;
+  DISPATCH();
+op_print:
+  print(vm, *--sp);
+  DISPATCH();
+op_closure:
+  sp->type = T_CLOSURE;
+  sp->as.function = READ();
+  sp++;
+  DISPATCH();
+op_call: {
+  int tail = ip[-1] == BC_TAIL_CALL;
+  symbol = READ();
+  uint32_t count = READ();
+  int forwarded = *ip++;
+  // The closure is looked up after the actuals are evaluated
+  vm_value_t closure = values[symbol];
+  if (closure.type == VM_UNBOUND)
+    interpreter_error(i, "The identifier '%s' was not declared\n",
+                      b->symbols[symbol]);
+  if (closure.type != T_CLOSURE)
+    interpreter_error(i, "The identifier '%s' is not a function name\n",
+                      b->symbols[symbol]);
+  bc_function_t *f = &b->functions[closure.as.function];
+  if (f->arity != count)
+    interpreter_error(i,
+                      "actuals number and formals number are not the same");
+  vm_value_t *base = sp - count;
+  vm_frame_t *frame;
+  if (tail) {
+    // The callee replaces the current call, the frame is reused
+    frame = &vm->frames[vm->frames_count - 1];
+  } else {
+    if (i->max_depth && vm->frames_count >= i->max_depth)
+      interpreter_error(i, "Stack overflow\n");
+    vm->frames = mem_reserve(vm->frames, &vm->frames_capacity,
+                             vm->frames_count + 1, sizeof(vm_frame_t));
+    frame = &vm->frames[vm->frames_count++];
+    frame->ip = ip;
+    frame->trail = vm->trail_count;
+    frame->scopes = vm->scopes_count;
+    frame->base = base - vm->stack;
+  }
+  // The actuals were pushed from the last one, a forwarded value first; the
+  // formals are bound from the last one, like env_bulk_bind does
+  const uint32_t *formals = b->formals + f->formals;
+  for (uint32_t j = count; j-- > 0;) {
+    uint32_t slot = forwarded ? (j == 0 ? 0 : count - j) : count - 1 - j;
+    bind(vm, formals[j], base[slot]);
+  }
+  if (tail) {
+    // The scopes of the caller are left open and the bindings shadowed since
+    // the call began are squashed, a loop of tail calls keeps the trail size
+    vm->scopes_count = frame->scopes;
+    squash(vm, frame->trail);
+  }
+  if (frame->base + f->max_stack + 1 > vm->stack_capacity)
+    vm->stack = mem_reserve(vm->stack, &vm->stack_capacity,
+                            frame->base + f->max_stack + 1, sizeof(vm_value_t));
+  sp = vm->stack + frame->base;
+  ip = code + f->entry;
+  DISPATCH();
+}
+op_return: {
+  vm_value_t result = sp[-1];
+  vm_frame_t *frame = &vm->frames[--vm->frames_count];
+  restore(vm, frame->trail);
+  vm->scopes_count = frame->scopes;
+  sp = vm->stack + frame->base;
+  *sp++ = result;
+  ip = frame->ip;
+  DISPATCH();
+}
+op_scope_enter:
+  vm->scopes = mem_reserve(vm->scopes, &vm->scopes_capacity,
+                           vm->scopes_count + 1, sizeof(uint32_t));
+  vm->scopes[vm->scopes_count++] = vm->trail_count;
+  DISPATCH();
+op_scope_exit:
+  restore(vm, vm->scopes[--vm->scopes_count]);
+  DISPATCH();
+op_fail:
+  interpreter_error(i, "%s", b->constants[READ()].as.string);
+op_halt:
+  return;
+
+#undef COMPARISON
+#undef ARITHMETIC
+#undef NUMBERS
+#undef DISPATCH
+#undef READ
+}
+
+uint32_t operand(const uint8_t *ip) {
+  uint32_t value;
+  memcpy(&value, ip, sizeof(uint32_t));
+  return value;
+}
+
+void bind(vm_t *vm, uint32_t symbol, vm_value_t v) {
+  if (__builtin_expect(vm->trail_count == vm->trail_capacity, 0))
+    vm->trail = mem_reserve(vm->trail, &vm->trail_capacity, vm->trail_count + 1,
+                            sizeof(vm_binding_t));
+  vm_binding_t *binding = &vm->trail[vm->trail_count++];
+  binding->symbol = symbol;
+  binding->old = vm->values[symbol];
+  vm->values[symbol] = v;
+  return;
+}
+
+void restore(vm_t *vm, uint32_t length) {
+  while (vm->trail_count > length) {
+    vm_binding_t *binding = &vm->trail[--vm->trail_count];
+    vm->values[binding->symbol] = binding->old;
+  }
+  return;
+}
+
+void squash(vm_t *vm, uint32_t length) {
+  // A new epoch makes the marks of the previous squashes stale
+  if (++vm->epoch == 0) {
+    memset(vm->marks, 0, vm->values_count * sizeof(uint32_t));
+    vm->epoch = 1;
+  }
+  uint32_t count = length;
+  for (uint32_t k = length; k < vm->trail_count; k++) {
+    vm_binding_t binding = vm->trail[k];
+    if (vm->marks[binding.symbol] == vm->epoch)
+      continue;
+    vm->marks[binding.symbol] = vm->epoch;
+    vm->trail[count++] = binding;
+  }
+  vm->trail_count = count;
+  return;
+}
+
+int is_equal(vm_t *vm, vm_value_t l, vm_value_t r) {
+  if (l.type != r.type)
+    interpreter_error(vm->interpreter,
+                      "Type Error:\tComparison between 2 different type!\n");
+  switch (l.type) {
+  case T_NUMBER:
+    return l.as.number == r.as.number;
+  case T_NIL:
+    return 1;
+  case T_BOOLEAN:
+    return l.as.boolean == r.as.boolean;
+  case T_STRING:
+    return strcmp(l.as.string, r.as.string) == 0;
+  default:
+    interpreter_error(vm->interpreter,
+                      "Type Error:\t Functions cannot be compared\n");
+  }
+}
+
+const char *str_concat(vm_t *vm, const char *l, const char *r) {
+  size_t left = strlen(l);
+  size_t right = strlen(r);
+  char *s = mem_calloc(left + right + 1, sizeof(char));
+  memcpy(s, l, left);
+  memcpy(s + left, r, right);
+  vm->strings = mem_reserve(vm->strings, &vm->strings_capacity,
+                            vm->strings_count + 1, sizeof(char *));
+  vm->strings[vm->strings_count++] = s;
+  return s;
+}
+
+void print(vm_t *vm, vm_value_t v) {
+  closure_object_t closure;
+  switch (v.type) {
+  case T_NUMBER:
+    interpreter_print(value_number(v.as.number));
+    break;
+  case T_BOOLEAN:
+    interpreter_print(value_boolean(v.as.boolean));
+    break;
+  case T_STRING:
+    // The characters of a string object follow its header, they are not
+    // copied just to be printed
+    printf("%s\n", v.as.string);
+    fflush(stdout);
+    break;
+  case T_CLOSURE:
+    memset(&closure, 0, sizeof(closure));
+    closure.object.type = T_CLOSURE;
+    closure.closure.identifier =
+        vm->bytecode->symbols[vm->bytecode->functions[v.as.function].name];
+    interpreter_print(value_object(&closure.object));
+    break;
+  default:
+    interpreter_print(VALUE_NIL);
+    break;
+  }
+  return;
+}
@@ -0,0 +1,93 @@
+#ifndef VM_H
+#define VM_H
+#include "bytecode.h"
+#include "interpreter.h"
+#include <stdint.h>
+
+/**
+ * A binding shadowed by a newer one, restored when the scope ends
+ * @param symbol the symbol bound
+ * @param old the value bound before
+ */
+typedef struct {
+  uint32_t symbol;
+  vm_value_t old;
+} vm_binding_t;
+
+/**
+ * The state of the caller of a function
+ * @param ip the instruction following the call
+ * @param trail the length of the trail before binding the formals
+ * @param scopes the number of open scopes
+ * @param base the stack slot where the result is pushed
+ */
+typedef struct {
+  const uint8_t *ip;
+  uint32_t trail;
+  uint32_t scopes;
+  uint32_t base;
+} vm_frame_t;
+
+/**
+ * A virtual machine running bytecode, identifiers are resolved by shallow
+ * binding: every symbol has a slot holding its current value and the
+ * shadowed values are kept in a trail
+ * @param bytecode a pointer to the code to run
+ * @param interpreter a pointer to the interpreter used to report errors
+ * @param values the current value of every symbol
+ * @param stack the operands stack
+ * @param trail the shadowed bindings
+ * @param scopes the length of the trail when each open scope began
+ * @param frames the active calls
+ * @param marks the last squash of the trail that met every symbol
+ * @param epoch the number of squashes of the trail
+ * @param strings the strings built while running (owned)
+ */
+typedef struct {
+  bytecode_t *bytecode;
+  interpreter_t *interpreter;
+  vm_value_t *values;
+  uint32_t values_count;
+  vm_value_t *stack;
+  uint32_t stack_capacity;
+  vm_binding_t *trail;
+  uint32_t trail_count;
+  uint32_t trail_capacity;
+  uint32_t *scopes;
+  uint32_t scopes_count;
+  uint32_t scopes_capacity;
+  vm_frame_t *frames;
+  uint32_t frames_count;
+  uint32_t frames_capacity;
+  uint32_t *marks;
+  uint32_t epoch;
+  char **strings;
+  uint32_t strings_count;
+  uint32_t strings_capacity;
+} vm_t;
+
+/**
+ * Initialize the given virtual machine
+ * @param vm a pointer to the virtual machine to initialize
+ * @param b a pointer to the bytecode to run
+ * @param interpreter a pointer to the interpreter used to report errors
+ */
+void vm_init(vm_t *, bytecode_t *, interpreter_t *);
+
+/**
+ * Run the bytecode from the given instruction until BC_HALT
+ * @param vm a pointer to the virtual machine
+ * @param entry the offset of the first instruction
+ * @note The bindings survive between runs, so the bytecode can be extended
+ * and run one statement at a time
+ */
+void vm_run(vm_t *, uint32_t);
+
+/**
+ * Destroy the given virtual machine
+ * @param vm a pointer to the virtual machine to destroy
+ * @note The bytecode is not destroyed
+ */
+void vm_destroy(vm_t *);
+
+#endif // !VM_H
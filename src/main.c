@@ -1,29 +1,100 @@
+#include "../lib/arena.h"
+#include "../lib/bytecode.h"
+#include "../lib/c_compiler.h"
+#include "../lib/cache.h"
 #include "../lib/config.h"
+#include "../lib/direct_interpreter.h"
+#include "../lib/jit.h"
 #include "../lib/environment.h"
+#include "../lib/flat.h"
+#include "../lib/flat_interpreter.h"
 #include "../lib/garbage.h"
 #include "../lib/interpreter.h"
 #include "../lib/list.h"
+#include "../lib/memo.h"
+#include "../lib/memory.h"
+#include "../lib/optimizer.h"
 #include "../lib/parser.h"
+#include "../lib/purity.h"
+#include "../lib/resolver.h"
 #include "../lib/scanner.h"
+#include "../lib/stackless_interpreter.h"
+#include "../lib/vm.h"
 #include <bits/types/siginfo_t.h>
 #include <errno.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <time.h>
+#include <unistd.h>
 
-static l_list_t run_scanner(const char *);
-static l_list_t run_parser(l_list_t);
+#define PIPELINE_TOKENS_CAPACITY 4096
+#define PIPELINE_STATEMENTS_CAPACITY 256
+
+typedef enum {
+  PHASE_SCAN = 1,
+  PHASE_PARSE,
+  PHASE_ALL,
+} phase_t;
+
+typedef enum {
+  ENGINE_TREE,
+  ENGINE_FLAT,
+  ENGINE_VM,
+  ENGINE_DIRECT,
+  ENGINE_STACKLESS,
+} engine_t;
+
+static token_vector_t run_scanner(const char *);
+static l_list_t run_parser(token_vector_t);
+static int run_resolver(l_list_t);
+static void run_optimizer(l_list_t);
+static void run_purity(l_list_t);
+static flat_index_t run_lowering(l_list_t);
+static uint32_t run_compiler(l_list_t);
+static int run_emitter(l_list_t);
+static int run_cache_load(const char *);
+static void run_cache_store(void);
 static void run_interpreter(l_list_t);
+static void run_pipeline(const char *);
+static void calls_report(void);
+static void quick_report(void);
+static void memo_report(void);
+static void jit_start(void);
+static void jit_stop(void);
+static void *pipeline_scanner(void *);
+static void *pipeline_parser(void *);
 static void set_config(void);
+static const char *set_options(int, char *[]);
+static void usage(void);
+static double elapsed_ms(struct timespec, struct timespec);
+static long max_rss_kib(void);
 static void *sig_handler(void *);
 static void clean(void);
 
 static int scanner_error = 0;
 static int parser_error = 0;
 static int show_reports = 0;
+static int show_stats = 0;
+static phase_t stop_after = PHASE_ALL;
+static int pipeline = 0;
+static engine_t engine = ENGINE_TREE;
+static int jobs = 0;
+static int use_cache = 0;
+static int descent = 0;
+static int lazy = 0;
+static int eager_check = 0;
+static int fold = 1;
+static long memo_size = MEMO_SIZE;
+static int use_jit = 0;
+static uint32_t jit_threshold = JIT_THRESHOLD;
+// -1 until set, then 0 for no limit
+static long max_depth = -1;
+static const char *emit_c_file = NULL;
 
 static int scanner_alive = 0;
 static int parser_alive = 0;
@@ -32,6 +103,19 @@ static int sig_handler_alive = 1;
 
 static scanner_t scanner;
 static parser_t parser;
+static arena_t ast_arena;
+static flat_ast_t flat_ast;
+static flat_index_t flat_program;
+static bytecode_t bytecode;
+static uint32_t bytecode_entry;
+static vm_t vm;
+static jit_t jit;
+static char *cache_file = NULL;
+static uint64_t source_hash;
+static uint64_t source_size;
+static resolver_t resolver;
+static optimizer_t optimizer;
+static memo_t memo;
 static interpreter_t interpreter;
 static env_t environment;
 static garbage_collector_t garbage_collector;
@@ -49,64 +133,503 @@ int main(int argc, char *argv[]) {
   pthread_create(&sig_handler_thread, NULL, sig_handler, NULL);
   // Input validation
   set_config();
-  if (argc != 2) {
-    printf("Usage: main [filename]\n");
+  const char *filename = set_options(argc, argv);
+  if (filename == NULL) {
+    usage();
     return EXIT_FAILURE;
   }
-  l_list_t tokens = run_scanner(argv[1]);
-  if (scanner_error) {
-    list_free(tokens, token_free);
-    exit(EXIT_FAILURE);
+  if (pipeline) {
+    run_pipeline(filename);
+    sig_handler_alive = 0;
+    pthread_join(sig_handler_thread, NULL);
+    return (scanner_error || parser_error) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+  if (use_cache && run_cache_load(filename)) {
+    // Scanner and parser are skipped, the cached flat AST is run as it is
+    if (stop_after == PHASE_ALL) {
+      resolver_init(&resolver);
+      resolver_resolve_flat(&resolver, &flat_ast);
+      run_interpreter(NULL);
+      resolver_destroy(&resolver);
+    } else
+      flat_destroy(&flat_ast);
+    sig_handler_alive = 0;
+    pthread_join(sig_handler_thread, NULL);
+    return EXIT_SUCCESS;
+  }
+  token_vector_t tokens = run_scanner(filename);
+  if (scanner_error || stop_after == PHASE_SCAN) {
+    tokens_destroy(&tokens);
+    scanner_destroy(scanner);
+    exit(scanner_error ? EXIT_FAILURE : EXIT_SUCCESS);
   }
   l_list_t statements = run_parser(tokens);
-  if (parser_error) {
-    list_free(statements, stmt_free);
+  // Tokens are slices of the source, so it can be released only now (a lazy
+  // parser still needs them to parse the function bodies)
+  if (!lazy) {
+    scanner_destroy(scanner);
+    scanner_alive = 0;
+  }
+  if (parser_error || stop_after == PHASE_PARSE) {
+    arena_destroy(&ast_arena);
+    exit(parser_error ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+  if (!run_resolver(statements)) {
+    resolver_destroy(&resolver);
+    arena_destroy(&ast_arena);
     exit(EXIT_FAILURE);
   }
+  if (fold)
+    run_optimizer(statements);
+  if (memo_size)
+    run_purity(statements);
+  if (emit_c_file) {
+    // The program is translated, not run
+    int emitted = run_emitter(statements);
+    resolver_destroy(&resolver);
+    arena_destroy(&ast_arena);
+    sig_handler_alive = 0;
+    pthread_join(sig_handler_thread, NULL);
+    return emitted ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  if (engine == ENGINE_FLAT) {
+    flat_program = run_lowering(statements);
+    resolver_resolve_flat(&resolver, &flat_ast);
+  } else if (engine == ENGINE_VM)
+    bytecode_entry = run_compiler(statements);
+  if (cache_file)
+    run_cache_store();
   run_interpreter(statements);
+  resolver_destroy(&resolver);
+  if (lazy) {
+    parser_destroy(parser);
+    parser_alive = 0;
+    scanner_destroy(scanner);
+    scanner_alive = 0;
+  }
   sig_handler_alive = 0;
   pthread_join(sig_handler_thread, NULL);
   return EXIT_SUCCESS;
 }
 
-l_list_t run_scanner(const char *filename) {
+token_vector_t run_scanner(const char *filename) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
   scanner_init(&scanner, filename);
   scanner_alive = 1;
   scanner_scan_tokens(&scanner);
-  l_list_t tokens = NULL;
-  tokens_dup(scanner.tokens, &tokens);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  // Move the tokens out of the scanner, the parser will own them
+  token_vector_t tokens = scanner.tokens;
+  tokens_init(&scanner.tokens);
   scanner_error = scanner_had_error(scanner);
   if (show_reports || scanner_error)
     scanner_errors_report(scanner);
-  scanner_destroy(scanner);
-  scanner_alive = 0;
+  if (show_stats)
+    dprintf(2, "%s[SCANNER]\t%sTime: %.3f ms\tTokens: %d (%zu bytes)%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            tokens.count, tokens.capacity * sizeof(token_t),
+            ANSI_COLOR_RESET);
   return tokens;
 }
 
-l_list_t run_parser(l_list_t tokens) {
-  parser_init(&parser, tokens);
+l_list_t run_parser(token_vector_t tokens) {
+  struct timespec start, end;
+  mem_stats_t before = mem_stats();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  arena_init(&ast_arena);
+  parser_init(&parser, tokens, scanner.source, &ast_arena);
+  parser.descent = descent;
+  parser.lazy = lazy;
   parser_alive = 1;
-  l_list_t statements = parser_parse(&parser);
+  l_list_t statements = parser_parse_parallel(&parser, jobs);
+  if (eager_check)
+    parser_parse_lazy_all(&parser);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  mem_stats_t after = mem_stats();
   parser_error = parser_had_errors(parser);
   if (show_reports || parser_error)
     parser_errors_report(parser);
-  parser_destroy(parser);
-  parser_alive = 0;
+  if (show_stats)
+    dprintf(2,
+            "%s[PARSER]\t%sTime: %.3f ms\tStatements: %d\tAllocations: %zu\t"
+            "Arena: %zu bytes (%d chunks)\tMax RSS: %ld KiB%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            list_len(statements), after.allocations - before.allocations,
+            ast_arena.allocated, ast_arena.chunk_count, max_rss_kib(),
+            ANSI_COLOR_RESET);
+  if (!lazy) {
+    parser_destroy(parser);
+    parser_alive = 0;
+  }
   return statements;
 }
 
+int run_resolver(l_list_t statements) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  resolver_init(&resolver);
+  resolver_resolve(&resolver, statements);
+  // The bodies skipped by a lazy parser may bind any identifier
+  int errors = lazy && !eager_check ? 0 : resolver_check(&resolver);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_reports || errors)
+    dprintf(2, "%s[RESOLVER]\t%sErrors: %d%s\n", ANSI_COLOR_MAGENTA,
+            ANSI_COLOR_RED, errors, ANSI_COLOR_RESET);
+  if (show_stats)
+    dprintf(2, "%s[RESOLVER]\t%sTime: %.3f ms\tSymbols: %u%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            resolver.names_count, ANSI_COLOR_RESET);
+  return errors == 0;
+}
+
+void run_optimizer(l_list_t statements) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  optimizer_init(&optimizer, &ast_arena);
+  optimizer_optimize(&optimizer, statements);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_stats)
+    dprintf(2,
+            "%s[OPTIMIZER]\t%sTime: %.3f ms\tFolded: %u\tSimplified: %u\t"
+            "Pruned: %u%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            optimizer.folded, optimizer.simplified, optimizer.pruned,
+            ANSI_COLOR_RESET);
+  return;
+}
+
+void run_purity(l_list_t statements) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  purity_t purity;
+  purity_init(&purity, resolver.names_count);
+  purity_analyze(&purity, statements);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_stats)
+    dprintf(2, "%s[PURITY]\t%sTime: %.3f ms\tFunctions: %u\tPure: %u%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            purity.functions_count, purity.pure, ANSI_COLOR_RESET);
+  purity_destroy(&purity);
+  return;
+}
+
+flat_index_t run_lowering(l_list_t statements) {
+  flat_init(&flat_ast);
+  flat_index_t program = flat_lower_program(&flat_ast, statements);
+  if (show_stats)
+    dprintf(2,
+            "%s[FLAT]\t\t%sNodes: %u\tSize: %zu bytes (AST arena: %zu "
+            "bytes)%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, flat_ast.nodes_count,
+            flat_size(&flat_ast), ast_arena.allocated, ANSI_COLOR_RESET);
+  // The pointer based AST is not needed anymore
+  arena_destroy(&ast_arena);
+  return program;
+}
+
+uint32_t run_compiler(l_list_t statements) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  bytecode_init(&bytecode);
+  uint32_t entry = bytecode_compile_program(&bytecode, statements);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_stats)
+    dprintf(2,
+            "%s[VM]\t\t%sTime: %.3f ms\tCode: %u bytes\tConstants: %u\t"
+            "Functions: %u\tSize: %zu bytes%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            bytecode.code_count, bytecode.constants_count,
+            bytecode.functions_count, bytecode_size(&bytecode),
+            ANSI_COLOR_RESET);
+  // The pointer based AST is not needed anymore
+  arena_destroy(&ast_arena);
+  return entry;
+}
+
+int run_emitter(l_list_t statements) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  FILE *out = fopen(emit_c_file, "w");
+  if (out == NULL) {
+    dprintf(2, "Cannot write %s: %s\n", emit_c_file, strerror(errno));
+    return 0;
+  }
+  c_compiler_t compiler;
+  c_compiler_init(&compiler);
+  int emitted = c_compiler_emit(&compiler, statements, out);
+  emitted = fclose(out) == 0 && emitted;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (!emitted)
+    dprintf(2, "Cannot write %s\n", emit_c_file);
+  if (show_stats)
+    dprintf(2,
+            "%s[EMIT-C]\t%sTime: %.3f ms\tFunctions: %u\tSymbols: %u\t"
+            "Size: %zu bytes%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            compiler.functions_count, compiler.symbols_count, compiler.size,
+            ANSI_COLOR_RESET);
+  c_compiler_destroy(&compiler);
+  return emitted;
+}
+
+int run_cache_load(const char *filename) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  // Sources that are not regular files (pipes, ...) are never cached
+  if (!cache_hash_source(filename, &source_hash, &source_size))
+    return 0;
+  cache_file = cache_path(filename);
+  flat_init(&flat_ast);
+  int hit = cache_load(cache_file, source_hash, source_size, &flat_ast,
+                       &flat_program);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_stats && hit)
+    dprintf(2, "%s[CACHE]\t\t%sHit: %s\tTime: %.3f ms\tSize: %zu bytes%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, cache_file,
+            elapsed_ms(start, end), flat_ast.mapping_size, ANSI_COLOR_RESET);
+  else if (show_stats)
+    dprintf(2, "%s[CACHE]\t\t%sMiss: %s\tTime: %.3f ms%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, cache_file,
+            elapsed_ms(start, end), ANSI_COLOR_RESET);
+  if (hit) {
+    mem_free(cache_file);
+    cache_file = NULL;
+  }
+  return hit;
+}
+
+void run_cache_store(void) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int stored = cache_store(cache_file, source_hash, source_size, &flat_ast,
+                           flat_program);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (show_stats)
+    dprintf(2, "%s[CACHE]\t\t%s%s: %s\tTime: %.3f ms%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN,
+            stored ? "Stored" : "Not stored", cache_file,
+            elapsed_ms(start, end), ANSI_COLOR_RESET);
+  mem_free(cache_file);
+  cache_file = NULL;
+  return;
+}
+
 void run_interpreter(l_list_t statements) {
+  struct timespec start, end;
+  mem_stats_t before = mem_stats();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  env_init(&environment);
+  gc_init(&garbage_collector, &environment, NULL, NULL);
+  interpreter_init(&interpreter, &environment,
+                   engine == ENGINE_TREE ? statements : NULL, &ast_arena,
+                   &resolver, &garbage_collector);
+  interpreter.max_depth = max_depth;
+  // The bodies parsed lazily are optimized on their first call
+  interpreter.optimizer = fold ? &optimizer : NULL;
+  if (memo_size) {
+    memo_init(&memo, memo_size);
+    interpreter.memo = &memo;
+  }
+  interpreter_alive = 1;
+  if (engine == ENGINE_FLAT)
+    flat_interpreter_eval(&interpreter, &flat_ast, flat_program);
+  else if (engine == ENGINE_VM) {
+    vm_init(&vm, &bytecode, &interpreter);
+    vm_run(&vm, bytecode_entry);
+  } else if (engine == ENGINE_DIRECT)
+    direct_interpreter_eval(&interpreter, &ast_arena, statements);
+  else if (engine == ENGINE_STACKLESS)
+    stackless_interpreter_eval(&interpreter, statements);
+  else {
+    jit_start();
+    interpreter_eval(&interpreter);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  mem_stats_t after = mem_stats();
+  if (show_stats)
+    dprintf(2,
+            "%s[INTERPRETER]\t%sTime: %.3f ms\tAllocations: %zu\t"
+            "Max RSS: %ld KiB%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            after.allocations - before.allocations, max_rss_kib(),
+            ANSI_COLOR_RESET);
+  calls_report();
+  quick_report();
+  memo_report();
+  if (engine == ENGINE_VM) {
+    vm_destroy(&vm);
+    bytecode_destroy(&bytecode);
+  }
+  jit_stop();
+  if (interpreter.memo)
+    memo_destroy(&memo);
+  interpreter_destroy(interpreter);
+  gc_destroy(&garbage_collector);
+  interpreter_alive = 0;
+  return;
+}
+
+void run_pipeline(const char *filename) {
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  channel_t tokens, statements;
+  channel_init(&tokens, PIPELINE_TOKENS_CAPACITY, sizeof(token_t));
+  channel_init(&statements, PIPELINE_STATEMENTS_CAPACITY, sizeof(stmt_t *));
+  scanner_init_streaming(&scanner, filename, &tokens);
+  scanner_load_source(&scanner);
+  scanner_alive = 1;
+  arena_init(&ast_arena);
+  parser_init_streaming(&parser, scanner.source, &ast_arena, &tokens,
+                        &statements);
+  parser.descent = descent;
+  parser_alive = 1;
+  pthread_t scanner_thread, parser_thread;
+  pthread_create(&scanner_thread, NULL, pipeline_scanner, NULL);
+  pthread_create(&parser_thread, NULL, pipeline_parser, NULL);
   env_init(&environment);
   gc_init(&garbage_collector, &environment, NULL, NULL);
-  interpreter_init(&interpreter, &environment, statements, &garbage_collector);
+  // Only the statements already run are known, so no identifier is reported
+  // before the run
+  resolver_init(&resolver);
+  interpreter_init(&interpreter, &environment, NULL, &ast_arena, &resolver,
+                   &garbage_collector);
+  interpreter.max_depth = max_depth;
   interpreter_alive = 1;
-  interpreter_eval(&interpreter);
+  if (engine == ENGINE_TREE)
+    jit_start();
+  // The statements are executed as soon as the parser completes them, the
+  // parser thread keeps allocating in its arena meanwhile
+  stmt_t *statement;
+  arena_t direct_arena;
+  arena_init(&direct_arena);
+  // The parser thread owns the AST arena, the folded strings get their own
+  arena_t folded_arena;
+  arena_init(&folded_arena);
+  optimizer_init(&optimizer, &folded_arena);
+  flat_init(&flat_ast);
+  bytecode_init(&bytecode);
+  vm_init(&vm, &bytecode, &interpreter);
+  while (channel_receive(&statements, &statement)) {
+    resolver_resolve_statement(&resolver, statement);
+    if (fold)
+      optimizer_optimize_statement(&optimizer, statement);
+    if (engine == ENGINE_FLAT) {
+      flat_index_t lowered = flat_lower(&flat_ast, statement);
+      resolver_resolve_flat(&resolver, &flat_ast);
+      flat_interpreter_eval_statement(&interpreter, &flat_ast, lowered);
+    } else if (engine == ENGINE_VM)
+      vm_run(&vm, bytecode_compile(&bytecode, statement));
+    else if (engine == ENGINE_DIRECT)
+      direct_interpreter_eval_statement(&interpreter, &direct_arena,
+                                        statement);
+    else if (engine == ENGINE_STACKLESS)
+      stackless_interpreter_eval_statement(&interpreter, statement);
+    else
+      interpreter_eval_statement(&interpreter, statement);
+  }
+  pthread_join(scanner_thread, NULL);
+  pthread_join(parser_thread, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  scanner_error = scanner_had_error(scanner);
+  parser_error = parser_had_errors(parser);
+  if (show_reports || scanner_error)
+    scanner_errors_report(scanner);
+  if (show_reports || parser_error)
+    parser_errors_report(parser);
+  if (show_stats)
+    dprintf(2, "%s[PIPELINE]\t%sTime: %.3f ms\tTokens: %d%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, elapsed_ms(start, end),
+            parser.tokens.count, ANSI_COLOR_RESET);
+  calls_report();
+  quick_report();
+  parser_destroy(parser);
+  parser_alive = 0;
+  scanner_destroy(scanner);
+  scanner_alive = 0;
+  vm_destroy(&vm);
+  bytecode_destroy(&bytecode);
+  jit_stop();
   interpreter_destroy(interpreter);
   gc_destroy(&garbage_collector);
   interpreter_alive = 0;
+  resolver_destroy(&resolver);
+  arena_destroy(&direct_arena);
+  arena_destroy(&folded_arena);
+  channel_destroy(&tokens);
+  channel_destroy(&statements);
+  return;
+}
+
+void calls_report(void) {
+  // Only the engines walking the AST look the callees up through the inline
+  // caches of the call sites
+  if (!show_stats || (engine != ENGINE_TREE && engine != ENGINE_STACKLESS))
+    return;
+  dprintf(2, "%s[CALLS]\t\t%sInline cache hits: %lu\tMisses: %lu%s\n",
+          ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN,
+          (unsigned long)interpreter.cache_hits,
+          (unsigned long)interpreter.cache_misses, ANSI_COLOR_RESET);
+  return;
+}
+
+void quick_report(void) {
+  // Only the engines walking the AST and the direct one specialize their
+  // operator sites on the types they see
+  if (!show_stats || (engine != ENGINE_TREE && engine != ENGINE_STACKLESS &&
+                      engine != ENGINE_DIRECT))
+    return;
+  dprintf(2, "%s[QUICK]\t\t%sSpecialized sites: %lu\tDeoptimized: %lu%s\n",
+          ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN,
+          (unsigned long)interpreter.quickened,
+          (unsigned long)interpreter.deoptimized, ANSI_COLOR_RESET);
+  return;
+}
+
+void memo_report(void) {
+  if (!show_stats || interpreter.memo == NULL)
+    return;
+  uint64_t lookups = memo.hits + memo.misses;
+  dprintf(2,
+          "%s[MEMO]\t\t%sHits: %lu\tMisses: %lu\tHit rate: %.1f%%\t"
+          "Evictions: %lu%s\n",
+          ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, (unsigned long)memo.hits,
+          (unsigned long)memo.misses,
+          lookups ? 100.0 * memo.hits / lookups : 0.0,
+          (unsigned long)memo.evictions, ANSI_COLOR_RESET);
+  return;
+}
+
+void jit_start(void) {
+  if (use_jit && !jit_init(&jit, &interpreter, jit_threshold))
+    dprintf(2, "The JIT is not supported on this platform, interpreting\n");
   return;
 }
 
+void jit_stop(void) {
+  if (interpreter.jit == NULL)
+    return;
+  if (show_stats)
+    dprintf(2,
+            "%s[JIT]\t\t%sCompiled: %u\tRejected: %u\tDeopts: %u\t"
+            "Native calls: %lu\tCode: %zu bytes%s\n",
+            ANSI_COLOR_MAGENTA, ANSI_COLOR_CYAN, jit.compiled, jit.rejected,
+            jit.deopts, (unsigned long)jit.native_calls, jit.code_size,
+            ANSI_COLOR_RESET);
+  jit_destroy(&jit);
+  return;
+}
+
+void *pipeline_scanner(void *args) {
+  scanner_scan_tokens(&scanner);
+  return NULL;
+}
+
+void *pipeline_parser(void *args) {
+  parser_parse(&parser);
+  return NULL;
+}
+
 void set_config(void) {
   char *v = config_read("LOG_LEVEL");
   int log_level;
@@ -130,9 +653,202 @@ void set_config(void) {
     show_reports = 0;
   if (v)
     free(v);
+  v = config_read("MAX_DEPTH");
+  if (v && atol(v) >= 0)
+    max_depth = atol(v);
+  if (v)
+    free(v);
+  v = config_read("MEMO_SIZE");
+  if (v && atol(v) >= 0 && atol(v) <= MEMO_MAX_SIZE)
+    memo_size = atol(v);
+  if (v)
+    free(v);
   return;
 }
 
+const char *set_options(int argc, char *argv[]) {
+  static struct option long_options[] = {
+      {"stats", no_argument, NULL, 's'},
+      {"stop-after", required_argument, NULL, 'S'},
+      {"pipeline", no_argument, NULL, 'p'},
+      {"engine", required_argument, NULL, 'e'},
+      {"jobs", required_argument, NULL, 'j'},
+      {"cache", no_argument, NULL, 'c'},
+      {"parser", required_argument, NULL, 'P'},
+      {"lazy", no_argument, NULL, 'l'},
+      {"eager-check", no_argument, NULL, 'E'},
+      {"jit", optional_argument, NULL, 'J'},
+      {"emit-c", required_argument, NULL, 'C'},
+      {"max-depth", required_argument, NULL, 'D'},
+      {"no-fold", no_argument, NULL, 'F'},
+      {"memo-size", required_argument, NULL, 'M'},
+      {NULL, 0, NULL, 0},
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+    switch (opt) {
+    case 's':
+      show_stats = 1;
+      break;
+    case 'p':
+      pipeline = 1;
+      break;
+    case 'c':
+      use_cache = 1;
+      break;
+    case 'l':
+      lazy = 1;
+      break;
+    case 'E':
+      eager_check = 1;
+      break;
+    case 'F':
+      fold = 0;
+      break;
+    case 'M':
+      memo_size = atol(optarg);
+      if (memo_size < 0 || memo_size > MEMO_MAX_SIZE)
+        return NULL;
+      break;
+    case 'J':
+      use_jit = 1;
+      if (optarg && atoi(optarg) < 1)
+        return NULL;
+      if (optarg)
+        jit_threshold = atoi(optarg);
+      break;
+    case 'C':
+      emit_c_file = optarg;
+      break;
+    case 'D':
+      max_depth = atol(optarg);
+      if (max_depth < 0)
+        return NULL;
+      break;
+    case 'e':
+      if (strcmp(optarg, "tree") == 0)
+        engine = ENGINE_TREE;
+      else if (strcmp(optarg, "flat") == 0)
+        engine = ENGINE_FLAT;
+      else if (strcmp(optarg, "vm") == 0)
+        engine = ENGINE_VM;
+      else if (strcmp(optarg, "direct") == 0)
+        engine = ENGINE_DIRECT;
+      else if (strcmp(optarg, "stackless") == 0)
+        engine = ENGINE_STACKLESS;
+      else
+        return NULL;
+      break;
+    case 'P':
+      if (strcmp(optarg, "pratt") == 0)
+        descent = 0;
+      else if (strcmp(optarg, "descent") == 0)
+        descent = 1;
+      else
+        return NULL;
+      break;
+    case 'j':
+      jobs = atoi(optarg);
+      if (jobs < 1)
+        return NULL;
+      break;
+    case 'S':
+      if (strcmp(optarg, "scan") == 0)
+        stop_after = PHASE_SCAN;
+      else if (strcmp(optarg, "parse") == 0)
+        stop_after = PHASE_PARSE;
+      else
+        return NULL;
+      break;
+    default:
+      return NULL;
+    }
+  }
+  if (optind != argc - 1 || (pipeline && stop_after != PHASE_ALL) ||
+      (pipeline && use_cache))
+    return NULL;
+  // Lazy bodies are parsed by the tree engines only, on their first call
+  if (lazy && (pipeline || use_cache ||
+               (engine != ENGINE_TREE && engine != ENGINE_STACKLESS)))
+    return NULL;
+  if (eager_check && !lazy)
+    return NULL;
+  // The cache holds a flat AST, so it can only be run by the flat engine
+  if (use_cache && engine != ENGINE_TREE && engine != ENGINE_FLAT)
+    return NULL;
+  if (use_cache)
+    engine = ENGINE_FLAT;
+  // Only the calls of the tree engine are counted and compiled
+  if (use_jit && engine != ENGINE_TREE)
+    return NULL;
+  // The whole AST is translated at once, before anything runs
+  if (emit_c_file && (pipeline || use_cache || lazy || use_jit ||
+                      stop_after != PHASE_ALL || engine != ENGINE_TREE))
+    return NULL;
+  // Only the engines recursing on the C stack memoize, and the purity analysis
+  // needs every body parsed before the program runs
+  if (lazy || pipeline || use_cache || emit_c_file ||
+      (engine != ENGINE_TREE && engine != ENGINE_DIRECT))
+    memo_size = 0;
+  // Only the stackless engine does not recurse on the C stack
+  if (max_depth < 0)
+    max_depth = engine == ENGINE_STACKLESS ? 0 : STACK_SIZE;
+  if (jobs == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = cores > 0 ? cores : 1;
+  }
+  return argv[optind];
+}
+
+void usage(void) {
+  printf("Usage: lotus [options] [filename]\n");
+  printf("Options:\n");
+  printf("  --stats\t\t\tprint timings and statistics for every phase\n");
+  printf("  --stop-after=scan|parse\tstop after the given front-end phase\n");
+  printf("  --pipeline\t\t\tscan, parse and run the source concurrently\n");
+  printf("  --engine=ENGINE\t\tevaluate the pointer based AST (tree, the "
+         "default), a flat copy of it (flat), its bytecode (vm), a tree of "
+         "C function calls built from it (direct) or walk it keeping the "
+         "pending work on the heap instead of the C stack (stackless)\n");
+  printf("  --max-depth=N\t\t\traise a stack overflow past N nested calls, "
+         "0 for no limit (default: %d, no limit with --engine=stackless), or "
+         "when the C stack runs out with the tree, flat and direct engines\n",
+         STACK_SIZE);
+  printf("  --jobs=N\t\t\tparse with N threads (default: one per core)\n");
+  printf("  --parser=pratt|descent\tparse the expressions by precedence "
+         "climbing (default) or by recursive descent\n");
+  printf("  --lazy\t\t\tparse the function bodies on their first call\n");
+  printf("  --eager-check\t\t\twith --lazy, report the syntax errors of "
+         "every function body before running\n");
+  printf("  --no-fold\t\t\trun the program as parsed, without folding its "
+         "constant expressions nor pruning its constant conditions\n");
+  printf("  --memo-size=N\t\t\twith the tree and direct engines, remember "
+         "the results of the last N calls of the pure functions, 0 to run "
+         "every call (default: %d)\n",
+         MEMO_SIZE);
+  printf("  --jit[=N]\t\t\twith the tree engine, compile the functions "
+         "called N times (default: %d) to native code\n",
+         JIT_THRESHOLD);
+  printf("  --emit-c=FILE\t\t\twrite the program as C to FILE instead of "
+         "running it, build it with: gcc -O2 -I lib FILE liblotus.a -lm "
+         "-lpthread\n");
+  printf("  --cache\t\t\treuse (or write) the compiled file.ltsc next to "
+         "the source, implies --engine=flat\n");
+  return;
+}
+
+double elapsed_ms(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) * 1e3 +
+         (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+long max_rss_kib(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == -1)
+    return -1;
+  return usage.ru_maxrss;
+}
+
 void *sig_handler(void *args) {
   siginfo_t sig;
   sigset_t sigs_wait;